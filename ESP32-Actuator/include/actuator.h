@@ -0,0 +1,22 @@
+/*
+ * Actuator Command Parsing and Output Control
+ */
+
+#ifndef ACTUATOR_H
+#define ACTUATOR_H
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+#include "types.h"
+
+void restoreActuatorOutputs(uint8_t mask);
+void initActuatorOutputs();
+bool parseActuatorCommand(JsonVariantConst json, ActuatorCommand &cmd);
+bool queueActuatorCommand(const ActuatorCommand &cmd, TickType_t wait);
+void applyActuatorCommand(const ActuatorCommand &cmd);
+void ackActuatorCommand(const ActuatorCommand &cmd, bool ok, const char* err);
+void writeOutputs(uint8_t mask, uint8_t value);
+uint8_t getOutputMask();
+uint32_t getStateSeq();
+
+#endif // ACTUATOR_H
@@ -7,6 +7,7 @@
 
 // ========== PIN DEFINITIONS ==========
 #define NEOPIXEL_WIFI 45
+#define NEOPIXEL_COUNT 1    // Pixels on the strip; pixel 0 shows connection status
 #define RESET_BUTTON_PIN 0  // Boot button on ESP32-S3 DevKit
 #define RELAY_PIN 13        // Example relay pin
 #define LED_PIN 12          // Example LED pin
@@ -21,9 +22,70 @@
 #define WIFI_CONNECTED_BIT (1 << 0)
 #define MQTT_CONNECTED_BIT (1 << 1)
 
+// ========== COMMAND QUEUE ==========
+#define ACTUATOR_QUEUE_LENGTH 20    // ActuatorCommand slots, allocated statically
+#define ACK_QUEUE_LENGTH 8          // CommandAck slots waiting for TaskMQTT
+#define CMD_CID_MAX_LEN 24          // Correlation ID incl. terminator
+#define CMD_DEDUPE_WINDOW 16        // Recent seq/cid pairs remembered for replays
+
+// ========== TASK PLACEMENT ==========
+// TaskActuator outranks TaskMQTT on the same core, so queueing a command from
+// the MQTT callback switches straight to the actuator
+#define ACTUATOR_TASK_PRIORITY 3
+#define ACTUATOR_TASK_CORE 1
+
 // ========== TASK INTERVALS ==========
-#define UI_UPDATE_INTERVAL_MS 500
+#define LED_FRAME_MS 20              // TaskUI compositor frame period (50 fps)
+#define UI_TASK_STACK 4096           // TaskUI also commits output state to NVS
+#define LED_DEFAULT_PERIOD_MS 1000   // Blink/breathe/rainbow cycle if none given
 #define MQTT_LOOP_INTERVAL_MS 100
+#define MQTT_IDLE_WAIT_MS 1000      // Max time TaskMQTT sleeps on the socket (keepalive)
+#define MQTT_KEEPALIVE_S 10         // Broker publishes our will after 1.5x this without traffic
+#define MQTT_MAX_PACKETS_PER_WAKE 16
+#define TELEMETRY_HEARTBEAT_MS 30000 // Full telemetry; state changes go out immediately
+
+// ========== MQTT PARSING ==========
+#define MQTT_JSON_POOL_SIZE 4096    // Static arena for callback JSON documents
+#define MQTT_MAX_ROUTES 12          // 4 device topics + one per rule sensor
+#define MQTT_TOPIC_MAX_LEN 64
+
+// ========== PWM / SERVO ==========
+// Channels 2k-1 and 2k share an LEDC timer and must use the same frequency
+#define PWM_DEFAULT_FREQ_HZ 5000
+#define PWM_DEFAULT_RESOLUTION 8
+#define PWM_MAX_RESOLUTION 14       // LEDC limit on ESP32-S3
+#define PWM_MAX_FADE_MS 5000        // Also the longest a command waits on a running ramp
+#define SERVO_FREQ_HZ 50
+#define SERVO_RESOLUTION_BITS 14
+#define SERVO_MIN_PULSE_US 500      // 0 degrees
+#define SERVO_MAX_PULSE_US 2500     // 180 degrees
+
+// ========== TIMED OUTPUTS ==========
+#define MAX_PULSE_MS 86400000UL     // pulse_ms upper bound (24 h)
+#define MAX_OUTPUT_SCHEDULES 8
+#define MIN_SCHEDULE_PERIOD_MS 1000
+#define TIMER_RETRY_MS 5             // Retry delay for a timed command the full queue refused
+
+// ========== STATE PERSISTENCE ==========
+#define STATE_NVS_NAMESPACE "outputs"
+#define STATE_NVS_MIN_INTERVAL_MS 5000  // Coalesce output changes into one flash write
+
+// ========== EDGE RULES ==========
+#define MAX_EDGE_RULES 8
+#define EDGE_RULE_ID_LEN 40         // Sensor device ID incl. terminator
+#define EDGE_RULE_PARAM_LEN 16      // Telemetry field name incl. terminator
+#define EDGE_RULES_MAX_JSON 1536    // Stored rule set size
+#define EDGE_RULES_NVS_NAMESPACE "rules"
+
+// ========== DIGITAL INPUTS ==========
+#define INPUT_CHANNEL_COUNT 4
+#define INPUT_ISR_QUEUE_LENGTH 32     // Raw edges waiting for TaskInputs
+#define INPUT_EVENT_QUEUE_LENGTH 16   // Debounced events waiting for TaskMQTT
+#define INPUT_DEFAULT_DEBOUNCE_MS 20
+#define INPUT_MAX_DEBOUNCE_MS 1000
+#define INPUT_TASK_PRIORITY 4         // Above TaskActuator so edges are stamped promptly
+#define INPUT_TASK_CORE 1
+#define INPUT_NVS_NAMESPACE "inputs"
 
 // ========== BUTTON CONFIG ==========
 #define CONFIG_RESET_HOLD_MS 3000  // Hold for 3 seconds to reset config
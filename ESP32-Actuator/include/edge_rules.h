@@ -0,0 +1,17 @@
+/*
+ * Edge Automation Rules
+ */
+
+#ifndef EDGE_RULES_H
+#define EDGE_RULES_H
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+
+void loadEdgeRules();
+bool updateEdgeRules(JsonDocument &doc);
+uint8_t getEdgeRuleSensors(const char* sensors[], uint8_t max);
+void evaluateEdgeRules(const char* sensorId, JsonDocument &telemetry, int64_t rxUs);
+void edgeRulesToJson(JsonObject obj);
+
+#endif // EDGE_RULES_H
@@ -14,6 +14,7 @@
 #include <ESPmDNS.h>
 #include "config.h"
 #include "types.h"
+#include "metrics.h"
 
 // ========== OBJECTS ==========
 extern Preferences prefs;
@@ -39,10 +40,19 @@ extern bool mqttConnected;
 // ========== GPIO PINS AND STATES ==========
 extern const uint8_t gpioOutputPins[8];
 extern bool gpioStates[8];
+extern const uint8_t gpioInputPins[INPUT_CHANNEL_COUNT];
+
+// ========== METRICS ==========
+extern LatencyStats mqttRxLatency;   // Socket readable -> mqttCallback entry
+extern LatencyStats actuationLatency; // Command on device -> pin edge
+extern LatencyStats timerDrift;       // Pulse/schedule deadline -> pin edge
+extern LatencyStats inputLatency;     // Input edge ISR -> MQTT publish
 
 // ========== FREERTOS HANDLES ==========
 extern SemaphoreHandle_t commandMutex;
 extern QueueHandle_t commandQueue;
+extern QueueHandle_t ackQueue;
 extern EventGroupHandle_t connectionEvents;
+extern TaskHandle_t actuatorTaskHandle;
 
 #endif // GLOBALS_H
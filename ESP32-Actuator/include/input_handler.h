@@ -0,0 +1,23 @@
+/*
+ * Digital Inputs (GPIO interrupts, debounced edge events)
+ */
+
+#ifndef INPUT_HANDLER_H
+#define INPUT_HANDLER_H
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+#include "types.h"
+
+#define INPUT_RECONFIGURE 0xFF  // InputEvent.channel marker, applies pending config
+
+void initInputs();
+void processInputEvents();
+bool takeInputEvent(InputEvent &event);
+
+// {"cmd":"inputs","inputs":[{"ch":1,"enabled":true,"pull":"up","activeLow":true,"debounceMs":20}]}
+bool configureInputs(JsonVariantConst json);
+uint8_t getInputMask();
+void inputsToJson(JsonObject obj);
+
+#endif // INPUT_HANDLER_H
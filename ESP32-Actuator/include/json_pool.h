@@ -0,0 +1,88 @@
+/*
+ * Static JSON Memory Pool
+ *
+ * ArduinoJson 7 allocator backed by a fixed buffer so MQTT callbacks can
+ * parse payloads without touching the heap. Blocks are bump-allocated with
+ * a small size header; reset() rewinds the whole pool before each parse.
+ */
+
+#ifndef JSON_POOL_H
+#define JSON_POOL_H
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+
+template <size_t N>
+class StaticJsonPool : public ArduinoJson::Allocator {
+ public:
+  void* allocate(size_t size) override {
+    size_t total = align(kHeader + size);
+    if (used_ + total > N) return nullptr;
+
+    uint8_t* block = buffer_ + used_;
+    *(size_t*)block = size;
+    last_ = block;
+    used_ += total;
+    return block + kHeader;
+  }
+
+  void deallocate(void* ptr) override {
+    // Only the most recent block can be handed back; the rest is
+    // reclaimed by reset()
+    if (ptr && headerOf(ptr) == last_) {
+      used_ = last_ - buffer_;
+      last_ = nullptr;
+    }
+  }
+
+  void* reallocate(void* ptr, size_t newSize) override {
+    if (!ptr) return allocate(newSize);
+
+    uint8_t* block = headerOf(ptr);
+    size_t oldSize = *(size_t*)block;
+
+    // Growing or shrinking the last block happens in place
+    if (block == last_) {
+      size_t total = align(kHeader + newSize);
+      if ((size_t)(block - buffer_) + total > N) return nullptr;
+      *(size_t*)block = newSize;
+      used_ = (block - buffer_) + total;
+      return ptr;
+    }
+
+    if (newSize <= oldSize) {
+      *(size_t*)block = newSize;
+      return ptr;
+    }
+
+    void* moved = allocate(newSize);
+    if (moved) memcpy(moved, ptr, oldSize);
+    return moved;
+  }
+
+  void reset() {
+    used_ = 0;
+    last_ = nullptr;
+  }
+
+  size_t used() const { return used_; }
+  size_t capacity() const { return N; }
+
+ private:
+  // 8-byte header and alignment keeps doubles and 64-bit ints aligned
+  static const size_t kHeader = 8;
+
+  static size_t align(size_t size) {
+    return (size + 7) & ~(size_t)7;
+  }
+
+  static uint8_t* headerOf(void* ptr) {
+    return (uint8_t*)ptr - kHeader;
+  }
+
+  alignas(8) uint8_t buffer_[N];
+  size_t used_ = 0;
+  uint8_t* last_ = nullptr;
+};
+
+#endif // JSON_POOL_H
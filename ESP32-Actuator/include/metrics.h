@@ -0,0 +1,28 @@
+/*
+ * Latency Metrics (power-of-two histogram)
+ */
+
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+
+// Bucket i counts samples in [2^(i-1), 2^i) us, bucket 0 holds 0 us.
+// 24 buckets cover up to ~8 s which is far beyond anything we measure.
+#define LATENCY_BUCKETS 24
+
+struct LatencyStats {
+  uint32_t count;
+  uint32_t lastUs;
+  uint32_t maxUs;
+  uint64_t totalUs;
+  uint32_t buckets[LATENCY_BUCKETS];
+};
+
+void recordLatency(LatencyStats &stats, uint32_t us);
+void snapshotLatency(const LatencyStats &stats, LatencyStats &out);
+uint32_t latencyPercentile(const LatencyStats &stats, uint8_t percentile);
+void latencyToJson(const LatencyStats &stats, JsonObject obj);
+
+#endif // METRICS_H
@@ -12,5 +12,15 @@ void connectMQTT();
 void mqttCallback(char* topic, uint8_t* payload, unsigned int length);
 void publishStatus();
 void publishTelemetry();
+void publishState();
+void publishAck(const CommandAck &ack);
+void publishInputEvent(const InputEvent &event);
+void processMQTTInbound();
+void processMQTTOutbound();
+bool waitForMQTTData(uint32_t timeoutMs);
+void initMQTTWakeup();
+void wakeMQTTTask();
+void requestStatePublish();
+void queueCommandAck(const CommandAck &ack);
 
 #endif // MQTT_HANDLER_H
@@ -1,10 +1,23 @@
 /*
- * NeoPixel LED Status Indicator
+ * NeoPixel LED Compositor
+ *
+ * Layers, lowest first: connection status (pixel 0), user colour/effect,
+ * transient flash. Callers only update layer state; TaskUI renders frames.
  */
 
 #ifndef NEOPIXEL_HANDLER_H
 #define NEOPIXEL_HANDLER_H
 
+#include <Arduino.h>
+
+enum LedEffect : uint8_t { LED_SOLID, LED_BLINK, LED_BREATHE, LED_RAINBOW };
+
 void updateNeoPixel();
+void setUserLeds(uint32_t color, LedEffect effect, uint16_t periodMs, uint8_t first, uint8_t count);
+void clearUserLeds();
+void flashLeds(uint32_t color, uint16_t durationMs, uint16_t blinkMs = 0);
+bool parseLedEffect(const char* name, LedEffect &effect);
+void startLedRenderer();
+void renderLeds();
 
 #endif // NEOPIXEL_HANDLER_H
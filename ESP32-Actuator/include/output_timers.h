@@ -0,0 +1,25 @@
+/*
+ * Timed Outputs (pulses and recurring schedules)
+ */
+
+#ifndef OUTPUT_TIMERS_H
+#define OUTPUT_TIMERS_H
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+#include "types.h"
+
+void initOutputTimers();
+
+// Pulses: revert a channel after pulse_ms, owned by TaskActuator
+void armPulse(uint8_t idx, bool revertState, uint32_t pulseMs);
+void cancelPulse(uint8_t idx);
+bool isPulseCurrent(uint8_t idx, uint16_t gen);
+uint8_t withPulseReverts(uint8_t mask);
+
+// Schedules: {"id":0,"pin":1,"periodMs":3600000,"onMs":30000}
+bool configureSchedule(JsonVariantConst json);
+uint8_t getActiveScheduleCount();
+void timersToJson(JsonObject obj);
+
+#endif // OUTPUT_TIMERS_H
@@ -0,0 +1,21 @@
+/*
+ * LEDC PWM and Servo Outputs
+ */
+
+#ifndef PWM_HANDLER_H
+#define PWM_HANDLER_H
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+#include "types.h"
+
+void initPwmOutputs();
+bool applyPwmCommand(const ActuatorCommand &cmd);
+void releasePwmChannel(uint8_t idx);
+// Writes duties that waited for a running ramp; returns the ticks until the
+// next one is due (portMAX_DELAY if none)
+TickType_t servicePwmFades();
+uint8_t getPwmChannelMask();
+void pwmStatusToJson(JsonArray channels);
+
+#endif // PWM_HANDLER_H
@@ -0,0 +1,20 @@
+/*
+ * Output State Persistence (RTC memory + NVS)
+ */
+
+#ifndef STATE_STORE_H
+#define STATE_STORE_H
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+
+enum PowerOnPolicy : uint8_t { POWER_ON_OFF = 0, POWER_ON_ON = 1, POWER_ON_LAST = 2 };
+
+void restoreOutputState();
+void logRestoredState();
+void recordOutputState(uint8_t mask);
+void serviceStateStore();
+bool setPowerOnPolicy(JsonVariantConst policies);
+void stateStoreToJson(JsonObject obj);
+
+#endif // STATE_STORE_H
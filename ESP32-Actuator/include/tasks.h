@@ -8,5 +8,6 @@
 void TaskActuator(void *pvParameters);
 void TaskUI(void *pvParameters);
 void TaskMQTT(void *pvParameters);
+void TaskInputs(void *pvParameters);
 
 #endif // TASKS_H
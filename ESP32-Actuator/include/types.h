@@ -6,15 +6,57 @@
 #define TYPES_H
 
 #include <Arduino.h>
+#include "config.h"
 
 // ========== ACTUATOR COMMAND ==========
+// Parsed once at the edge (MQTT callback / web handler) and passed by value
+// through commandQueue, so it must stay a plain POD.
 struct ActuatorCommand {
-  enum Type { RELAY, LED, NEOPIXEL, PWM, SERVO } type;
-  uint8_t pin;
+  enum Type { RELAY, LED, NEOPIXEL, PWM, SERVO, MASK } type;
+  enum Source : uint8_t { SRC_REMOTE, SRC_PULSE, SRC_SCHEDULE } source;
+  uint8_t pin;       // Channel 1-8
   bool state;
-  uint8_t value;     // For PWM or brightness
+  uint8_t mask;      // MASK: channels to write (bit 0 = channel 1)
+  uint8_t value;     // Brightness; MASK: new channel levels; SERVO: angle 0-180
+  uint8_t resolution; // PWM: duty resolution in bits
+  uint16_t duty;     // PWM: duty in 0..2^resolution
+  uint32_t freq;     // PWM: frequency in Hz
+  uint32_t fadeMs;   // PWM/SERVO: hardware ramp time, 0 = immediate
   uint32_t color;    // For NeoPixel
+  uint8_t effect;    // NEOPIXEL: LedEffect; state=false clears the user layer
+  uint8_t ledFirst;  // NEOPIXEL: first pixel and pixel count
+  uint8_t ledCount;
+  uint16_t periodMs; // NEOPIXEL: effect period
+  uint32_t pulseMs;  // RELAY: revert to !state after this long, 0 = hold
+  uint16_t timerGen; // SRC_PULSE: pulse generation that queued the revert
+  int64_t dueUs;     // Timed commands: esp_timer deadline, for drift stats
   uint32_t timestamp;
+  int64_t rxUs;      // esp_timer time the command reached the device
+  uint32_t seq;      // Sender sequence number, 0 = none
+  char cid[CMD_CID_MAX_LEN]; // Correlation ID echoed in the ack, "" = none
+};
+
+// ========== COMMAND ACK ==========
+// Queued by TaskActuator, published by TaskMQTT on devices/<id>/ack
+struct CommandAck {
+  uint32_t seq;
+  char cid[CMD_CID_MAX_LEN];
+  bool ok;
+  bool dup;          // Replay of an already applied command
+  const char* err;   // Static string, NULL when ok
+  int64_t rxUs;
+  int64_t appliedUs;
+};
+
+// ========== INPUT EVENT ==========
+// Raw edge from the GPIO ISR, and after debouncing the event published on
+// devices/<id>/inputs
+struct InputEvent {
+  uint8_t channel;   // 0-based input channel, INPUT_RECONFIGURE for config changes
+  bool level;        // Raw pin level from the ISR; active state once debounced
+  bool settled;      // Emitted by the post-debounce level check, not an ISR edge
+  int64_t us;        // esp_timer time the ISR saw the edge
+  uint32_t seq;
 };
 
 // ========== ACTUATOR STATUS ==========
@@ -0,0 +1,463 @@
+/*
+ * Actuator Command Parsing and Output Control Implementation
+ */
+
+#include "actuator.h"
+#include "globals.h"
+#include "mqtt_handler.h"
+#include "pwm_handler.h"
+#include "output_timers.h"
+#include "state_store.h"
+#include "neopixel_handler.h"
+#include <esp_timer.h>
+#include <soc/gpio_reg.h>
+#include <type_traits>
+
+// commandQueue copies commands with memcpy, which is only sound for PODs
+static_assert(std::is_trivially_copyable<ActuatorCommand>::value,
+              "ActuatorCommand must stay trivially copyable");
+
+// Current level of every channel, bit 0 = channel 1. Updated together with
+// the output registers so readers never see a half-applied mask.
+static volatile uint8_t outputMask = 0;
+static volatile uint32_t stateSeq = 0;
+static portMUX_TYPE outputMux = portMUX_INITIALIZER_UNLOCKED;
+
+// Called from setup() before anything else. The output latches are written
+// before the drivers are enabled so a restored HIGH never glitches LOW.
+void restoreActuatorOutputs(uint8_t mask) {
+  writeOutputs(0xFF, mask);
+  for (int i = 0; i < 8; i++) {
+    pinMode(gpioOutputPins[i], OUTPUT);
+  }
+}
+
+// Outputs are already driven by restoreActuatorOutputs(); this only brings
+// up the timer-based features and must not touch the pin levels.
+void initActuatorOutputs() {
+  Serial.println("[GPIO] 8 output pins:");
+  for (int i = 0; i < 8; i++) {
+    Serial.println("  GPIO" + String(i + 1) + " -> Pin " + String(gpioOutputPins[i]) +
+                   (gpioStates[i] ? " (ON)" : ""));
+  }
+  initPwmOutputs();
+  initOutputTimers();
+}
+
+// Applies all masked channels with one write of each bank's output register
+// (GPIO 0-31, 32-48), so channels within a bank switch together even when
+// some turn on and others off. The read-modify-write is safe because every
+// output write in the firmware goes through here, under outputMux; the two
+// banks still switch one write apart.
+void writeOutputs(uint8_t mask, uint8_t value) {
+  // Channels owned by LEDC are routed away from the GPIO output register
+  mask &= ~getPwmChannelMask();
+  
+  uint32_t set0 = 0, clear0 = 0, set1 = 0, clear1 = 0;
+  for (int i = 0; i < 8; i++) {
+    if (!(mask & (1 << i))) continue;
+    
+    uint8_t pin = gpioOutputPins[i];
+    bool high = value & (1 << i);
+    if (pin < 32) {
+      if (high) set0 |= (1UL << pin); else clear0 |= (1UL << pin);
+    } else {
+      if (high) set1 |= (1UL << (pin - 32)); else clear1 |= (1UL << (pin - 32));
+    }
+  }
+  
+  portENTER_CRITICAL(&outputMux);
+  if (set0 | clear0) REG_WRITE(GPIO_OUT_REG, (REG_READ(GPIO_OUT_REG) | set0) & ~clear0);
+  if (set1 | clear1) REG_WRITE(GPIO_OUT1_REG, (REG_READ(GPIO_OUT1_REG) | set1) & ~clear1);
+  
+  uint8_t levels = (outputMask & ~mask) | (value & mask);
+  outputMask = levels;
+  for (int i = 0; i < 8; i++) {
+    gpioStates[i] = levels & (1 << i);
+  }
+  portEXIT_CRITICAL(&outputMux);
+}
+
+uint8_t getOutputMask() {
+  return outputMask;
+}
+
+// Incremented for every applied output command, published with the mask
+uint32_t getStateSeq() {
+  return stateSeq;
+}
+
+// Records the on/off level of a PWM channel (duty > 0) in the state mask
+static void setChannelLevel(uint8_t idx, bool on) {
+  portENTER_CRITICAL(&outputMux);
+  if (on) outputMask |= (1 << idx); else outputMask &= ~(1 << idx);
+  gpioStates[idx] = on;
+  portEXIT_CRITICAL(&outputMux);
+}
+
+// Digital commands take a channel back from LEDC before writing it
+static void releasePwmChannels(uint8_t mask) {
+  uint8_t owned = mask & getPwmChannelMask();
+  for (int i = 0; i < 8; i++) {
+    if (owned & (1 << i)) releasePwmChannel(i);
+  }
+}
+
+// Remote commands override any pending pulse on the channels they touch
+static void cancelPulses(const ActuatorCommand &cmd, uint8_t mask) {
+  if (cmd.source != ActuatorCommand::SRC_REMOTE) return;
+  for (int i = 0; i < 8; i++) {
+    if (mask & (1 << i)) cancelPulse(i);
+  }
+}
+
+static void recordTimerDrift(const ActuatorCommand &cmd) {
+  if (cmd.dueUs == 0) return;
+  int64_t drift = esp_timer_get_time() - cmd.dueUs;
+  recordLatency(timerDrift, drift > 0 ? (uint32_t)drift : 0);
+}
+
+// Time of the last pin edge, reported as appliedUs in acks
+static int64_t lastAppliedUs = 0;
+
+static uint32_t recordActuation(const ActuatorCommand &cmd) {
+  lastAppliedUs = esp_timer_get_time();
+  uint32_t latencyUs = (uint32_t)(lastAppliedUs - cmd.rxUs);
+  recordLatency(actuationLatency, latencyUs);
+  return latencyUs;
+}
+
+static void outputsApplied() {
+  stateSeq++;
+  // PWM channels come back as digital LOW; pulsing channels as their end level
+  recordOutputState(withPulseReverts(getOutputMask() & ~getPwmChannelMask()));
+  requestStatePublish();
+}
+
+// Accepts a JSON number or a string in any strtoul base ("0x0F", "15")
+static bool parseByteField(JsonVariantConst field, uint8_t &out) {
+  long value;
+  if (field.is<const char*>()) {
+    char* end;
+    value = strtol(field.as<const char*>(), &end, 0);
+    if (*end != '\0') return false;
+  } else if (field.is<long>()) {
+    value = field.as<long>();
+  } else {
+    return false;
+  }
+  if (value < 0 || value > 0xFF) return false;
+  out = (uint8_t)value;
+  return true;
+}
+
+// Channel number from "pin" or the server's "gpio" key, 0 if out of range
+static uint8_t parseChannel(JsonVariantConst json) {
+  int pin = json["pin"].is<int>() ? json["pin"].as<int>() : json["gpio"].as<int>();
+  if (pin < 1 || pin > 8) {
+    Serial.println("[Actuator] ✗ Invalid GPIO pin: " + String(pin) + " (must be 1-8)");
+    return 0;
+  }
+  return pin;
+}
+
+// Converts a JSON command into an ActuatorCommand. Accepts the documented
+// {"type":"gpio","pin":1,"state":true} form as well as the server's
+// {"gpio":1,"state":1} form (no type, "gpio" as channel key). seq/cid are
+// copied first so a rejected command can still be acknowledged.
+bool parseActuatorCommand(JsonVariantConst json, ActuatorCommand &cmd) {
+  memset(&cmd, 0, sizeof(cmd));
+  cmd.timestamp = millis();
+  cmd.rxUs = esp_timer_get_time();
+  cmd.seq = json["seq"] | 0;
+  strlcpy(cmd.cid, json["cid"] | "", sizeof(cmd.cid));
+
+  const char* type = json["type"] | "gpio";
+
+  if (strcmp(type, "gpio") == 0 || strcmp(type, "relay") == 0) {
+    uint8_t pin = parseChannel(json);
+    if (pin == 0) return false;
+    cmd.type = ActuatorCommand::RELAY;
+    cmd.pin = pin;
+    cmd.state = json["state"].as<bool>();
+    cmd.pulseMs = json["pulse_ms"] | 0;
+    if (cmd.pulseMs > MAX_PULSE_MS) {
+      Serial.println("[Actuator] ✗ pulse_ms too long");
+      return false;
+    }
+    return true;
+  }
+
+  // Bulk update: {"type":"mask","mask":"0x0F","value":"0x05"}
+  if (strcmp(type, "mask") == 0) {
+    if (!parseByteField(json["mask"], cmd.mask) || !parseByteField(json["value"], cmd.value) ||
+        cmd.mask == 0) {
+      Serial.println("[Actuator] ✗ Invalid mask command (mask/value must be 0x01-0xFF)");
+      return false;
+    }
+    cmd.type = ActuatorCommand::MASK;
+    return true;
+  }
+
+  // {"type":"pwm","pin":3,"duty":128,"freq":5000,"resolution":8,"fadeMs":1000}
+  // "percent" (0-100) may be given instead of a raw duty
+  if (strcmp(type, "pwm") == 0) {
+    cmd.pin = parseChannel(json);
+    if (cmd.pin == 0) return false;
+    
+    uint32_t freq = json["freq"] | PWM_DEFAULT_FREQ_HZ;
+    int resolution = json["resolution"] | PWM_DEFAULT_RESOLUTION;
+    uint32_t fadeMs = json["fadeMs"] | 0;
+    if (resolution < 1 || resolution > PWM_MAX_RESOLUTION || freq == 0 || fadeMs > PWM_MAX_FADE_MS) {
+      Serial.println("[Actuator] ✗ Invalid PWM freq/resolution/fadeMs");
+      return false;
+    }
+    
+    uint32_t maxDuty = 1UL << resolution;
+    long duty = json["percent"].is<float>()
+                  ? (long)(json["percent"].as<float>() * maxDuty / 100.0f + 0.5f)
+                  : json["duty"] | -1L;
+    if (duty < 0 || duty > (long)maxDuty) {
+      Serial.printf("[Actuator] ✗ PWM duty must be 0-%lu (or percent 0-100)\n", (unsigned long)maxDuty);
+      return false;
+    }
+    
+    cmd.type = ActuatorCommand::PWM;
+    cmd.freq = freq;
+    cmd.resolution = resolution;
+    cmd.duty = duty;
+    cmd.fadeMs = fadeMs;
+    return true;
+  }
+  
+  // {"type":"servo","pin":4,"angle":90,"fadeMs":500}
+  if (strcmp(type, "servo") == 0) {
+    cmd.pin = parseChannel(json);
+    if (cmd.pin == 0) return false;
+    
+    int angle = json["angle"] | -1;
+    uint32_t fadeMs = json["fadeMs"] | 0;
+    if (angle < 0 || angle > 180 || fadeMs > PWM_MAX_FADE_MS) {
+      Serial.println("[Actuator] ✗ Servo angle must be 0-180");
+      return false;
+    }
+    
+    cmd.type = ActuatorCommand::SERVO;
+    cmd.value = angle;
+    cmd.fadeMs = fadeMs;
+    return true;
+  }
+
+  // {"type":"neopixel","color":{"r":255,"g":0,"b":0},"effect":"breathe",
+  //  "periodMs":2000,"first":0,"count":8}; "effect":"off" hands the pixels
+  // back to the status layer
+  if (strcmp(type, "neopixel") == 0 || strcmp(type, "led") == 0) {
+    uint8_t r = json["color"]["r"];
+    uint8_t g = json["color"]["g"];
+    uint8_t b = json["color"]["b"];
+    const char* effect = json["effect"] | "solid";
+    
+    cmd.type = ActuatorCommand::NEOPIXEL;
+    cmd.color = Adafruit_NeoPixel::Color(r, g, b);
+    cmd.state = strcmp(effect, "off") != 0;
+    LedEffect ledEffect = LED_SOLID;
+    if (cmd.state && !parseLedEffect(effect, ledEffect)) {
+      Serial.println("[Actuator] ✗ Unknown LED effect: " + String(effect));
+      return false;
+    }
+    cmd.effect = ledEffect;
+    cmd.periodMs = json["periodMs"] | 0;
+    cmd.ledFirst = json["first"] | 0;
+    cmd.ledCount = json["count"] | 0;
+    return true;
+  }
+
+  Serial.println("[Actuator] Unknown command type: " + String(type));
+  return false;
+}
+
+// Queues the command and wakes TaskActuator with a direct notification
+bool queueActuatorCommand(const ActuatorCommand &cmd, TickType_t wait) {
+  if (commandQueue == NULL) return false;
+  if (xQueueSend(commandQueue, &cmd, wait) != pdTRUE) return false;
+  
+  if (actuatorTaskHandle != NULL) {
+    xTaskNotifyGive(actuatorTaskHandle);
+  }
+  return true;
+}
+
+static bool executeCommand(const ActuatorCommand &cmd) {
+  switch (cmd.type) {
+    case ActuatorCommand::RELAY: {
+      uint8_t idx = cmd.pin - 1;
+      uint8_t bit = 1 << idx;
+      uint8_t physicalPin = gpioOutputPins[idx];
+      if (cmd.source == ActuatorCommand::SRC_PULSE && !isPulseCurrent(idx, cmd.timerGen)) {
+        Serial.printf("[GPIO%d] Stale pulse end ignored\n", cmd.pin);
+        return true;
+      }
+      
+      releasePwmChannels(bit);
+      writeOutputs(bit, cmd.state ? bit : 0);
+      
+      // Measure before logging so serial output is not part of the latency
+      uint32_t latencyUs = recordActuation(cmd);
+      recordTimerDrift(cmd);
+      
+      if (cmd.pulseMs > 0) {
+        armPulse(idx, !cmd.state, cmd.pulseMs);
+      } else {
+        cancelPulses(cmd, bit);
+      }
+      outputsApplied();
+      
+      if (cmd.pulseMs > 0) {
+        Serial.printf("[GPIO%d] ✓ Pin %d -> %s for %lu ms (%lu us)\n", cmd.pin, physicalPin,
+                      cmd.state ? "ON" : "OFF", (unsigned long)cmd.pulseMs, (unsigned long)latencyUs);
+      } else {
+        Serial.printf("[GPIO%d] ✓ Pin %d -> %s (%lu us)\n", cmd.pin, physicalPin,
+                      cmd.state ? "ON" : "OFF", (unsigned long)latencyUs);
+      }
+      return true;
+    }
+
+    case ActuatorCommand::MASK: {
+      releasePwmChannels(cmd.mask);
+      writeOutputs(cmd.mask, cmd.value);
+      cancelPulses(cmd, cmd.mask);
+      
+      uint32_t latencyUs = recordActuation(cmd);
+      outputsApplied();
+      Serial.printf("[GPIO] ✓ Mask 0x%02X -> 0x%02X, outputs now 0x%02X (%lu us)\n",
+                    cmd.mask, cmd.value & cmd.mask, getOutputMask(), (unsigned long)latencyUs);
+      return true;
+    }
+
+    case ActuatorCommand::PWM:
+    case ActuatorCommand::SERVO: {
+      if (!applyPwmCommand(cmd)) return false;
+      cancelPulses(cmd, 1 << (cmd.pin - 1));
+      
+      uint32_t latencyUs = recordActuation(cmd);
+      setChannelLevel(cmd.pin - 1, cmd.type == ActuatorCommand::SERVO || cmd.duty > 0);
+      outputsApplied();
+      if (cmd.type == ActuatorCommand::SERVO) {
+        Serial.printf("[GPIO%d] ✓ Servo -> %d deg over %lu ms (%lu us)\n", cmd.pin, cmd.value,
+                      (unsigned long)cmd.fadeMs, (unsigned long)latencyUs);
+      } else {
+        Serial.printf("[GPIO%d] ✓ PWM -> %u/%lu @ %lu Hz over %lu ms (%lu us)\n", cmd.pin, cmd.duty,
+                      1UL << cmd.resolution, (unsigned long)cmd.freq, (unsigned long)cmd.fadeMs,
+                      (unsigned long)latencyUs);
+      }
+      return true;
+    }
+
+    case ActuatorCommand::NEOPIXEL:
+      // Only updates the layer; TaskUI draws it on the next frame
+      if (cmd.state) {
+        setUserLeds(cmd.color, (LedEffect)cmd.effect, cmd.periodMs, cmd.ledFirst, cmd.ledCount);
+      } else {
+        clearUserLeds();
+      }
+      lastAppliedUs = esp_timer_get_time();
+      Serial.println("[Actuator] NeoPixel layer updated");
+      return true;
+
+    default:
+      Serial.println("[Actuator] Unsupported command type: " + String(cmd.type));
+      return false;
+  }
+}
+
+// ========== ACKS AND REPLAY PROTECTION ==========
+// Commands carrying a cid are keyed by it, so a sender can safely retry with
+// the same cid; otherwise the seq number is the key. Only the last
+// CMD_DEDUPE_WINDOW keys are kept, which covers broker redelivery and REST
+// retries without unbounded state.
+struct SeenCommand {
+  uint32_t key;
+  bool byCid;
+  bool ok;
+  const char* err;
+  int64_t appliedUs;
+};
+
+static SeenCommand seenCommands[CMD_DEDUPE_WINDOW];
+static uint8_t seenCount = 0;
+static uint8_t seenNext = 0;
+
+static bool hasCorrelation(const ActuatorCommand &cmd) {
+  return cmd.cid[0] != '\0' || cmd.seq != 0;
+}
+
+// FNV-1a, plenty to tell recent cids apart
+static uint32_t commandKey(const ActuatorCommand &cmd) {
+  if (cmd.cid[0] == '\0') return cmd.seq;
+  uint32_t hash = 2166136261UL;
+  for (const char* p = cmd.cid; *p; p++) {
+    hash = (hash ^ (uint8_t)*p) * 16777619UL;
+  }
+  return hash;
+}
+
+static const SeenCommand* findSeen(const ActuatorCommand &cmd) {
+  uint32_t key = commandKey(cmd);
+  bool byCid = cmd.cid[0] != '\0';
+  for (uint8_t i = 0; i < seenCount; i++) {
+    if (seenCommands[i].key == key && seenCommands[i].byCid == byCid) return &seenCommands[i];
+  }
+  return NULL;
+}
+
+static void rememberCommand(const ActuatorCommand &cmd, bool ok, const char* err) {
+  SeenCommand &entry = seenCommands[seenNext];
+  entry.key = commandKey(cmd);
+  entry.byCid = cmd.cid[0] != '\0';
+  entry.ok = ok;
+  entry.err = err;
+  entry.appliedUs = lastAppliedUs;
+  seenNext = (seenNext + 1) % CMD_DEDUPE_WINDOW;
+  if (seenCount < CMD_DEDUPE_WINDOW) seenCount++;
+}
+
+static void sendAck(const ActuatorCommand &cmd, bool ok, const char* err, int64_t appliedUs,
+                    bool dup) {
+  CommandAck ack;
+  memset(&ack, 0, sizeof(ack));
+  ack.seq = cmd.seq;
+  strlcpy(ack.cid, cmd.cid, sizeof(ack.cid));
+  ack.ok = ok;
+  ack.dup = dup;
+  ack.err = err;
+  ack.rxUs = cmd.rxUs;
+  ack.appliedUs = appliedUs;
+  queueCommandAck(ack);
+}
+
+// Acks a command that never reached TaskActuator (parse error, queue full)
+void ackActuatorCommand(const ActuatorCommand &cmd, bool ok, const char* err) {
+  if (!hasCorrelation(cmd)) return;
+  sendAck(cmd, ok, err, 0, false);
+}
+
+void applyActuatorCommand(const ActuatorCommand &cmd) {
+  // Timer-generated commands never carry correlation data
+  if (!hasCorrelation(cmd)) {
+    executeCommand(cmd);
+    return;
+  }
+  
+  const SeenCommand* seen = findSeen(cmd);
+  if (seen != NULL) {
+    Serial.printf("[Actuator] Replay of seq %lu / cid '%s' ignored\n", (unsigned long)cmd.seq, cmd.cid);
+    sendAck(cmd, seen->ok, seen->err, seen->appliedUs, true);
+    return;
+  }
+  
+  lastAppliedUs = 0;
+  bool ok = executeCommand(cmd);
+  const char* err = ok ? NULL : "apply_failed";
+  rememberCommand(cmd, ok, err);
+  sendAck(cmd, ok, err, lastAppliedUs, false);
+}
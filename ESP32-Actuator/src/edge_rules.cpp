@@ -0,0 +1,230 @@
+/*
+ * Edge Automation Rules Implementation
+ *
+ * Rules arrive retained on device/<id>/rules and are kept in NVS, so they
+ * survive a reboot without the server or dashboard re-sending them. Each rule
+ * watches one numeric field of a sensor's telemetry and drives one channel:
+ *
+ *   {"rules":[{"sensor":"ESP32-IOT-SENSOR-ab12","param":"tC","op":">",
+ *              "on":30,"off":28.5,"forMs":10000,"pin":3,"state":true,
+ *              "autoOff":true}]}
+ *
+ * Rules are evaluated in the MQTT callback for every telemetry message, so
+ * the reaction is one queue hop away from the packet arriving. Everything
+ * here runs in TaskMQTT; no locking is needed.
+ */
+
+#include "edge_rules.h"
+#include "globals.h"
+#include "actuator.h"
+#include <esp_timer.h>
+
+enum RuleOp : uint8_t { OP_GT, OP_GE, OP_LT, OP_LE };
+
+struct EdgeRule {
+  char sensor[EDGE_RULE_ID_LEN];
+  char param[EDGE_RULE_PARAM_LEN];
+  RuleOp op;
+  float on;           // Activate when value op on
+  float off;          // Deactivate when !(value op off); hysteresis band
+  uint32_t forMs;     // Condition must hold this long before activating
+  uint8_t pin;
+  bool state;
+  bool autoOff;       // Apply !state when the rule deactivates
+  
+  bool active;
+  uint32_t pendingSinceMs;
+  bool pending;
+};
+
+static EdgeRule rules[MAX_EDGE_RULES];
+static uint8_t ruleCount = 0;
+// False when the set in NVS could not be loaded, so RAM does not hold it
+static bool rulesMatchStored = true;
+static uint32_t evaluations = 0;
+static uint32_t actionsFired = 0;
+
+static Preferences rulePrefs;
+
+// Scratch space for updates, static to keep it off the MQTT task stack
+static EdgeRule parsedRules[MAX_EDGE_RULES];
+static char ruleJson[EDGE_RULES_MAX_JSON];
+
+static bool parseOp(const char* name, RuleOp &op) {
+  if (strcmp(name, ">") == 0) op = OP_GT;
+  else if (strcmp(name, ">=") == 0) op = OP_GE;
+  else if (strcmp(name, "<") == 0) op = OP_LT;
+  else if (strcmp(name, "<=") == 0) op = OP_LE;
+  else return false;
+  return true;
+}
+
+static bool compare(float value, RuleOp op, float threshold) {
+  switch (op) {
+    case OP_GT: return value > threshold;
+    case OP_GE: return value >= threshold;
+    case OP_LT: return value < threshold;
+    default: return value <= threshold;
+  }
+}
+
+// Parses the whole rule set into a scratch table first so a bad rule
+// leaves the current set untouched
+static bool parseRules(JsonVariantConst json, EdgeRule out[], uint8_t &count) {
+  JsonArrayConst list = json["rules"].as<JsonArrayConst>();
+  count = 0;
+  if (list.isNull()) return json.isNull();  // Empty payload clears the rules
+  if (list.size() > MAX_EDGE_RULES) {
+    Serial.printf("[Rules] ✗ At most %d rules supported\n", MAX_EDGE_RULES);
+    return false;
+  }
+  
+  for (JsonObjectConst item : list) {
+    EdgeRule &rule = out[count];
+    memset(&rule, 0, sizeof(rule));
+    
+    const char* sensor = item["sensor"] | "";
+    const char* param = item["param"] | "";
+    int pin = item["pin"] | 0;
+    if (sensor[0] == '\0' || strlen(sensor) >= sizeof(rule.sensor) ||
+        param[0] == '\0' || strlen(param) >= sizeof(rule.param) ||
+        !parseOp(item["op"] | "", rule.op) || !item["on"].is<float>() || pin < 1 || pin > 8) {
+      Serial.printf("[Rules] ✗ Rule %d invalid (sensor, param, op, on, pin 1-8 required)\n", count);
+      return false;
+    }
+    
+    strlcpy(rule.sensor, sensor, sizeof(rule.sensor));
+    strlcpy(rule.param, param, sizeof(rule.param));
+    rule.on = item["on"];
+    rule.off = item["off"] | rule.on;
+    rule.forMs = item["forMs"] | 0;
+    rule.pin = pin;
+    rule.state = item["state"] | true;
+    rule.autoOff = item["autoOff"] | false;
+    count++;
+  }
+  return true;
+}
+
+void loadEdgeRules() {
+  rulePrefs.begin(EDGE_RULES_NVS_NAMESPACE, false);
+  
+  String stored = rulePrefs.getString("json", "");
+  if (stored.length() == 0) return;
+  
+  JsonDocument doc;
+  if (deserializeJson(doc, stored) || !parseRules(doc.as<JsonVariantConst>(), rules, ruleCount)) {
+    Serial.println("[Rules] ✗ Stored rules unreadable, ignoring");
+    ruleCount = 0;
+    rulesMatchStored = false;
+    return;
+  }
+  Serial.printf("[Rules] ✓ %d rule(s) loaded from NVS\n", ruleCount);
+}
+
+// Returns true when the rule set changed and subscriptions need refreshing
+bool updateEdgeRules(JsonDocument &doc) {
+  uint8_t count;
+  if (!parseRules(doc.as<JsonVariantConst>(), parsedRules, count)) return false;
+  
+  size_t len = doc.isNull() ? 0 : serializeJson(doc, ruleJson, sizeof(ruleJson));
+  if (len >= sizeof(ruleJson) - 1) {
+    Serial.println("[Rules] ✗ Rule set too large to store");
+    return false;
+  }
+  ruleJson[len] = '\0';
+  
+  // The broker re-delivers the retained set on every connect; skip the
+  // flash write when nothing changed, and the rest too unless RAM lost it
+  bool stored = rulePrefs.getString("json", "") == ruleJson;
+  if (stored && rulesMatchStored) return false;
+  if (!stored) rulePrefs.putString("json", ruleJson);
+  
+  memcpy(rules, parsedRules, sizeof(EdgeRule) * count);
+  ruleCount = count;
+  rulesMatchStored = true;
+  Serial.printf("[Rules] ✓ %d rule(s) %s\n", ruleCount, stored ? "applied" : "stored");
+  return true;
+}
+
+uint8_t getEdgeRuleSensors(const char* sensors[], uint8_t max) {
+  uint8_t n = 0;
+  for (uint8_t i = 0; i < ruleCount; i++) {
+    bool seen = false;
+    for (uint8_t j = 0; j < n; j++) {
+      if (strcmp(sensors[j], rules[i].sensor) == 0) seen = true;
+    }
+    if (!seen && n < max) sensors[n++] = rules[i].sensor;
+  }
+  return n;
+}
+
+static void fireRule(const EdgeRule &rule, bool state, int64_t rxUs) {
+  ActuatorCommand cmd;
+  memset(&cmd, 0, sizeof(cmd));
+  cmd.type = ActuatorCommand::RELAY;
+  cmd.pin = rule.pin;
+  cmd.state = state;
+  cmd.timestamp = millis();
+  cmd.rxUs = rxUs;
+  
+  if (queueActuatorCommand(cmd, 0)) {
+    actionsFired++;
+  } else {
+    Serial.println("[Rules] ✗ Command queue full, action dropped");
+  }
+}
+
+// rxUs is when the telemetry packet reached the socket, so the actuation
+// latency of a rule action covers the full sensor-to-relay path on device
+void evaluateEdgeRules(const char* sensorId, JsonDocument &telemetry, int64_t rxUs) {
+  if (telemetry["valid"].is<bool>() && !telemetry["valid"].as<bool>()) return;
+  uint32_t now = millis();
+  
+  for (uint8_t i = 0; i < ruleCount; i++) {
+    EdgeRule &rule = rules[i];
+    if (strcmp(rule.sensor, sensorId) != 0) continue;
+    
+    JsonVariant field = telemetry[rule.param];
+    if (!field.is<float>()) continue;
+    float value = field.as<float>();
+    evaluations++;
+    
+    if (!rule.active) {
+      if (!compare(value, rule.op, rule.on)) {
+        rule.pending = false;
+        continue;
+      }
+      if (!rule.pending) {
+        rule.pending = true;
+        rule.pendingSinceMs = now;
+      }
+      if (now - rule.pendingSinceMs >= rule.forMs) {
+        rule.active = true;
+        rule.pending = false;
+        fireRule(rule, rule.state, rxUs);
+        Serial.printf("[Rules] %s %s=%.2f -> GPIO%d %s\n", rule.sensor, rule.param, value,
+                      rule.pin, rule.state ? "ON" : "OFF");
+      }
+    } else if (!compare(value, rule.op, rule.off)) {
+      rule.active = false;
+      if (rule.autoOff) {
+        fireRule(rule, !rule.state, rxUs);
+        Serial.printf("[Rules] %s %s=%.2f -> GPIO%d %s (auto-off)\n", rule.sensor, rule.param,
+                      value, rule.pin, rule.state ? "OFF" : "ON");
+      }
+    }
+  }
+}
+
+void edgeRulesToJson(JsonObject obj) {
+  obj["count"] = ruleCount;
+  obj["evaluations"] = evaluations;
+  obj["fired"] = actionsFired;
+  
+  uint8_t activeMask = 0;
+  for (uint8_t i = 0; i < ruleCount; i++) {
+    if (rules[i].active) activeMask |= (1 << i);
+  }
+  obj["active"] = activeMask;
+}
@@ -0,0 +1,349 @@
+/*
+ * Digital Inputs Implementation
+ *
+ * Each enabled input has a CHANGE interrupt that only stamps the edge with
+ * esp_timer and hands it to TaskInputs through a queue. TaskInputs blocks on
+ * that queue and debounces in software: the first edge is accepted at once
+ * (so the event carries the ISR timestamp), edges inside the debounce window
+ * after it are counted as bounce, and the pin is read once more when the
+ * window closes in case it really moved. The ESP32-S3 has no configurable
+ * GPIO glitch filter on this IDF, so noisy contacts should add an RC filter
+ * in hardware. Accepted edges are queued for TaskMQTT, which publishes them
+ * on devices/<id>/inputs and records the ISR -> publish latency.
+ */
+
+#include "input_handler.h"
+#include "globals.h"
+#include "mqtt_handler.h"
+#include <esp_timer.h>
+#include <driver/gpio.h>
+#include <soc/gpio_reg.h>
+
+enum InputPull : uint8_t { PULL_NONE = 0, PULL_UP = 1, PULL_DOWN = 2 };
+
+// Stored as an NVS blob, keep the layout stable
+struct InputConfig {
+  uint8_t enabled;
+  uint8_t pull;
+  uint8_t activeLow;
+  uint8_t reserved;
+  uint16_t debounceMs;
+};
+
+struct InputChannel {
+  bool attached;
+  bool level;          // Debounced pin level
+  bool settlePending;  // Re-read the pin when the debounce window closes
+  int64_t lastEdgeUs;  // Last accepted edge
+};
+
+static InputConfig configs[INPUT_CHANNEL_COUNT];
+static InputConfig pendingConfigs[INPUT_CHANNEL_COUNT];
+static bool configPending = false;
+static InputChannel channels[INPUT_CHANNEL_COUNT];
+static Preferences inputPrefs;
+static portMUX_TYPE inputMux = portMUX_INITIALIZER_UNLOCKED;
+
+// initInputs() installs the GPIO ISR service with ESP_INTR_FLAG_IRAM and
+// registers inputIsr with it directly (Arduino's attachInterrupt would put
+// its flash-resident dispatcher in between), so everything the handler
+// touches has to stay reachable while the flash cache is off
+static DRAM_ATTR uint8_t isrPins[INPUT_CHANNEL_COUNT];
+static DRAM_ATTR QueueHandle_t isrQueue = NULL;
+static DRAM_ATTR volatile uint32_t isrLost = 0;
+
+static StaticQueue_t isrQueueControl;
+static uint8_t isrQueueStorage[INPUT_ISR_QUEUE_LENGTH * sizeof(InputEvent)];
+static StaticQueue_t eventQueueControl;
+static uint8_t eventQueueStorage[INPUT_EVENT_QUEUE_LENGTH * sizeof(InputEvent)];
+static QueueHandle_t eventQueue = NULL;
+
+static volatile uint8_t activeMask = 0;
+static uint32_t eventSeq = 0;
+static uint32_t acceptedEdges = 0;
+static uint32_t bounces = 0;
+static volatile uint32_t publishLost = 0;
+
+// ========== ISR ==========
+
+static void IRAM_ATTR inputIsr(void* arg) {
+  uint8_t idx = (uint32_t)arg;
+  uint8_t pin = isrPins[idx];
+  uint32_t in = (pin < 32) ? REG_READ(GPIO_IN_REG) : REG_READ(GPIO_IN1_REG);
+  
+  InputEvent event;
+  event.channel = idx;
+  event.level = (in >> (pin & 31)) & 1;
+  event.settled = false;
+  event.us = esp_timer_get_time();
+  event.seq = 0;
+  
+  BaseType_t woken = pdFALSE;
+  if (xQueueSendFromISR(isrQueue, &event, &woken) != pdTRUE) isrLost++;
+  if (woken) portYIELD_FROM_ISR();
+}
+
+// ========== CHANNEL SETUP (TaskInputs, or setup() before it starts) ==========
+
+static void setDefaultConfig() {
+  for (int i = 0; i < INPUT_CHANNEL_COUNT; i++) {
+    configs[i].enabled = 1;
+    configs[i].pull = PULL_UP;
+    configs[i].activeLow = 1;   // Switch to GND with the internal pull-up
+    configs[i].reserved = 0;
+    configs[i].debounceMs = INPUT_DEFAULT_DEBOUNCE_MS;
+  }
+}
+
+static bool isActive(uint8_t idx, bool level) {
+  return configs[idx].activeLow ? !level : level;
+}
+
+static void setActiveBit(uint8_t idx, bool active) {
+  if (active) activeMask |= (1 << idx);
+  else activeMask &= ~(1 << idx);
+}
+
+static void setupChannel(uint8_t idx) {
+  InputChannel &ch = channels[idx];
+  uint8_t pin = gpioInputPins[idx];
+  
+  if (ch.attached) {
+    gpio_intr_disable((gpio_num_t)pin);
+    gpio_isr_handler_remove((gpio_num_t)pin);
+    ch.attached = false;
+  }
+  
+  const InputConfig &cfg = configs[idx];
+  ch.settlePending = false;
+  ch.lastEdgeUs = 0;
+  if (!cfg.enabled) {
+    pinMode(pin, INPUT);
+    setActiveBit(idx, false);
+    return;
+  }
+  
+  pinMode(pin, cfg.pull == PULL_UP ? INPUT_PULLUP :
+               cfg.pull == PULL_DOWN ? INPUT_PULLDOWN : INPUT);
+  ch.level = digitalRead(pin);
+  setActiveBit(idx, isActive(idx, ch.level));
+  gpio_set_intr_type((gpio_num_t)pin, GPIO_INTR_ANYEDGE);
+  gpio_isr_handler_add((gpio_num_t)pin, inputIsr, (void*)(uint32_t)idx);
+  gpio_intr_enable((gpio_num_t)pin);
+  ch.attached = true;
+}
+
+static void applyPendingConfig() {
+  portENTER_CRITICAL(&inputMux);
+  bool pending = configPending;
+  if (pending) {
+    memcpy(configs, pendingConfigs, sizeof(configs));
+    configPending = false;
+  }
+  portEXIT_CRITICAL(&inputMux);
+  if (!pending) return;
+  
+  for (int i = 0; i < INPUT_CHANNEL_COUNT; i++) {
+    setupChannel(i);
+  }
+  Serial.printf("[Inputs] ✓ Reconfigured, active mask 0x%02X\n", activeMask);
+}
+
+void initInputs() {
+  isrQueue = xQueueCreateStatic(INPUT_ISR_QUEUE_LENGTH, sizeof(InputEvent),
+                                isrQueueStorage, &isrQueueControl);
+  eventQueue = xQueueCreateStatic(INPUT_EVENT_QUEUE_LENGTH, sizeof(InputEvent),
+                                  eventQueueStorage, &eventQueueControl);
+  
+  // Nothing else on the actuator installs the service first; if something
+  // did, its flags stand and input edges may wait out flash writes
+  esp_err_t err = gpio_install_isr_service(ESP_INTR_FLAG_IRAM);
+  if (err == ESP_ERR_INVALID_STATE) {
+    Serial.println("[Inputs] GPIO ISR service already installed, IRAM flag not guaranteed");
+  } else if (err != ESP_OK) {
+    Serial.printf("[Inputs] ✗ GPIO ISR service install failed (%d)\n", err);
+  }
+  
+  setDefaultConfig();
+  inputPrefs.begin(INPUT_NVS_NAMESPACE, false);
+  if (inputPrefs.getBytesLength("config") == sizeof(configs)) {
+    inputPrefs.getBytes("config", configs, sizeof(configs));
+  }
+  
+  for (int i = 0; i < INPUT_CHANNEL_COUNT; i++) {
+    isrPins[i] = gpioInputPins[i];
+    setupChannel(i);
+  }
+  Serial.printf("[Inputs] ✓ %d input channels, active mask 0x%02X\n",
+                INPUT_CHANNEL_COUNT, activeMask);
+}
+
+// ========== DEBOUNCE (TaskInputs) ==========
+
+static void acceptEdge(uint8_t idx, bool level, int64_t us, bool settled) {
+  InputChannel &ch = channels[idx];
+  ch.level = level;
+  ch.lastEdgeUs = us;
+  ch.settlePending = true;
+  acceptedEdges++;
+  
+  bool active = isActive(idx, level);
+  setActiveBit(idx, active);
+  
+  InputEvent event;
+  event.channel = idx;
+  event.level = active;
+  event.settled = settled;
+  event.us = us;
+  event.seq = ++eventSeq;
+  
+  if (xQueueSend(eventQueue, &event, 0) != pdTRUE) {
+    publishLost++;
+    return;
+  }
+  wakeMQTTTask();
+}
+
+static void handleEdge(const InputEvent &raw) {
+  // INPUT_RECONFIGURE only wakes the task; the config is applied below
+  if (raw.channel >= INPUT_CHANNEL_COUNT || !channels[raw.channel].attached) return;
+  
+  InputChannel &ch = channels[raw.channel];
+  int64_t window = (int64_t)configs[raw.channel].debounceMs * 1000;
+  
+  // Edges inside the window, or ones that leave the level where it was, are
+  // contact bounce; the settle check catches a level that really moved
+  if (raw.us - ch.lastEdgeUs < window || raw.level == ch.level) {
+    bounces++;
+    ch.settlePending = true;
+    return;
+  }
+  acceptEdge(raw.channel, raw.level, raw.us, false);
+}
+
+// Re-reads channels whose debounce window has closed and returns how long
+// TaskInputs may block before the next one is due
+static TickType_t settleChannels() {
+  int64_t now = esp_timer_get_time();
+  int64_t nextDueUs = INT64_MAX;
+  
+  for (int i = 0; i < INPUT_CHANNEL_COUNT; i++) {
+    InputChannel &ch = channels[i];
+    if (!ch.settlePending) continue;
+  
+    int64_t window = (int64_t)configs[i].debounceMs * 1000;
+    int64_t dueUs = ch.lastEdgeUs + window;
+    if (now >= dueUs) {
+      ch.settlePending = false;
+      bool level = digitalRead(gpioInputPins[i]);
+      if (level == ch.level) continue;
+      acceptEdge(i, level, now, true);
+      dueUs = now + window;
+    }
+    if (dueUs < nextDueUs) nextDueUs = dueUs;
+  }
+  
+  if (nextDueUs == INT64_MAX) return portMAX_DELAY;
+  return pdMS_TO_TICKS((nextDueUs - now + 999) / 1000) + 1;
+}
+
+// One pass of TaskInputs: block until an edge arrives or a settle check is
+// due, never polling the pins in between
+void processInputEvents() {
+  InputEvent raw;
+  applyPendingConfig();
+  TickType_t wait = settleChannels();
+  
+  if (xQueueReceive(isrQueue, &raw, wait) == pdTRUE) {
+    handleEdge(raw);
+    while (xQueueReceive(isrQueue, &raw, 0) == pdTRUE) {
+      handleEdge(raw);
+    }
+  }
+}
+
+// Called from TaskMQTT
+bool takeInputEvent(InputEvent &event) {
+  if (eventQueue == NULL) return false;
+  return xQueueReceive(eventQueue, &event, 0) == pdTRUE;
+}
+
+// ========== CONFIGURATION ==========
+
+bool configureInputs(JsonVariantConst json) {
+  JsonArrayConst list = json.as<JsonArrayConst>();
+  if (list.isNull() || list.size() > INPUT_CHANNEL_COUNT) {
+    Serial.printf("[Inputs] ✗ inputs must be an array of up to %d entries\n", INPUT_CHANNEL_COUNT);
+    return false;
+  }
+  
+  InputConfig updated[INPUT_CHANNEL_COUNT];
+  portENTER_CRITICAL(&inputMux);
+  memcpy(updated, configPending ? pendingConfigs : configs, sizeof(updated));
+  portEXIT_CRITICAL(&inputMux);
+  
+  for (JsonObjectConst entry : list) {
+    int ch = entry["ch"] | 0;
+    if (ch < 1 || ch > INPUT_CHANNEL_COUNT) {
+      Serial.printf("[Inputs] ✗ Invalid input channel %d\n", ch);
+      return false;
+    }
+  
+    InputConfig &cfg = updated[ch - 1];
+    if (entry["enabled"].is<bool>()) cfg.enabled = entry["enabled"].as<bool>();
+    if (entry["activeLow"].is<bool>()) cfg.activeLow = entry["activeLow"].as<bool>();
+    if (entry["debounceMs"].is<uint32_t>()) {
+      uint32_t ms = entry["debounceMs"];
+      if (ms > INPUT_MAX_DEBOUNCE_MS) {
+        Serial.printf("[Inputs] ✗ debounceMs above %d\n", INPUT_MAX_DEBOUNCE_MS);
+        return false;
+      }
+      cfg.debounceMs = ms;
+    }
+  
+    const char* pull = entry["pull"];
+    if (pull != NULL) {
+      if (strcmp(pull, "up") == 0) cfg.pull = PULL_UP;
+      else if (strcmp(pull, "down") == 0) cfg.pull = PULL_DOWN;
+      else if (strcmp(pull, "none") == 0) cfg.pull = PULL_NONE;
+      else {
+        Serial.printf("[Inputs] ✗ Unknown pull '%s'\n", pull);
+        return false;
+      }
+    }
+  }
+  
+  portENTER_CRITICAL(&inputMux);
+  memcpy(pendingConfigs, updated, sizeof(pendingConfigs));
+  configPending = true;
+  portEXIT_CRITICAL(&inputMux);
+  inputPrefs.putBytes("config", updated, sizeof(updated));
+  
+  // Interrupts are (re)attached by TaskInputs, which owns the channel state
+  InputEvent marker;
+  memset(&marker, 0, sizeof(marker));
+  marker.channel = INPUT_RECONFIGURE;
+  if (xQueueSend(isrQueue, &marker, pdMS_TO_TICKS(10)) != pdTRUE) {
+    Serial.println("[Inputs] ✗ Edge queue full, config applies after the next edge");
+  }
+  return true;
+}
+
+uint8_t getInputMask() {
+  return activeMask;
+}
+
+void inputsToJson(JsonObject obj) {
+  uint8_t enabled = 0;
+  for (int i = 0; i < INPUT_CHANNEL_COUNT; i++) {
+    if (configs[i].enabled) enabled |= (1 << i);
+  }
+  
+  obj["mask"] = activeMask;
+  obj["enabled"] = enabled;
+  obj["edges"] = acceptedEdges;
+  obj["bounces"] = bounces;
+  obj["isrLost"] = isrLost;
+  obj["publishLost"] = publishLost;
+  latencyToJson(inputLatency, obj["latency"].to<JsonObject>());
+}
@@ -11,6 +11,8 @@
 #include "web_server.h"
 #include "neopixel_handler.h"
 #include "tasks.h"
+#include "state_store.h"
+#include "input_handler.h"
 #include <Arduino.h>
 
 // ========== GLOBAL OBJECT INSTANCES ==========
@@ -19,7 +21,7 @@ WebServer webServer(WEB_PORT);
 DNSServer dnsServer;
 WiFiClient espClient;
 PubSubClient mqttClient(espClient);
-Adafruit_NeoPixel pixel(1, NEOPIXEL_WIFI, NEO_GRB + NEO_KHZ800);
+Adafruit_NeoPixel pixel(NEOPIXEL_COUNT, NEOPIXEL_WIFI, NEO_GRB + NEO_KHZ800);
 
 // ========== GLOBAL VARIABLES ==========
 String deviceId;
@@ -35,7 +37,15 @@ bool mqttConnected = false;
 
 SemaphoreHandle_t commandMutex;
 QueueHandle_t commandQueue;
+QueueHandle_t ackQueue;
 EventGroupHandle_t connectionEvents;
+TaskHandle_t actuatorTaskHandle = NULL;
+
+// Command queue storage is reserved up front; commands are copied in by value
+static StaticQueue_t commandQueueControl;
+static uint8_t commandQueueStorage[ACTUATOR_QUEUE_LENGTH * sizeof(ActuatorCommand)];
+static StaticQueue_t ackQueueControl;
+static uint8_t ackQueueStorage[ACK_QUEUE_LENGTH * sizeof(CommandAck)];
 
 // ========== ACTUATOR STATE ==========
 // GPIO output pins mapping (8 channels)
@@ -47,6 +57,9 @@ const uint8_t gpioOutputPins[8] = {
 // GPIO state tracking
 bool gpioStates[8] = {false, false, false, false, false, false, false, false};
 
+// GPIO input pins mapping (clear of the strapping, USB and output pins)
+const uint8_t gpioInputPins[INPUT_CHANNEL_COUNT] = {1, 2, 41, 42};
+
 struct ActuatorState {
   bool relayState;
   uint8_t ledBrightness;
@@ -55,6 +68,12 @@ struct ActuatorState {
   uint32_t errorCount;
 } actuatorState = {false, 0, 0, 0, 0};
 
+// ========== METRICS ==========
+LatencyStats mqttRxLatency = {};
+LatencyStats actuationLatency = {};
+LatencyStats timerDrift = {};
+LatencyStats inputLatency = {};
+
 // ========== BUTTON STATE ==========
 unsigned long buttonPressStart = 0;
 bool buttonPressed = false;
@@ -84,16 +103,9 @@ void checkResetButton() {
       configResetHandled = true;
       Serial.println("[Button] ⚠ CONFIG RESET TRIGGERED!");
       
-      // Visual feedback
-      pixel.setPixelColor(0, pixel.Color(255, 0, 0));
-      pixel.show();
-      delay(500);
-      pixel.setPixelColor(0, pixel.Color(0, 0, 0));
-      pixel.show();
-      delay(200);
-      pixel.setPixelColor(0, pixel.Color(255, 0, 0));
-      pixel.show();
-      delay(500);
+      // Visual feedback (drawn by TaskUI while we wait)
+      flashLeds(pixel.Color(255, 0, 0), 1200, 400);
+      delay(1200);
       
       // Reset config
       resetConfig();
@@ -106,13 +118,21 @@ void checkResetButton() {
   }
 }
 
+// Unit tests link the firmware sources but bring their own setup()/loop()
+#ifndef PIO_UNIT_TESTING
+
 void setup() {
+  // Outputs come back before anything else so a watchdog or brownout reset
+  // does not drop the relays for the whole WiFi/MQTT bring-up
+  restoreOutputState();
+  
   Serial.begin(115200);
   delay(1000);
   
   Serial.println("\n\n" + String('=', 50));
   Serial.println("ESP32-S3 Actuator Device v2.0");
   Serial.println(String('=', 50));
+  logRestoredState();
   
   // Setup reset button
   pinMode(RESET_BUTTON_PIN, INPUT_PULLUP);
@@ -135,14 +155,17 @@ void setup() {
   
   // Create FreeRTOS synchronization primitives
   commandMutex = xSemaphoreCreateMutex();
-  commandQueue = xQueueCreate(20, sizeof(String));  // Buffer 20 commands
+  commandQueue = xQueueCreateStatic(ACTUATOR_QUEUE_LENGTH, sizeof(ActuatorCommand),
+                                    commandQueueStorage, &commandQueueControl);
+  ackQueue = xQueueCreateStatic(ACK_QUEUE_LENGTH, sizeof(CommandAck),
+                                ackQueueStorage, &ackQueueControl);
   connectionEvents = xEventGroupCreate();
   
-  if (!commandMutex || !commandQueue || !connectionEvents) {
+  if (!commandMutex || !commandQueue || !ackQueue || !connectionEvents) {
     Serial.println("[FreeRTOS] Failed to create primitives!");
     while (1) delay(1000);
   }
-  Serial.println("[FreeRTOS] Mutex, Queue (20), and Events created");
+  Serial.println("[FreeRTOS] Mutex, Queue (" + String(ACTUATOR_QUEUE_LENGTH) + "), and Events created");
   
   // Determine mode
   if (wifiSSID.length() == 0) {
@@ -156,10 +179,16 @@ void setup() {
   // Setup web server
   setupWebServer();
   
+  // Inputs are armed before the tasks start; early edges wait in the queue
+  initInputs();
+  
   // Create FreeRTOS tasks (no sensor task)
-  xTaskCreatePinnedToCore(TaskUI, "UI", 2048, NULL, 1, NULL, 0);
+  xTaskCreatePinnedToCore(TaskUI, "UI", UI_TASK_STACK, NULL, 1, NULL, 0);
   xTaskCreatePinnedToCore(TaskMQTT, "MQTT", 4096, NULL, 2, NULL, 1);
-  xTaskCreatePinnedToCore(TaskActuator, "Actuator", 4096, NULL, 2, NULL, 1);
+  xTaskCreatePinnedToCore(TaskActuator, "Actuator", 4096, NULL, ACTUATOR_TASK_PRIORITY,
+                          &actuatorTaskHandle, ACTUATOR_TASK_CORE);
+  xTaskCreatePinnedToCore(TaskInputs, "Inputs", 3072, NULL, INPUT_TASK_PRIORITY,
+                          NULL, INPUT_TASK_CORE);
   
   Serial.println("[Setup] Complete!");
 }
@@ -175,3 +204,5 @@ void loop() {
   webServer.handleClient();
   delay(10);
 }
+
+#endif // PIO_UNIT_TESTING
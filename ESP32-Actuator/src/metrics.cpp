@@ -0,0 +1,65 @@
+/*
+ * Latency Metrics Implementation
+ */
+
+#include "metrics.h"
+
+// Stats are written from task context and read by the web server / MQTT
+// publisher, so every access goes through one short critical section.
+static portMUX_TYPE metricsMux = portMUX_INITIALIZER_UNLOCKED;
+
+static uint8_t bucketFor(uint32_t us) {
+  uint8_t bucket = 0;
+  while (us > 0 && bucket < LATENCY_BUCKETS - 1) {
+    us >>= 1;
+    bucket++;
+  }
+  return bucket;
+}
+
+void recordLatency(LatencyStats &stats, uint32_t us) {
+  uint8_t bucket = bucketFor(us);
+
+  portENTER_CRITICAL(&metricsMux);
+  stats.count++;
+  stats.lastUs = us;
+  if (us > stats.maxUs) stats.maxUs = us;
+  stats.totalUs += us;
+  stats.buckets[bucket]++;
+  portEXIT_CRITICAL(&metricsMux);
+}
+
+void snapshotLatency(const LatencyStats &stats, LatencyStats &out) {
+  portENTER_CRITICAL(&metricsMux);
+  memcpy(&out, &stats, sizeof(LatencyStats));
+  portEXIT_CRITICAL(&metricsMux);
+}
+
+// Returns the upper bound of the bucket containing the requested percentile,
+// clamped to the observed maximum.
+uint32_t latencyPercentile(const LatencyStats &stats, uint8_t percentile) {
+  if (stats.count == 0) return 0;
+
+  uint64_t target = ((uint64_t)stats.count * percentile + 99) / 100;
+  uint64_t seen = 0;
+  for (uint8_t i = 0; i < LATENCY_BUCKETS; i++) {
+    seen += stats.buckets[i];
+    if (seen >= target) {
+      uint32_t upper = (i == 0) ? 0 : ((1UL << i) - 1);
+      return upper < stats.maxUs ? upper : stats.maxUs;
+    }
+  }
+  return stats.maxUs;
+}
+
+void latencyToJson(const LatencyStats &stats, JsonObject obj) {
+  LatencyStats snap;
+  snapshotLatency(stats, snap);
+
+  obj["n"] = snap.count;
+  obj["lastUs"] = snap.lastUs;
+  obj["avgUs"] = snap.count ? (uint32_t)(snap.totalUs / snap.count) : 0;
+  obj["p50Us"] = latencyPercentile(snap, 50);
+  obj["p99Us"] = latencyPercentile(snap, 99);
+  obj["maxUs"] = snap.maxUs;
+}
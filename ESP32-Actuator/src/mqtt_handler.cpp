@@ -5,33 +5,179 @@
 #include "mqtt_handler.h"
 #include "globals.h"
 #include "neopixel_handler.h"
+#include "json_pool.h"
+#include "actuator.h"
+#include "pwm_handler.h"
+#include "output_timers.h"
+#include "state_store.h"
+#include "edge_rules.h"
+#include "input_handler.h"
+#include <unistd.h>
 #include <Arduino.h>
 #include <ArduinoJson.h>
+#include <lwip/sockets.h>
+#include <esp_timer.h>
+#include <esp_vfs_eventfd.h>
+
+// Time the socket was last seen readable; the first callback after a wake
+// measures against it and clears it, so later packets from the same drain
+// are not charged to an old timestamp.
+static int64_t rxReadyUs = 0;
+
+// eventfd that other tasks write to so TaskMQTT leaves select() early
+static int wakeFd = -1;
+static volatile bool statePending = false;
+static bool ruleRoutesStale = false;
+
+// ========== TOPIC ROUTING ==========
+typedef void (*TopicHandler)(const char* topic, JsonDocument &doc);
+
+struct TopicRoute {
+  char topic[MQTT_TOPIC_MAX_LEN];
+  TopicHandler handler;
+};
+
+static TopicRoute routes[MQTT_MAX_ROUTES];
+static uint8_t routeCount = 0;
+static uint8_t staticRouteCount = 0;  // Routes after this follow the rule set
+
+// Callbacks parse into a fixed pool instead of the heap
+static StaticJsonPool<MQTT_JSON_POOL_SIZE> jsonPool;
+static JsonDocument mqttDoc(&jsonPool);
+
+static void handleGpioSet(const char* topic, JsonDocument &doc) {
+  // Parse once here; TaskActuator only ever sees the POD command
+  ActuatorCommand cmd;
+  if (!parseActuatorCommand(doc.as<JsonVariantConst>(), cmd)) {
+    ackActuatorCommand(cmd, false, "invalid");
+    return;
+  }
+  if (rxReadyUs > 0) cmd.rxUs = rxReadyUs;
+  
+  if (!queueActuatorCommand(cmd, pdMS_TO_TICKS(100))) {
+    Serial.println("[MQTT] ✗ Failed to queue GPIO command (queue full?)");
+    ackActuatorCommand(cmd, false, "busy");
+  }
+}
+
+// Schedules are configured directly; esp_timer calls are thread-safe and
+// the resulting ticks reach TaskActuator through the command queue
+static void handleSchedule(const char* topic, JsonDocument &doc) {
+  configureSchedule(doc.as<JsonVariantConst>());
+}
+
+// Sensor telemetry subscribed on behalf of the edge rules
+static void handleSensorTelemetry(const char* topic, JsonDocument &doc) {
+  // devices/<sensor>/telemetry
+  const char* start = topic + strlen("devices/");
+  const char* end = strchr(start, '/');
+  if (end == NULL || end - start >= EDGE_RULE_ID_LEN) return;
+  
+  char sensorId[EDGE_RULE_ID_LEN];
+  memcpy(sensorId, start, end - start);
+  sensorId[end - start] = '\0';
+  evaluateEdgeRules(sensorId, doc, rxReadyUs > 0 ? rxReadyUs : esp_timer_get_time());
+}
+
+// Subscriptions are changed from processMQTTOutbound, never from inside
+// the callback while PubSubClient's buffer still holds the payload
+static void handleRules(const char* topic, JsonDocument &doc) {
+  if (updateEdgeRules(doc)) ruleRoutesStale = true;
+}
+
+static void handleSystemCmd(const char* topic, JsonDocument &doc) {
+  const char* cmd = doc["cmd"];
+  if (cmd == NULL) return;
+  
+  if (strcmp(cmd, "reboot") == 0) {
+    Serial.println("[CMD] Rebooting...");
+    delay(1000);
+    ESP.restart();
+  } else if (strcmp(cmd, "power_policy") == 0) {
+    setPowerOnPolicy(doc["policy"]);
+  } else if (strcmp(cmd, "inputs") == 0) {
+    configureInputs(doc["inputs"]);
+  }
+}
+
+// Topic strings are built once per connection; the callback then only
+// does a strcmp per route instead of allocating and suffix matching.
+static void addTopicRoute(const char* topic, TopicHandler handler) {
+  if (routeCount >= MQTT_MAX_ROUTES) {
+    Serial.printf("[MQTT] ✗ Route table full, not subscribing to %s\n", topic);
+    return;
+  }
+  
+  TopicRoute &route = routes[routeCount];
+  strlcpy(route.topic, topic, sizeof(route.topic));
+  route.handler = handler;
+  routeCount++;
+  
+  mqttClient.subscribe(route.topic);
+  Serial.printf("[MQTT] Subscribed to: %s\n", route.topic);
+}
+
+static void addRoute(const char* suffix, TopicHandler handler) {
+  char topic[MQTT_TOPIC_MAX_LEN];
+  snprintf(topic, sizeof(topic), "device/%s/%s", deviceId.c_str(), suffix);
+  addTopicRoute(topic, handler);
+}
+
+// Replaces the telemetry subscriptions with the sensors the rules watch
+static void refreshRuleRoutes() {
+  for (uint8_t i = staticRouteCount; i < routeCount; i++) {
+    mqttClient.unsubscribe(routes[i].topic);
+  }
+  routeCount = staticRouteCount;
+  
+  const char* sensors[MAX_EDGE_RULES];
+  uint8_t count = getEdgeRuleSensors(sensors, MAX_EDGE_RULES);
+  for (uint8_t i = 0; i < count; i++) {
+    char topic[MQTT_TOPIC_MAX_LEN];
+    snprintf(topic, sizeof(topic), "devices/%s/telemetry", sensors[i]);
+    addTopicRoute(topic, handleSensorTelemetry);
+  }
+}
+
+static const TopicRoute* findRoute(const char* topic) {
+  for (uint8_t i = 0; i < routeCount; i++) {
+    if (strcmp(routes[i].topic, topic) == 0) return &routes[i];
+  }
+  return NULL;
+}
 
 void connectMQTT() {
   if (!wifiConnected || mqttServer.length() == 0) return;
   
   mqttClient.setServer(mqttServer.c_str(), mqttPort);
   mqttClient.setCallback(mqttCallback);
-  mqttClient.setBufferSize(512);
+  mqttClient.setBufferSize(2048);
+  mqttClient.setKeepAlive(MQTT_KEEPALIVE_S);
   
   Serial.print("[MQTT] Connecting to: " + mqttServer + ":" + String(mqttPort));
   
-  if (mqttClient.connect(deviceId.c_str())) {
+  // Retained Last Will: the broker marks us offline if the link drops.
+  // publishStatus() replaces it with the online status once connected.
+  static char willTopic[MQTT_TOPIC_MAX_LEN];
+  snprintf(willTopic, sizeof(willTopic), "devices/%s/status", deviceId.c_str());
+  
+  if (mqttClient.connect(deviceId.c_str(), willTopic, 1, true, "{\"online\":false}")) {
     mqttConnected = true;
     xEventGroupSetBits(connectionEvents, MQTT_CONNECTED_BIT);
     Serial.println(" Connected!");
     
-    // Subscribe to GPIO control topic
-    String gpioTopic = "device/" + deviceId + "/gpio/set";
-    String cmdTopic = "device/" + deviceId + "/cmd";
-    mqttClient.subscribe(gpioTopic.c_str());
-    mqttClient.subscribe(cmdTopic.c_str());
-    Serial.println("[MQTT] Subscribed to: " + gpioTopic);
-    Serial.println("[MQTT] Subscribed to: " + cmdTopic);
+    // Subscribe to GPIO control and system command topics
+    routeCount = 0;
+    addRoute("gpio/set", handleGpioSet);
+    addRoute("schedule", handleSchedule);
+    addRoute("cmd", handleSystemCmd);
+    addRoute("rules", handleRules);
+    staticRouteCount = routeCount;
+    refreshRuleRoutes();
     
-    // Publish status
+    // Publish status and refresh the retained output state
     publishStatus();
+    statePending = true;
     updateNeoPixel();
   } else {
     Serial.println(" Failed, rc=" + String(mqttClient.state()));
@@ -39,49 +185,140 @@ void connectMQTT() {
 }
 
 void mqttCallback(char* topic, uint8_t* payload, unsigned int length) {
-  String topicStr = String(topic);
-  String payloadStr;
-  for (unsigned int i = 0; i < length; i++) {
-    payloadStr += (char)payload[i];
+  if (rxReadyUs > 0) {
+    recordLatency(mqttRxLatency, (uint32_t)(esp_timer_get_time() - rxReadyUs));
   }
   
-  Serial.println("[MQTT] Topic: " + topicStr);
-  Serial.println("[MQTT] Payload: " + payloadStr);
-  
-  JsonDocument doc;
-  DeserializationError error = deserializeJson(doc, payloadStr);
-  if (error) {
-    Serial.println("[MQTT] JSON parse error");
+  const TopicRoute* route = findRoute(topic);
+  if (route == NULL) {
+    rxReadyUs = 0;
+    Serial.printf("[MQTT] No route for topic: %s\n", topic);
     return;
   }
   
-  // Handle GPIO control commands
-  if (topicStr.endsWith("/gpio/set")) {
-    Serial.println("[MQTT] GPIO control command received");
-    // Forward GPIO command to actuator task
-    if (commandQueue != NULL) {
-      String command = payloadStr;
-      BaseType_t result = xQueueSend(commandQueue, &command, pdMS_TO_TICKS(100));
-      if (result == pdTRUE) {
-        Serial.println("[MQTT] ✓ GPIO command queued successfully");
-      } else {
-        Serial.println("[MQTT] ✗ Failed to queue GPIO command (queue full?)");
-      }
-    } else {
-      Serial.println("[MQTT] ✗ Command queue is NULL!");
+  // Parse straight from PubSubClient's receive buffer into the static pool.
+  // An empty payload (cleared retained message) dispatches a null document.
+  mqttDoc.clear();
+  jsonPool.reset();
+  if (length > 0) {
+    DeserializationError error = deserializeJson(mqttDoc, (const uint8_t*)payload, length);
+    if (error) {
+      rxReadyUs = 0;
+      Serial.printf("[MQTT] JSON parse error: %s\n", error.c_str());
+      return;
     }
   }
-  // Handle general commands
-  else if (topicStr.endsWith("/cmd")) {
-    const char* cmd = doc["cmd"];
-    if (strcmp(cmd, "reboot") == 0) {
-      Serial.println("[CMD] Rebooting...");
-      delay(1000);
-      ESP.restart();
-    }
+  
+  route->handler(topic, mqttDoc);
+  rxReadyUs = 0;
+  
+  // Logged after dispatch so serial output stays off the command path
+  Serial.printf("[MQTT] %s: %.*s\n", topic, (int)length, (const char*)payload);
+}
+
+// Drain every packet already sitting in the socket so a burst of commands
+// is dispatched in one wake-up instead of one per loop interval.
+void processMQTTInbound() {
+  int packets = 0;
+  do {
+    if (!mqttClient.loop()) break;
+  } while (espClient.available() > 0 && ++packets < MQTT_MAX_PACKETS_PER_WAKE);
+}
+
+// Publishes everything other tasks asked for since the last wake-up
+void processMQTTOutbound() {
+  if (ruleRoutesStale) {
+    ruleRoutesStale = false;
+    refreshRuleRoutes();
+  }
+  
+  // State first so an ack never arrives ahead of the state it reports
+  if (statePending) {
+    statePending = false;
+    publishState();
+  }
+  
+  CommandAck ack;
+  while (ackQueue != NULL && xQueueReceive(ackQueue, &ack, 0) == pdTRUE) {
+    publishAck(ack);
+  }
+  
+  InputEvent event;
+  while (takeInputEvent(event)) {
+    publishInputEvent(event);
+  }
+}
+
+// Called from TaskActuator; acks that do not fit are dropped and the
+// sender falls back to its timeout
+void queueCommandAck(const CommandAck &ack) {
+  if (ackQueue == NULL) return;
+  if (xQueueSend(ackQueue, &ack, 0) != pdTRUE) {
+    Serial.println("[MQTT] ✗ Ack queue full, dropping ack");
+    return;
+  }
+  wakeMQTTTask();
+}
+
+void initMQTTWakeup() {
+  esp_vfs_eventfd_config_t config = ESP_VFS_EVENTD_CONFIG_DEFAULT();
+  esp_vfs_eventfd_register(&config);
+  wakeFd = eventfd(0, 0);
+  if (wakeFd < 0) {
+    Serial.println("[MQTT] ✗ eventfd unavailable, outbound events wait for the next wake-up");
   }
 }
 
+void wakeMQTTTask() {
+  if (wakeFd < 0) return;
+  uint64_t one = 1;
+  write(wakeFd, &one, sizeof(one));
+}
+
+void requestStatePublish() {
+  statePending = true;
+  wakeMQTTTask();
+}
+
+// Sleep until the broker socket becomes readable, another task calls
+// wakeMQTTTask(), or timeoutMs elapses. Returns true if inbound data is pending.
+bool waitForMQTTData(uint32_t timeoutMs) {
+  if (espClient.available() > 0) {
+    rxReadyUs = esp_timer_get_time();
+    return true;
+  }
+  
+  int fd = espClient.fd();
+  if (fd < 0) {
+    vTaskDelay(pdMS_TO_TICKS(timeoutMs));
+    return false;
+  }
+  
+  fd_set readSet;
+  FD_ZERO(&readSet);
+  FD_SET(fd, &readSet);
+  if (wakeFd >= 0) FD_SET(wakeFd, &readSet);
+  int maxFd = (wakeFd > fd) ? wakeFd : fd;
+  struct timeval tv;
+  tv.tv_sec = timeoutMs / 1000;
+  tv.tv_usec = (timeoutMs % 1000) * 1000;
+  
+  if (select(maxFd + 1, &readSet, NULL, NULL, &tv) <= 0) return false;
+  
+  if (wakeFd >= 0 && FD_ISSET(wakeFd, &readSet)) {
+    uint64_t count;
+    read(wakeFd, &count, sizeof(count));
+  }
+  
+  // A closed or errored socket also reports readable; loop() will then
+  // notice the disconnect and TaskMQTT reconnects.
+  if (FD_ISSET(fd, &readSet)) {
+    rxReadyUs = esp_timer_get_time();
+    return true;
+  }
+  return false;
+}
+
 void publishStatus() {
   if (!mqttConnected) return;
   
@@ -98,6 +335,56 @@ void publishStatus() {
   mqttClient.publish(topic.c_str(), buffer, true);
 }
 
+// Compact, retained output state: late subscribers get the current mask
+void publishState() {
+  if (!mqttConnected) return;
+  
+  char topic[MQTT_TOPIC_MAX_LEN];
+  char buffer[96];
+  snprintf(topic, sizeof(topic), "devices/%s/state", deviceId.c_str());
+  snprintf(buffer, sizeof(buffer), "{\"mask\":%u,\"seq\":%lu,\"ts\":%lu}",
+           getOutputMask(), (unsigned long)getStateSeq(), (unsigned long)millis());
+  mqttClient.publish(topic, buffer, true);
+}
+
+void publishAck(const CommandAck &ack) {
+  if (!mqttConnected) return;
+  
+  char topic[MQTT_TOPIC_MAX_LEN];
+  snprintf(topic, sizeof(topic), "devices/%s/ack", deviceId.c_str());
+  
+  JsonDocument doc;
+  doc["seq"] = ack.seq;
+  doc["cid"] = ack.cid;
+  doc["ok"] = ack.ok;
+  doc["err"] = ack.err;
+  doc["dup"] = ack.dup;
+  doc["rxUs"] = ack.rxUs;
+  doc["appliedUs"] = ack.appliedUs;
+  doc["mask"] = getOutputMask();
+  
+  char buffer[192];
+  serializeJson(doc, buffer);
+  mqttClient.publish(topic, buffer);
+}
+
+// Edge events are not retained; the current levels are in telemetry
+void publishInputEvent(const InputEvent &event) {
+  if (!mqttConnected) return;
+  
+  char topic[MQTT_TOPIC_MAX_LEN];
+  char buffer[128];
+  snprintf(topic, sizeof(topic), "devices/%s/inputs", deviceId.c_str());
+  snprintf(buffer, sizeof(buffer),
+           "{\"ch\":%u,\"pin\":%u,\"state\":%s,\"us\":%lld,\"seq\":%lu,\"settled\":%s}",
+           event.channel + 1, gpioInputPins[event.channel], event.level ? "true" : "false",
+           (long long)event.us, (unsigned long)event.seq, event.settled ? "true" : "false");
+  mqttClient.publish(topic, buffer);
+  
+  int64_t latency = esp_timer_get_time() - event.us;
+  recordLatency(inputLatency, latency > 0 ? (uint32_t)latency : 0);
+}
+
 void publishTelemetry() {
   if (!mqttConnected) return;
   
@@ -113,12 +400,24 @@ void publishTelemetry() {
     gpio["physicalPin"] = gpioOutputPins[i];
   }
   
+  doc["mask"] = getOutputMask();
+  doc["seq"] = getStateSeq();
+  if (getPwmChannelMask()) {
+    pwmStatusToJson(doc["pwm"].to<JsonArray>());
+  }
   doc["uptime"] = millis() / 1000;
   doc["heap"] = ESP.getFreeHeap();
   doc["rssi"] = WiFi.RSSI();
   doc["ts"] = millis();
+  latencyToJson(mqttRxLatency, doc["mqttRx"].to<JsonObject>());
+  latencyToJson(actuationLatency, doc["actuation"].to<JsonObject>());
+  timersToJson(doc["timers"].to<JsonObject>());
+  stateStoreToJson(doc["restore"].to<JsonObject>());
+  edgeRulesToJson(doc["rules"].to<JsonObject>());
+  inputsToJson(doc["inputs"].to<JsonObject>());
   
-  char buffer[512];
+  // Static: only TaskMQTT publishes telemetry and its stack is small
+  static char buffer[2048];
   serializeJson(doc, buffer);
   mqttClient.publish(topic.c_str(), buffer);
   Serial.println("[MQTT] Telemetry published");
@@ -1,10 +1,33 @@
 /*
- * NeoPixel Handler Implementation
+ * NeoPixel LED Compositor Implementation
  */
 
 #include "neopixel_handler.h"
 #include "globals.h"
 
+struct LedLayers {
+  uint32_t status;
+  
+  bool userActive;
+  uint32_t userColor;
+  LedEffect userEffect;
+  uint16_t userPeriodMs;
+  uint8_t userFirst;
+  uint8_t userCount;
+  
+  uint32_t flashColor;
+  uint32_t flashUntilMs;
+  uint16_t flashBlinkMs;
+};
+
+static LedLayers layers = {};
+static portMUX_TYPE ledMux = portMUX_INITIALIZER_UNLOCKED;
+
+static uint32_t lastFrame[NEOPIXEL_COUNT];
+static bool frameValid = false;
+static volatile bool rendererRunning = false;
+
+// Status layer: connection state on pixel 0
 void updateNeoPixel() {
   uint32_t color;
   
@@ -18,6 +41,124 @@ void updateNeoPixel() {
     color = pixel.Color(0, 255, 0); // Green = all good
   }
   
-  pixel.setPixelColor(0, color);
-  pixel.show();
+  portENTER_CRITICAL(&ledMux);
+  layers.status = color;
+  portEXIT_CRITICAL(&ledMux);
+  
+  // During setup() TaskUI is not running yet, so draw directly
+  if (!rendererRunning) renderLeds();
+}
+
+// Called once by TaskUI; from then on only TaskUI touches the strip
+void startLedRenderer() {
+  rendererRunning = true;
+}
+
+void setUserLeds(uint32_t color, LedEffect effect, uint16_t periodMs, uint8_t first, uint8_t count) {
+  if (first >= NEOPIXEL_COUNT) return;
+  if (count == 0 || first + count > NEOPIXEL_COUNT) count = NEOPIXEL_COUNT - first;
+  
+  portENTER_CRITICAL(&ledMux);
+  layers.userActive = true;
+  layers.userColor = color;
+  layers.userEffect = effect;
+  layers.userPeriodMs = periodMs ? periodMs : LED_DEFAULT_PERIOD_MS;
+  layers.userFirst = first;
+  layers.userCount = count;
+  portEXIT_CRITICAL(&ledMux);
+}
+
+void clearUserLeds() {
+  portENTER_CRITICAL(&ledMux);
+  layers.userActive = false;
+  portEXIT_CRITICAL(&ledMux);
+}
+
+// Overrides every pixel for durationMs, optionally blinking; returns at once
+void flashLeds(uint32_t color, uint16_t durationMs, uint16_t blinkMs) {
+  portENTER_CRITICAL(&ledMux);
+  layers.flashColor = color;
+  layers.flashUntilMs = millis() + durationMs;
+  layers.flashBlinkMs = blinkMs;
+  portEXIT_CRITICAL(&ledMux);
+  
+  if (!rendererRunning) renderLeds();
+}
+
+bool parseLedEffect(const char* name, LedEffect &effect) {
+  if (strcmp(name, "solid") == 0) effect = LED_SOLID;
+  else if (strcmp(name, "blink") == 0) effect = LED_BLINK;
+  else if (strcmp(name, "breathe") == 0) effect = LED_BREATHE;
+  else if (strcmp(name, "rainbow") == 0) effect = LED_RAINBOW;
+  else return false;
+  return true;
+}
+
+static uint32_t scaleColor(uint32_t color, uint8_t level) {
+  uint8_t r = ((color >> 16) & 0xFF) * level / 255;
+  uint8_t g = ((color >> 8) & 0xFF) * level / 255;
+  uint8_t b = (color & 0xFF) * level / 255;
+  return Adafruit_NeoPixel::Color(r, g, b);
+}
+
+static uint32_t userPixel(const LedLayers &l, uint32_t now, uint16_t index) {
+  uint32_t phase = now % l.userPeriodMs;
+  
+  switch (l.userEffect) {
+    case LED_BLINK:
+      return phase < l.userPeriodMs / 2 ? l.userColor : 0;
+    
+    case LED_BREATHE: {
+      // Triangle wave, gamma corrected so the fade looks linear
+      uint32_t half = l.userPeriodMs / 2;
+      uint32_t ramp = phase < half ? phase : l.userPeriodMs - phase;
+      uint8_t level = Adafruit_NeoPixel::gamma8(half ? ramp * 255 / half : 255);
+      return scaleColor(l.userColor, level);
+    }
+    
+    case LED_RAINBOW: {
+      uint16_t hue = (uint32_t)phase * 65536 / l.userPeriodMs +
+                     (uint32_t)(index - l.userFirst) * 65536 / l.userCount;
+      return Adafruit_NeoPixel::gamma32(Adafruit_NeoPixel::ColorHSV(hue));
+    }
+    
+    default:
+      return l.userColor;
+  }
+}
+
+// Composites all layers and pushes the strip only when a pixel changed, so
+// static scenes cost no RMT traffic. Called every LED_FRAME_MS by TaskUI.
+void renderLeds() {
+  LedLayers l;
+  portENTER_CRITICAL(&ledMux);
+  l = layers;
+  portEXIT_CRITICAL(&ledMux);
+  
+  uint32_t now = millis();
+  bool flashing = (int32_t)(l.flashUntilMs - now) > 0;
+  bool changed = !frameValid;
+  
+  for (uint16_t i = 0; i < NEOPIXEL_COUNT; i++) {
+    uint32_t color = (i == 0) ? l.status : 0;
+    
+    if (l.userActive && i >= l.userFirst && i < l.userFirst + l.userCount) {
+      color = userPixel(l, now, i);
+    }
+    if (flashing) {
+      bool on = l.flashBlinkMs == 0 || ((now / l.flashBlinkMs) % 2) == 0;
+      color = on ? l.flashColor : 0;
+    }
+    
+    if (color != lastFrame[i]) {
+      lastFrame[i] = color;
+      pixel.setPixelColor(i, color);
+      changed = true;
+    }
+  }
+  
+  if (changed) {
+    pixel.show();
+    frameValid = true;
+  }
 }
@@ -0,0 +1,279 @@
+/*
+ * Timed Outputs Implementation
+ *
+ * Pulse ends and schedule ticks are driven by esp_timer on the device, so
+ * they keep running while MQTT is down and need no network round-trip per
+ * transition. Timer callbacks only build a command and queue it; every pin
+ * change still happens in TaskActuator. Each timed command carries its due
+ * time, and the gap to the actual pin edge is recorded as timer drift.
+ *
+ * A command the full queue refuses is not lost: it is retried every
+ * TIMER_RETRY_MS until it is queued (or superseded), and each refusal
+ * counts as an overrun.
+ */
+
+#include "output_timers.h"
+#include "globals.h"
+#include "actuator.h"
+#include <esp_timer.h>
+
+struct PulseTimer {
+  esp_timer_handle_t timer;
+  bool active;
+  bool revertState;
+  uint16_t gen;        // Bumped on every arm/cancel to drop stale reverts
+  int64_t dueUs;
+};
+
+struct OutputSchedule {
+  esp_timer_handle_t timer;
+  bool active;
+  bool periodic;       // false while waiting out the initial offset
+  uint8_t pin;
+  bool state;          // Level applied at each tick
+  uint32_t periodMs;
+  uint32_t onMs;       // Pulse length per tick, 0 = just apply state
+  int64_t nextDueUs;
+  int64_t retryDueUs;  // Tick the queue refused, 0 = none
+};
+
+static PulseTimer pulses[8];
+static OutputSchedule schedules[MAX_OUTPUT_SCHEDULES];
+static esp_timer_handle_t scheduleRetryTimer;
+static volatile uint32_t timerOverruns = 0;
+static portMUX_TYPE timerMux = portMUX_INITIALIZER_UNLOCKED;
+
+// ========== CALLBACKS (esp_timer task) ==========
+
+static void pulseTimerCallback(void* arg) {
+  uint8_t idx = (uint32_t)arg;
+  
+  ActuatorCommand cmd;
+  memset(&cmd, 0, sizeof(cmd));
+  cmd.type = ActuatorCommand::RELAY;
+  cmd.source = ActuatorCommand::SRC_PULSE;
+  cmd.pin = idx + 1;
+  cmd.timestamp = millis();
+  cmd.rxUs = esp_timer_get_time();
+  
+  // The pulse stays active (and restorable as reverted) until its revert
+  // is queued; cancelled or re-armed meanwhile means nothing to revert
+  portENTER_CRITICAL(&timerMux);
+  if (!pulses[idx].active) {
+    portEXIT_CRITICAL(&timerMux);
+    return;
+  }
+  cmd.state = pulses[idx].revertState;
+  cmd.timerGen = pulses[idx].gen;
+  cmd.dueUs = pulses[idx].dueUs;
+  portEXIT_CRITICAL(&timerMux);
+  
+  if (queueActuatorCommand(cmd, 0)) {
+    portENTER_CRITICAL(&timerMux);
+    if (pulses[idx].gen == cmd.timerGen) pulses[idx].active = false;
+    portEXIT_CRITICAL(&timerMux);
+    return;
+  }
+  
+  // Fails harmlessly if armPulse() has restarted the timer in the meantime
+  timerOverruns++;
+  esp_timer_start_once(pulses[idx].timer, (uint64_t)TIMER_RETRY_MS * 1000);
+}
+
+// Queues the schedule's command for the tick due at dueUs; a refused tick
+// is kept for the retry timer until the next tick supersedes it
+static void queueScheduleTick(OutputSchedule &sched, int64_t dueUs) {
+  ActuatorCommand cmd;
+  memset(&cmd, 0, sizeof(cmd));
+  cmd.type = ActuatorCommand::RELAY;
+  cmd.source = ActuatorCommand::SRC_SCHEDULE;
+  cmd.timestamp = millis();
+  cmd.rxUs = esp_timer_get_time();
+  cmd.dueUs = dueUs;
+  
+  portENTER_CRITICAL(&timerMux);
+  sched.retryDueUs = 0;
+  if (!sched.active) {
+    portEXIT_CRITICAL(&timerMux);
+    return;
+  }
+  cmd.pin = sched.pin;
+  cmd.state = sched.state;
+  cmd.pulseMs = sched.onMs;
+  portEXIT_CRITICAL(&timerMux);
+  
+  if (queueActuatorCommand(cmd, 0)) return;
+  
+  timerOverruns++;
+  portENTER_CRITICAL(&timerMux);
+  sched.retryDueUs = dueUs;
+  portEXIT_CRITICAL(&timerMux);
+  // Already running when another schedule is waiting too, which is fine
+  esp_timer_start_once(scheduleRetryTimer, (uint64_t)TIMER_RETRY_MS * 1000);
+}
+
+static void scheduleTimerCallback(void* arg) {
+  OutputSchedule &sched = schedules[(uint32_t)arg];
+  
+  portENTER_CRITICAL(&timerMux);
+  if (!sched.active) {
+    portEXIT_CRITICAL(&timerMux);
+    return;
+  }
+  int64_t dueUs = sched.nextDueUs;
+  sched.nextDueUs += (int64_t)sched.periodMs * 1000;
+  bool startPeriodic = !sched.periodic;
+  sched.periodic = true;
+  portEXIT_CRITICAL(&timerMux);
+  
+  // The first tick came from the one-shot offset timer
+  if (startPeriodic) {
+    esp_timer_start_periodic(sched.timer, (uint64_t)sched.periodMs * 1000);
+  }
+  
+  queueScheduleTick(sched, dueUs);
+}
+
+static void scheduleRetryCallback(void* arg) {
+  for (int i = 0; i < MAX_OUTPUT_SCHEDULES; i++) {
+    if (schedules[i].retryDueUs != 0) queueScheduleTick(schedules[i], schedules[i].retryDueUs);
+  }
+}
+
+// ========== SETUP ==========
+
+void initOutputTimers() {
+  for (uint32_t i = 0; i < 8; i++) {
+    esp_timer_create_args_t args = {};
+    args.callback = pulseTimerCallback;
+    args.arg = (void*)i;
+    args.dispatch_method = ESP_TIMER_TASK;
+    args.name = "pulse";
+    esp_timer_create(&args, &pulses[i].timer);
+  }
+  
+  for (uint32_t i = 0; i < MAX_OUTPUT_SCHEDULES; i++) {
+    esp_timer_create_args_t args = {};
+    args.callback = scheduleTimerCallback;
+    args.arg = (void*)i;
+    args.dispatch_method = ESP_TIMER_TASK;
+    args.name = "schedule";
+    esp_timer_create(&args, &schedules[i].timer);
+  }
+  
+  esp_timer_create_args_t retryArgs = {};
+  retryArgs.callback = scheduleRetryCallback;
+  retryArgs.dispatch_method = ESP_TIMER_TASK;
+  retryArgs.name = "schedule-retry";
+  esp_timer_create(&retryArgs, &scheduleRetryTimer);
+  
+  Serial.println("[Timers] ✓ Pulse and schedule timers ready");
+}
+
+// ========== PULSES ==========
+
+void armPulse(uint8_t idx, bool revertState, uint32_t pulseMs) {
+  PulseTimer &pulse = pulses[idx];
+  esp_timer_stop(pulse.timer);
+  
+  portENTER_CRITICAL(&timerMux);
+  pulse.gen++;
+  pulse.active = true;
+  pulse.revertState = revertState;
+  pulse.dueUs = esp_timer_get_time() + (int64_t)pulseMs * 1000;
+  portEXIT_CRITICAL(&timerMux);
+  
+  esp_timer_start_once(pulse.timer, (uint64_t)pulseMs * 1000);
+}
+
+void cancelPulse(uint8_t idx) {
+  PulseTimer &pulse = pulses[idx];
+  esp_timer_stop(pulse.timer);
+  
+  portENTER_CRITICAL(&timerMux);
+  pulse.gen++;
+  pulse.active = false;
+  portEXIT_CRITICAL(&timerMux);
+}
+
+// A revert may already sit in the queue when a newer command re-arms or
+// cancels the pulse; only the latest generation is applied.
+bool isPulseCurrent(uint8_t idx, uint16_t gen) {
+  return pulses[idx].gen == gen;
+}
+
+// Replaces the level of every channel with a running pulse by the level it
+// will revert to, so a reset mid-pulse never restores a pump left ON.
+uint8_t withPulseReverts(uint8_t mask) {
+  portENTER_CRITICAL(&timerMux);
+  for (int i = 0; i < 8; i++) {
+    if (!pulses[i].active) continue;
+    if (pulses[i].revertState) mask |= (1 << i); else mask &= ~(1 << i);
+  }
+  portEXIT_CRITICAL(&timerMux);
+  return mask;
+}
+
+// ========== SCHEDULES ==========
+
+bool configureSchedule(JsonVariantConst json) {
+  int id = json["id"] | -1;
+  if (id < 0 || id >= MAX_OUTPUT_SCHEDULES) {
+    Serial.printf("[Timers] ✗ Schedule id must be 0-%d\n", MAX_OUTPUT_SCHEDULES - 1);
+    return false;
+  }
+  
+  OutputSchedule &sched = schedules[id];
+  esp_timer_stop(sched.timer);
+  
+  if (!(json["enabled"] | true)) {
+    portENTER_CRITICAL(&timerMux);
+    sched.active = false;
+    portEXIT_CRITICAL(&timerMux);
+    Serial.printf("[Timers] Schedule %d removed\n", id);
+    return true;
+  }
+  
+  int pin = json["pin"] | 0;
+  uint32_t periodMs = json["periodMs"] | 0;
+  uint32_t onMs = json["onMs"] | 0;
+  uint32_t offsetMs = json["offsetMs"] | 0;
+  if (pin < 1 || pin > 8 || periodMs < MIN_SCHEDULE_PERIOD_MS || onMs >= periodMs ||
+      offsetMs > periodMs) {
+    Serial.println("[Timers] ✗ Invalid schedule (pin 1-8, onMs < periodMs, offsetMs <= periodMs)");
+    return false;
+  }
+  
+  // First tick after offsetMs (or one full period), then every periodMs
+  uint32_t firstMs = offsetMs ? offsetMs : periodMs;
+  
+  portENTER_CRITICAL(&timerMux);
+  sched.active = true;
+  sched.periodic = false;
+  sched.retryDueUs = 0;
+  sched.pin = pin;
+  sched.state = json["state"] | true;
+  sched.periodMs = periodMs;
+  sched.onMs = onMs;
+  sched.nextDueUs = esp_timer_get_time() + (int64_t)firstMs * 1000;
+  portEXIT_CRITICAL(&timerMux);
+  
+  esp_timer_start_once(sched.timer, (uint64_t)firstMs * 1000);
+  Serial.printf("[Timers] ✓ Schedule %d: GPIO%d every %lu ms for %lu ms\n", id, pin,
+                (unsigned long)periodMs, (unsigned long)onMs);
+  return true;
+}
+
+uint8_t getActiveScheduleCount() {
+  uint8_t count = 0;
+  for (int i = 0; i < MAX_OUTPUT_SCHEDULES; i++) {
+    if (schedules[i].active) count++;
+  }
+  return count;
+}
+
+void timersToJson(JsonObject obj) {
+  obj["schedules"] = getActiveScheduleCount();
+  obj["overruns"] = timerOverruns;
+  latencyToJson(timerDrift, obj["drift"].to<JsonObject>());
+}
@@ -0,0 +1,198 @@
+/*
+ * LEDC PWM and Servo Outputs Implementation
+ *
+ * Actuator channel N (1-8) uses LEDC channel N-1. Ramps are handed to the
+ * LEDC fade engine, so the actuator task issues one call per command and
+ * any number of channels can fade concurrently without waking the CPU.
+ *
+ * Arduino core 2.x (IDF 4.4) cannot stop a running ramp: any duty write
+ * blocks until it ends. A command for a channel whose ramp is still running
+ * is therefore kept as pending and written by servicePwmFades() once the
+ * ramp ends (at most PWM_MAX_FADE_MS later); the newest command wins and
+ * the actuator task never blocks.
+ */
+
+#include "pwm_handler.h"
+#include "globals.h"
+#include <driver/ledc.h>
+#include <esp_timer.h>
+
+enum ChannelMode : uint8_t { MODE_DIGITAL, MODE_PWM, MODE_SERVO };
+
+struct PwmChannel {
+  ChannelMode mode;
+  bool attached;              // Pin routed to LEDC; deferred with the first write
+  uint32_t freq;
+  uint8_t resolution;
+  uint32_t duty;              // Last commanded duty
+  int64_t fadeEndUs;          // End of the commanded ramp, for status
+  int64_t engineFreeUs;       // End of the ramp LEDC is running; outlives release
+  bool pending;               // duty waits for engineFreeUs
+  uint32_t pendingFadeMs;
+};
+
+static PwmChannel pwmChannels[8] = {};
+static volatile uint8_t pwmMask = 0;
+
+static const char* modeName(ChannelMode mode) {
+  switch (mode) {
+    case MODE_PWM: return "pwm";
+    case MODE_SERVO: return "servo";
+    default: return "digital";
+  }
+}
+
+void initPwmOutputs() {
+  // Fade service is shared by all channels; ESP_ERR_INVALID_STATE just
+  // means it is already installed
+  ledc_fade_func_install(0);
+}
+
+// The Arduino LEDC layer drives channels 2k and 2k+1 from the same timer,
+// so a channel can only change frequency/resolution if its partner agrees.
+static bool timerCompatible(uint8_t idx, uint32_t freq, uint8_t resolution) {
+  const PwmChannel &partner = pwmChannels[idx ^ 1];
+  if (partner.mode == MODE_DIGITAL) return true;
+  return partner.freq == freq && partner.resolution == resolution;
+}
+
+static bool configureChannel(uint8_t idx, ChannelMode mode, uint32_t freq, uint8_t resolution) {
+  PwmChannel &ch = pwmChannels[idx];
+  if (ch.mode == mode && ch.freq == freq && ch.resolution == resolution) return true;
+  
+  if (!timerCompatible(idx, freq, resolution)) {
+    Serial.printf("[PWM] ✗ Channel %d shares a timer with channel %d at a different frequency\n",
+                  idx + 1, (idx ^ 1) + 1);
+    return false;
+  }
+  
+  if (ledcSetup(idx, freq, resolution) == 0) {
+    Serial.printf("[PWM] ✗ %lu Hz at %d bits is not achievable\n", (unsigned long)freq, resolution);
+    return false;
+  }
+  
+  ch.mode = mode;
+  ch.freq = freq;
+  ch.resolution = resolution;
+  ch.duty = 0;
+  ch.fadeEndUs = 0;
+  pwmMask |= (1 << idx);
+  return true;
+}
+
+void releasePwmChannel(uint8_t idx) {
+  PwmChannel &ch = pwmChannels[idx];
+  if (ch.mode == MODE_DIGITAL) return;
+  
+  // A ramp still running on the LEDC channel now drives nothing; a pending
+  // duty is dropped with the channel
+  if (ch.attached) ledcDetachPin(gpioOutputPins[idx]);
+  pinMode(gpioOutputPins[idx], OUTPUT);
+  ch.mode = MODE_DIGITAL;
+  ch.attached = false;
+  ch.duty = 0;
+  ch.fadeEndUs = 0;
+  ch.pending = false;
+  pwmMask &= ~(1 << idx);
+}
+
+// Writes the commanded duty; only called once the fade engine is free, so
+// nothing here blocks
+static bool writeDuty(uint8_t idx, uint32_t fadeMs, int64_t now) {
+  PwmChannel &ch = pwmChannels[idx];
+  ledc_channel_t channel = (ledc_channel_t)idx;
+  
+  if (fadeMs == 0) {
+    ledcWrite(idx, ch.duty);
+  } else {
+    if (ledc_set_fade_with_time(LEDC_LOW_SPEED_MODE, channel, ch.duty, fadeMs) != ESP_OK ||
+        ledc_fade_start(LEDC_LOW_SPEED_MODE, channel, LEDC_FADE_NO_WAIT) != ESP_OK) {
+      Serial.printf("[PWM] ✗ Failed to start fade on channel %d\n", idx + 1);
+      return false;
+    }
+    ch.engineFreeUs = now + (int64_t)fadeMs * 1000;
+  }
+  // Attached after the write, so the pin never shows the previous duty
+  if (!ch.attached) {
+    ledcAttachPin(gpioOutputPins[idx], idx);
+    ch.attached = true;
+  }
+  return true;
+}
+
+static bool setDuty(uint8_t idx, uint32_t duty, uint32_t fadeMs) {
+  PwmChannel &ch = pwmChannels[idx];
+  int64_t now = esp_timer_get_time();
+  
+  ch.duty = duty;
+  if (ch.engineFreeUs > now) {
+    // Replaces any command already waiting for this ramp
+    ch.pending = true;
+    ch.pendingFadeMs = fadeMs;
+    ch.fadeEndUs = ch.engineFreeUs + (int64_t)fadeMs * 1000;
+    Serial.printf("[PWM] Channel %d ramp still running, applying in %lu ms\n", idx + 1,
+                  (unsigned long)((ch.engineFreeUs - now) / 1000));
+    return true;
+  }
+  
+  ch.pending = false;
+  ch.fadeEndUs = fadeMs ? now + (int64_t)fadeMs * 1000 : 0;
+  return writeDuty(idx, fadeMs, now);
+}
+
+TickType_t servicePwmFades() {
+  int64_t now = esp_timer_get_time();
+  int64_t next = INT64_MAX;
+  
+  for (uint8_t i = 0; i < 8; i++) {
+    PwmChannel &ch = pwmChannels[i];
+    if (!ch.pending) continue;
+    if (ch.engineFreeUs > now) {
+      if (ch.engineFreeUs < next) next = ch.engineFreeUs;
+      continue;
+    }
+    ch.pending = false;
+    writeDuty(i, ch.pendingFadeMs, now);
+  }
+  
+  if (next == INT64_MAX) return portMAX_DELAY;
+  // One tick of margin so the ramp has ended when the task wakes
+  return pdMS_TO_TICKS((next - now) / 1000) + 1;
+}
+
+bool applyPwmCommand(const ActuatorCommand &cmd) {
+  uint8_t idx = cmd.pin - 1;
+  
+  if (cmd.type == ActuatorCommand::SERVO) {
+    if (!configureChannel(idx, MODE_SERVO, SERVO_FREQ_HZ, SERVO_RESOLUTION_BITS)) return false;
+    
+    uint32_t pulseUs = SERVO_MIN_PULSE_US +
+                       (uint32_t)cmd.value * (SERVO_MAX_PULSE_US - SERVO_MIN_PULSE_US) / 180;
+    uint32_t periodUs = 1000000UL / SERVO_FREQ_HZ;
+    uint32_t duty = (pulseUs << SERVO_RESOLUTION_BITS) / periodUs;
+    return setDuty(idx, duty, cmd.fadeMs);
+  }
+  
+  if (!configureChannel(idx, MODE_PWM, cmd.freq, cmd.resolution)) return false;
+  return setDuty(idx, cmd.duty, cmd.fadeMs);
+}
+
+uint8_t getPwmChannelMask() {
+  return pwmMask;
+}
+
+void pwmStatusToJson(JsonArray channels) {
+  int64_t now = esp_timer_get_time();
+  for (int i = 0; i < 8; i++) {
+    const PwmChannel &ch = pwmChannels[i];
+    if (ch.mode == MODE_DIGITAL) continue;
+    
+    JsonObject obj = channels.add<JsonObject>();
+    obj["pin"] = i + 1;
+    obj["mode"] = modeName(ch.mode);
+    obj["duty"] = ch.duty;
+    obj["res"] = ch.resolution;
+    obj["freq"] = ch.freq;
+    obj["fading"] = ch.fadeEndUs > now || ch.pending;
+  }
+}
@@ -0,0 +1,160 @@
+/*
+ * Output State Persistence Implementation
+ *
+ * Every applied output change is mirrored into RTC memory, which survives
+ * watchdog, panic, brownout and software resets, and is committed to NVS at
+ * most once per STATE_NVS_MIN_INTERVAL_MS so rapid toggling does not wear
+ * the flash. On boot the RTC copy wins when its magic and CRC check out,
+ * otherwise the NVS copy is used; each channel's power-on policy then
+ * decides whether that saved level is applied.
+ */
+
+#include "state_store.h"
+#include "globals.h"
+#include "actuator.h"
+#include <esp_timer.h>
+#include <esp_rom_crc.h>
+#include <esp_system.h>
+
+#define STATE_MAGIC 0x53544154UL  // "STAT"
+
+struct RetainedOutputs {
+  uint32_t magic;
+  uint8_t mask;
+  uint32_t crc;
+};
+
+static RTC_NOINIT_ATTR RetainedOutputs retained;
+
+static Preferences statePrefs;
+static uint8_t policies[8];
+static uint8_t restoredMask = 0;
+static const char* restoreSource = "default";
+static int64_t restoredUs = 0;
+
+static volatile uint8_t pendingMask = 0;
+static volatile bool nvsDirty = false;
+static uint8_t committedMask = 0;
+static uint32_t lastCommitMs = 0;
+static uint32_t nvsWrites = 0;
+static uint32_t commitStackFree = 0;  // TaskUI stack never used, after a commit
+
+static uint32_t retainedCrc(const RetainedOutputs &state) {
+  return esp_rom_crc32_le(0, (const uint8_t*)&state, offsetof(RetainedOutputs, crc));
+}
+
+static const char* policyName(uint8_t policy) {
+  switch (policy) {
+    case POWER_ON_OFF: return "off";
+    case POWER_ON_ON: return "on";
+    default: return "last";
+  }
+}
+
+// Runs first thing in setup(), before Serial and WiFi; logging is deferred
+// to logRestoredState()
+void restoreOutputState() {
+  statePrefs.begin(STATE_NVS_NAMESPACE, false);
+  committedMask = statePrefs.getUChar("mask", 0);
+  memset(policies, POWER_ON_LAST, sizeof(policies));
+  statePrefs.getBytes("policy", policies, sizeof(policies));
+  
+  uint8_t saved = committedMask;
+  restoreSource = "nvs";
+  if (esp_reset_reason() != ESP_RST_POWERON && retained.magic == STATE_MAGIC &&
+      retained.crc == retainedCrc(retained)) {
+    saved = retained.mask;
+    restoreSource = "rtc";
+  }
+  
+  uint8_t mask = 0;
+  for (int i = 0; i < 8; i++) {
+    bool on = (policies[i] == POWER_ON_ON) ||
+              (policies[i] == POWER_ON_LAST && (saved & (1 << i)));
+    if (on) mask |= (1 << i);
+  }
+  
+  restoreActuatorOutputs(mask);
+  restoredUs = esp_timer_get_time();
+  restoredMask = mask;
+  
+  // Re-seed RTC so a reset before the first command keeps this state
+  retained.magic = STATE_MAGIC;
+  retained.mask = mask;
+  retained.crc = retainedCrc(retained);
+  pendingMask = mask;
+  nvsDirty = (mask != committedMask);
+}
+
+void logRestoredState() {
+  Serial.printf("[State] Outputs restored to 0x%02X from %s in %lu us after reset\n",
+                restoredMask, restoreSource, (unsigned long)restoredUs);
+}
+
+// Called by TaskActuator after every applied change; cheap enough to run
+// on the command path
+void recordOutputState(uint8_t mask) {
+  retained.magic = STATE_MAGIC;
+  retained.mask = mask;
+  retained.crc = retainedCrc(retained);
+  pendingMask = mask;
+  nvsDirty = true;
+}
+
+// Called periodically from TaskUI, so commits stay off the command path.
+// A flash write still suspends the cache on both cores for a few ms, which
+// pauses any task running from flash (TaskActuator included); the rate
+// limit bounds how often that happens.
+void serviceStateStore() {
+  if (!nvsDirty) return;
+  if (millis() - lastCommitMs < STATE_NVS_MIN_INTERVAL_MS) return;
+  
+  nvsDirty = false;
+  uint8_t mask = pendingMask;
+  if (mask == committedMask) return;
+  
+  statePrefs.putUChar("mask", mask);
+  committedMask = mask;
+  lastCommitMs = millis();
+  nvsWrites++;
+  commitStackFree = uxTaskGetStackHighWaterMark(NULL);
+}
+
+// {"cmd":"power_policy","policy":["last","off","on",...]} - one entry per
+// channel starting at channel 1; missing entries keep their setting
+bool setPowerOnPolicy(JsonVariantConst json) {
+  JsonArrayConst list = json.as<JsonArrayConst>();
+  if (list.isNull() || list.size() > 8) {
+    Serial.println("[State] ✗ Policy must be an array of up to 8 entries");
+    return false;
+  }
+  
+  uint8_t updated[8];
+  memcpy(updated, policies, sizeof(updated));
+  for (size_t i = 0; i < list.size(); i++) {
+    const char* name = list[i] | "";
+    if (strcmp(name, "off") == 0) updated[i] = POWER_ON_OFF;
+    else if (strcmp(name, "on") == 0) updated[i] = POWER_ON_ON;
+    else if (strcmp(name, "last") == 0) updated[i] = POWER_ON_LAST;
+    else {
+      Serial.printf("[State] ✗ Unknown power-on policy '%s'\n", name);
+      return false;
+    }
+  }
+  
+  memcpy(policies, updated, sizeof(policies));
+  statePrefs.putBytes("policy", policies, sizeof(policies));
+  Serial.println("[State] ✓ Power-on policy saved");
+  return true;
+}
+
+void stateStoreToJson(JsonObject obj) {
+  obj["restoredUs"] = restoredUs;
+  obj["source"] = restoreSource;
+  obj["nvsWrites"] = nvsWrites;
+  obj["stackFree"] = commitStackFree;
+  JsonArray list = obj["policy"].to<JsonArray>();
+  for (int i = 0; i < 8; i++) {
+    list.add(policyName(policies[i]));
+  }
+}
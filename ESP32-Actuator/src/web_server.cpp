@@ -5,8 +5,13 @@
 #include "web_server.h"
 #include "globals.h"
 #include "config_manager.h"
+#include "actuator.h"
+#include "output_timers.h"
+#include "state_store.h"
+#include "input_handler.h"
 #include <Arduino.h>
 #include <ArduinoJson.h>
+#include <esp_timer.h>
 
 void setupWebServer() {
   webServer.on("/", handleRoot);
@@ -476,8 +481,13 @@ void handleStatus() {
     doc["ip"] = WiFi.localIP().toString();
     doc["rssi"] = WiFi.RSSI();
   }
+  latencyToJson(mqttRxLatency, doc["mqttRx"].to<JsonObject>());
+  latencyToJson(actuationLatency, doc["actuation"].to<JsonObject>());
+  timersToJson(doc["timers"].to<JsonObject>());
+  stateStoreToJson(doc["restore"].to<JsonObject>());
+  inputsToJson(doc["inputs"].to<JsonObject>());
   
-  char buffer[256];
+  char buffer[1536];
   serializeJson(doc, buffer);
   webServer.send(200, "application/json", buffer);
 }
@@ -520,16 +530,15 @@ void handleGPIO() {
   }
   
   // Create GPIO command and send to actuator task
-  JsonDocument cmdDoc;
-  cmdDoc["type"] = "gpio";
-  cmdDoc["pin"] = pin;
-  cmdDoc["state"] = state;
-  
-  String command;
-  serializeJson(cmdDoc, command);
+  ActuatorCommand cmd = {};
+  cmd.type = ActuatorCommand::RELAY;
+  cmd.pin = pin;
+  cmd.state = state;
+  cmd.timestamp = millis();
+  cmd.rxUs = esp_timer_get_time();
   
   if (commandQueue != NULL) {
-    if (xQueueSend(commandQueue, &command, pdMS_TO_TICKS(100)) == pdTRUE) {
+    if (queueActuatorCommand(cmd, pdMS_TO_TICKS(100))) {
       JsonDocument responseDoc;
       responseDoc["success"] = true;
       responseDoc["pin"] = pin;
@@ -0,0 +1,148 @@
+/*
+ * Command Path Stress Test (runs on the board: pio test -e esp32-s3-actuator)
+ *
+ * Drives parseActuatorCommand() and queueActuatorCommand() the way the MQTT
+ * callback does - payload parsed into the static JSON pool, command copied
+ * into a statically allocated queue and received again - for millions of
+ * commands of every type, valid and invalid, and checks that neither the
+ * heap nor the pool grows.
+ */
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+#include <esp_heap_caps.h>
+#include <unity.h>
+#include "config.h"
+#include "types.h"
+#include "globals.h"
+#include "json_pool.h"
+#include "actuator.h"
+
+#define STRESS_COMMANDS 2000000UL
+#define WARMUP_COMMANDS 1000UL
+
+static StaticJsonPool<MQTT_JSON_POOL_SIZE> pool;
+static JsonDocument doc(&pool);
+
+static StaticQueue_t queueControl;
+static uint8_t queueStorage[ACTUATOR_QUEUE_LENGTH * sizeof(ActuatorCommand)];
+
+static char payload[192];
+static uint32_t parsedCount = 0;
+static uint32_t rejectedCount = 0;
+static size_t poolHighWater = 0;
+
+// One payload per command type, cycling through channels and values; every
+// 1000th command is malformed so the reject path is exercised as well
+static size_t buildPayload(uint32_t i) {
+  uint8_t pin = (i % 8) + 1;
+  if (i % 1000 == 999) {
+    return snprintf(payload, sizeof(payload), "{\"type\":\"pwm\",\"pin\":%u,\"duty\":99999}", pin);
+  }
+  switch (i % 6) {
+    case 0:
+      return snprintf(payload, sizeof(payload),
+                      "{\"type\":\"gpio\",\"pin\":%u,\"state\":%s,\"seq\":%lu,\"cid\":\"c%08lx\"}",
+                      pin, (i & 1) ? "true" : "false", (unsigned long)i, (unsigned long)i);
+    case 1:
+      return snprintf(payload, sizeof(payload), "{\"gpio\":%u,\"state\":1,\"pulse_ms\":%lu}",
+                      pin, (unsigned long)(i % 5000) + 1);
+    case 2:
+      return snprintf(payload, sizeof(payload), "{\"type\":\"mask\",\"mask\":\"0x%02X\",\"value\":\"0x%02X\"}",
+                      (unsigned)((i % 255) + 1), (unsigned)(i % 256));
+    case 3:
+      return snprintf(payload, sizeof(payload), "{\"type\":\"pwm\",\"pin\":%u,\"percent\":%.1f,\"fadeMs\":%lu}",
+                      pin, (i % 1001) / 10.0f, (unsigned long)(i % 2000));
+    case 4:
+      return snprintf(payload, sizeof(payload), "{\"type\":\"servo\",\"pin\":%u,\"angle\":%lu}",
+                      pin, (unsigned long)(i % 181));
+    default:
+      return snprintf(payload, sizeof(payload),
+                      "{\"type\":\"neopixel\",\"color\":{\"r\":%lu,\"g\":0,\"b\":255},\"effect\":\"breathe\",\"periodMs\":2000}",
+                      (unsigned long)(i % 256));
+  }
+}
+
+// Same steps as mqttCallback + handleGpioSet + TaskActuator's receive
+static void runCommand(uint32_t i) {
+  size_t length = buildPayload(i);
+  doc.clear();
+  pool.reset();
+  DeserializationError error = deserializeJson(doc, (const uint8_t*)payload, length);
+  TEST_ASSERT_FALSE_MESSAGE(error, payload);
+  if (pool.used() > poolHighWater) poolHighWater = pool.used();
+
+  ActuatorCommand cmd;
+  if (!parseActuatorCommand(doc.as<JsonVariantConst>(), cmd)) {
+    rejectedCount++;
+    return;
+  }
+  parsedCount++;
+  TEST_ASSERT_TRUE(queueActuatorCommand(cmd, 0));
+
+  ActuatorCommand received;
+  TEST_ASSERT_EQUAL(pdTRUE, xQueueReceive(commandQueue, &received, 0));
+  TEST_ASSERT_EQUAL_MEMORY(&cmd, &received, sizeof(cmd));
+}
+
+void setUp() {}
+void tearDown() {}
+
+void test_parse_and_queue_do_not_leak() {
+  // First calls may allocate once (Serial buffers, lazy statics)
+  for (uint32_t i = 0; i < WARMUP_COMMANDS; i++) runCommand(i);
+  size_t heapBefore = heap_caps_get_free_size(MALLOC_CAP_8BIT);
+  size_t minimumBefore = heap_caps_get_minimum_free_size(MALLOC_CAP_8BIT);
+  parsedCount = 0;
+  rejectedCount = 0;
+
+  for (uint32_t i = 0; i < STRESS_COMMANDS; i++) {
+    runCommand(i);
+    if (i % 100000 == 0) {
+      Serial.printf("[Test] %lu commands, heap %u\n", (unsigned long)i,
+                    (unsigned)heap_caps_get_free_size(MALLOC_CAP_8BIT));
+      vTaskDelay(1);  // Let the idle task feed the watchdog
+    }
+  }
+
+  size_t heapAfter = heap_caps_get_free_size(MALLOC_CAP_8BIT);
+  Serial.printf("[Test] parsed %lu, rejected %lu, pool high water %u of %u bytes\n",
+                (unsigned long)parsedCount, (unsigned long)rejectedCount,
+                (unsigned)poolHighWater, (unsigned)pool.capacity());
+  TEST_ASSERT_EQUAL_UINT32(STRESS_COMMANDS / 1000, rejectedCount);
+  TEST_ASSERT_EQUAL_UINT32(STRESS_COMMANDS - rejectedCount, parsedCount);
+  TEST_ASSERT_EQUAL(heapBefore, heapAfter);
+  TEST_ASSERT_EQUAL(minimumBefore, heap_caps_get_minimum_free_size(MALLOC_CAP_8BIT));
+  TEST_ASSERT_EQUAL(0, uxQueueMessagesWaiting(commandQueue));
+}
+
+// A full queue rejects the command instead of blocking or allocating
+void test_full_queue_rejects() {
+  ActuatorCommand cmd;
+  size_t length = buildPayload(0);
+  doc.clear();
+  pool.reset();
+  deserializeJson(doc, (const uint8_t*)payload, length);
+  TEST_ASSERT_TRUE(parseActuatorCommand(doc.as<JsonVariantConst>(), cmd));
+
+  size_t heapBefore = heap_caps_get_free_size(MALLOC_CAP_8BIT);
+  for (int i = 0; i < ACTUATOR_QUEUE_LENGTH; i++) TEST_ASSERT_TRUE(queueActuatorCommand(cmd, 0));
+  TEST_ASSERT_FALSE(queueActuatorCommand(cmd, 0));
+  xQueueReset(commandQueue);
+  TEST_ASSERT_EQUAL(heapBefore, heap_caps_get_free_size(MALLOC_CAP_8BIT));
+}
+
+void setup() {
+  Serial.begin(115200);
+  delay(2000);  // Give the test runner time to open the port
+
+  commandQueue = xQueueCreateStatic(ACTUATOR_QUEUE_LENGTH, sizeof(ActuatorCommand),
+                                    queueStorage, &queueControl);
+
+  UNITY_BEGIN();
+  RUN_TEST(test_parse_and_queue_do_not_leak);
+  RUN_TEST(test_full_queue_rejects);
+  UNITY_END();
+}
+
+void loop() {}
@@ -0,0 +1,48 @@
+/**
+ * @file analog_sampler.h
+ * @brief Continuous (DMA) ADC acquisition for analog sensors
+ *
+ * The ADC digital controller converts the configured ADC1 channels
+ * round-robin at ANALOG_SAMPLE_RATE_HZ and DMA writes the results into the
+ * driver's ring buffer. TaskAnalog drains it in frames, demultiplexes the
+ * channels, decimates them and accumulates mean/RMS/peak over
+ * ANALOG_WINDOW_MS windows using the SignalStats kernels (lib/SignalStats).
+ *
+ * Raw samples only ever live in static buffers owned by this module.
+ */
+
+#ifndef ANALOG_SAMPLER_H
+#define ANALOG_SAMPLER_H
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+#include "types.h"
+
+/**
+ * @brief Configure the ADC digital controller and start DMA conversions
+ * @return True if the driver started
+ *
+ * Called once from setup() before TaskAnalog is created.
+ */
+bool initAnalogSampler();
+
+/**
+ * @brief Process one DMA frame (TaskAnalog body)
+ *
+ * Blocks until the driver has a frame ready; never polls.
+ */
+void processAnalogFrame();
+
+/**
+ * @brief Copy the latest window statistics of every channel
+ * @param out One AnalogSnapshot per channel
+ */
+void getAnalogSnapshot(AnalogSnapshot out[ANALOG_CHANNEL_COUNT]);
+
+/**
+ * @brief Add sampler statistics to a JSON object (for /api/status)
+ * @param obj Destination object
+ */
+void analogSamplerToJson(JsonObject obj);
+
+#endif // ANALOG_SAMPLER_H
@@ -21,6 +21,7 @@
 
 // ========== LED PIN DEFINITIONS ==========
 #define NEOPIXEL_WIFI 45        // WS2812B RGB LED for WiFi/MQTT status indication
+#define NEOPIXEL_COUNT 1        // Pixels on the strip; pixel 0 shows connection status
 
 // ========== BUTTON PIN DEFINITIONS ==========
 #define RESET_BUTTON_PIN 0      // Boot button on ESP32-S3 DevKit (active LOW)
@@ -42,8 +43,41 @@
 // ========== TASK TIMING INTERVALS ==========
 // Control loop frequencies for FreeRTOS tasks
 #define SENSOR_READ_INTERVAL_MS 5000    // DHT20 sensor reading interval (unused, tasks uses 1000ms)
-#define UI_UPDATE_INTERVAL_MS 500       // NeoPixel LED update frequency
+#define LED_FRAME_MS 20                 // NeoPixel compositor frame period (50 fps)
+#define LED_DEFAULT_PERIOD_MS 1000      // Effect cycle when a command gives none
 #define MQTT_LOOP_INTERVAL_MS 100       // MQTT client loop processing frequency
+#define MQTT_KEEPALIVE_S 10             // Broker declares us gone (and publishes the will) after 1.5x this
+
+// ========== MQTT PARSING ==========
+// Incoming messages are parsed into a static pool and dispatched by exact topic
+#define MQTT_JSON_POOL_SIZE 2048        // Static arena for callback JSON documents (bytes)
+#define MQTT_MAX_ROUTES 8               // Maximum number of subscribed topic routes
+#define MQTT_TOPIC_MAX_LEN 64           // Maximum length of a routed topic string
+
+// ========== PULSE COUNTERS ==========
+// PCNT units count meter pulses in hardware; software only runs on overflow
+// and once per sensor cycle, never per pulse
+#define PULSE_CHANNEL_COUNT 2           // PCNT units used (ESP32-S3 has 4)
+#define PULSE_PIN_1 4                   // Meter pulse input, channel 1 (internal pull-up)
+#define PULSE_PIN_2 5                   // Meter pulse input, channel 2 (internal pull-up)
+#define PULSE_PCNT_LIMIT 32000          // Hardware count that raises the overflow interrupt
+#define PULSE_FILTER_CYCLES 100         // Glitch filter in APB cycles (1.25 us, max 1023)
+#define PULSE_RATE_SAMPLES 61           // Ring of 1 s samples, covers the 60 s window
+#define PULSE_RATE_SHORT_S 10           // Short rate window (seconds)
+#define PULSE_RATE_LONG_S 60            // Long rate window (seconds)
+#define PULSE_NVS_INTERVAL_MS 600000    // Flash commit period for counts (10 min)
+#define PULSE_NVS_NAMESPACE "pulses"
+
+// ========== ANALOG INPUTS (ADC CONTINUOUS / DMA) ==========
+// ADC1 only: ADC2 is shared with WiFi. ADC1 channel n is GPIO n+1 on the S3
+#define ANALOG_CHANNEL_COUNT 2
+#define ANALOG_ADC_CHANNEL_1 ADC1_CHANNEL_5   // GPIO 6, e.g. current clamp
+#define ANALOG_ADC_CHANNEL_2 ADC1_CHANNEL_6   // GPIO 7, e.g. pressure transducer
+#define ANALOG_SAMPLE_RATE_HZ 20000     // Total conversions/s, shared by all channels
+#define ANALOG_DECIMATION 5             // Boxcar factor: 10 kHz -> 2 kHz per channel
+#define ANALOG_WINDOW_MS 1000           // Mean/RMS/peak window
+#define ANALOG_DMA_FRAME_BYTES 1024     // Bytes per DMA interrupt / read
+#define ANALOG_DMA_BUFFER_BYTES 4096    // Driver ring buffer between DMA and the task
 
 // ========== BUTTON CONFIGURATION ==========
 // Long press detection for configuration reset
@@ -13,7 +13,6 @@
  * 
  * Subscribed Topics:
  * - devices/<device_id>/cmd - Remote commands (reboot, diagnostics)
- * - devices/<device_id>/config - Configuration updates (reserved)
  */
 
 #ifndef MQTT_HANDLER_H
@@ -25,7 +24,7 @@
  * @brief Connect to MQTT broker
  * 
  * Establishes connection using configured server/port.
- * Subscribes to command and config topics.
+ * Subscribes to the command topic.
  * Publishes initial status and pairing messages.
  */
 void connectMQTT();
@@ -36,7 +35,7 @@ void connectMQTT();
  * @param payload Message payload bytes
  * @param length Payload length in bytes
  * 
- * Processes incoming MQTT messages (commands, config updates).
+ * Processes incoming MQTT commands.
  * Parses JSON payloads and executes corresponding actions.
  */
 void mqttCallback(char* topic, byte* payload, unsigned int length);
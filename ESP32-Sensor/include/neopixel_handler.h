@@ -1,25 +1,78 @@
 /**
  * @file neopixel_handler.h
- * @brief NeoPixel RGB LED status indicator control
+ * @brief NeoPixel LED compositor
  * 
- * Controls WS2812B RGB LED to provide visual feedback of device state.
+ * Composites up to three layers onto the WS2812B strip, lowest first:
+ * - Status: connection state colour on pixel 0
+ * - User: solid colour or effect (blink/breathe/rainbow) on a pixel range
+ * - Flash: transient full-strip override (diagnostics, factory reset)
  * 
- * LED Color States:
+ * Status LED Colours:
  * - Orange: AP mode (configuration needed)
  * - Red: Connecting to WiFi
  * - Blue: WiFi connected, MQTT disconnected  
  * - Green: Fully operational (WiFi + MQTT connected)
+ * 
+ * Callers only update layer state and return immediately; TaskUI renders a
+ * frame every LED_FRAME_MS.
  */
 
 #ifndef NEOPIXEL_HANDLER_H
 #define NEOPIXEL_HANDLER_H
 
+#include <Arduino.h>
+
+/**
+ * @brief Animation applied to the user layer
+ */
+enum LedEffect : uint8_t { LED_SOLID, LED_BLINK, LED_BREATHE, LED_RAINBOW };
+
 /**
- * @brief Update NeoPixel LED color based on system state
+ * @brief Update the status layer from system state
  * 
  * Reads global connection state flags (apMode, wifiConnected, mqttConnected)
- * and sets LED color accordingly. Called by TaskUI every 500ms.
+ * and sets the pixel 0 status colour. Draws immediately while TaskUI is not
+ * running yet (during setup()).
  */
 void updateNeoPixel();
 
+/**
+ * @brief Show a colour or effect on a range of pixels
+ * @param color Packed RGB colour (ignored by LED_RAINBOW)
+ * @param effect Animation to apply
+ * @param periodMs Effect cycle length, 0 for LED_DEFAULT_PERIOD_MS
+ * @param first First pixel of the range
+ * @param count Pixel count, 0 for the rest of the strip
+ */
+void setUserLeds(uint32_t color, LedEffect effect, uint16_t periodMs, uint8_t first, uint8_t count);
+
+/**
+ * @brief Remove the user layer so the status colour shows again
+ */
+void clearUserLeds();
+
+/**
+ * @brief Override the whole strip for a short time without blocking
+ * @param color Packed RGB colour
+ * @param durationMs How long the flash lasts
+ * @param blinkMs Toggle period while flashing, 0 for steady
+ */
+void flashLeds(uint32_t color, uint16_t durationMs, uint16_t blinkMs = 0);
+
+/**
+ * @brief Parse an effect name ("solid", "blink", "breathe", "rainbow")
+ * @return false if the name is unknown
+ */
+bool parseLedEffect(const char* name, LedEffect &effect);
+
+/**
+ * @brief Hand strip ownership to TaskUI; called once when TaskUI starts
+ */
+void startLedRenderer();
+
+/**
+ * @brief Composite all layers and push the frame if any pixel changed
+ */
+void renderLeds();
+
 #endif // NEOPIXEL_HANDLER_H
@@ -0,0 +1,56 @@
+/**
+ * @file pulse_counter.h
+ * @brief Hardware pulse counting (PCNT) for water and power meters
+ *
+ * Each counter channel uses one PCNT unit counting rising edges on its pin.
+ * The 16-bit hardware counter is extended to 64 bits by an overflow
+ * interrupt that fires once every PULSE_PCNT_LIMIT pulses, so counting costs
+ * no CPU per pulse even at tens of kHz.
+ *
+ * Persistence:
+ * - RTC memory copy refreshed every sample (survives software/watchdog resets)
+ * - NVS copy committed every PULSE_NVS_INTERVAL_MS, only when counts changed
+ *
+ * Rates are computed over sliding PULSE_RATE_SHORT_S / PULSE_RATE_LONG_S
+ * windows from a ring of timestamped samples.
+ */
+
+#ifndef PULSE_COUNTER_H
+#define PULSE_COUNTER_H
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+#include "types.h"
+
+/**
+ * @brief Restore saved counts and start the PCNT units
+ *
+ * Called once from setup() before the tasks start. The RTC copy is used
+ * unless the reset was a power-on, otherwise the last NVS commit.
+ */
+void initPulseCounters();
+
+/**
+ * @brief Sample all counters and fill the telemetry snapshot
+ * @param out One PulseSnapshot per channel
+ *
+ * Called by TaskSensors once per cycle: extends the hardware counts,
+ * records a rate sample, refreshes the RTC copy and commits to NVS when due.
+ */
+void samplePulseCounters(PulseSnapshot out[PULSE_CHANNEL_COUNT]);
+
+/**
+ * @brief Set a channel's total, e.g. to match the meter's register
+ * @param channel Channel number starting at 1
+ * @param count New total; applied by the next sample
+ * @return True if the channel is valid
+ */
+bool setPulseCount(uint8_t channel, uint64_t count);
+
+/**
+ * @brief Add counter statistics to a JSON object (for /api/status)
+ * @param obj Destination object
+ */
+void pulseCountersToJson(JsonObject obj);
+
+#endif // PULSE_COUNTER_H
@@ -17,6 +17,10 @@
  * - Processes telemetry queue
  * - Publishes data to MQTT broker
  * - Handles MQTT reconnection
+ * 
+ * TaskAnalog (Core 0, Priority 2):
+ * - Drains ADC DMA frames as they complete
+ * - Decimates and computes mean/RMS/peak per window
  */
 
 #ifndef TASKS_H
@@ -49,4 +53,14 @@ void TaskUI(void *pvParameters);
  */
 void TaskMQTT(void *pvParameters);
 
+/**
+ * @brief Analog acquisition task
+ * @param pvParameters Unused FreeRTOS parameter
+ * 
+ * Blocks on the ADC continuous driver and processes each DMA frame.
+ * Outranks TaskSensors so the driver buffer does not overflow during
+ * slow I2C reads.
+ */
+void TaskAnalog(void *pvParameters);
+
 #endif // TASKS_H
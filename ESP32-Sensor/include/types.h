@@ -16,6 +16,7 @@
 #define TYPES_H
 
 #include <Arduino.h>
+#include "config.h"
 
 // ========== DIAGNOSTICS ==========
 /**
@@ -36,6 +37,35 @@ struct DiagnosticsData {
   String errorMsg;         // Human-readable error message if diagnostics fail
 };
 
+// ========== PULSE COUNTERS ==========
+/**
+ * @struct PulseSnapshot
+ * @brief Meter pulse count and rates for one counter channel
+ * 
+ * Filled by the sensor task each cycle and carried in TelemetryData so the
+ * counts travel with the reading they were sampled alongside.
+ */
+struct PulseSnapshot {
+  uint64_t count;          // Total pulses, persisted across reboots
+  float rateShort;         // Pulses per second over PULSE_RATE_SHORT_S
+  float rateLong;          // Pulses per second over PULSE_RATE_LONG_S
+};
+
+// ========== ANALOG INPUTS ==========
+/**
+ * @struct AnalogSnapshot
+ * @brief Statistics of the last completed window for one analog channel
+ * 
+ * Produced by TaskAnalog from the DMA sample stream and copied into
+ * TelemetryData by the sensor task.
+ */
+struct AnalogSnapshot {
+  float meanMv;            // DC level in millivolts
+  float rmsMv;             // AC RMS (DC removed) in millivolts
+  float peakMv;            // Largest deviation from the mean in millivolts
+  uint32_t windows;        // Completed windows since boot (0 = no data yet)
+};
+
 // ========== TELEMETRY ==========
 /**
  * @struct TelemetryData
@@ -52,6 +82,8 @@ struct TelemetryData {
   uint32_t uptime;         // System uptime in seconds
   uint8_t quality;         // Data quality score: 0 (bad) to 100 (perfect)
   bool valid;              // True if sensor data is valid and trustworthy
+  PulseSnapshot pulses[PULSE_CHANNEL_COUNT];  // Meter counters (PCNT)
+  AnalogSnapshot analog[ANALOG_CHANNEL_COUNT]; // ADC window statistics
 };
 
 // ========== SENSOR EVENT ==========
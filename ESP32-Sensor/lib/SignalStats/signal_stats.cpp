@@ -0,0 +1,85 @@
+/**
+ * @file signal_stats.cpp
+ * @brief Decimation and per-window statistics implementation
+ *
+ * Windows keep exact integer sums; 12-bit samples squared fit easily in
+ * 64 bits for billions of samples, so there is no drift from running
+ * float accumulation. Variance uses E[x^2] - E[x]^2 evaluated in double.
+ */
+
+#include "signal_stats.h"
+#include <math.h>
+
+void decimatorInit(Decimator &dec, uint16_t factor) {
+  dec.acc = 0;
+  dec.pending = 0;
+  dec.factor = factor ? factor : 1;
+}
+
+bool decimatorPush(Decimator &dec, uint16_t sample, uint16_t &out) {
+  dec.acc += sample;
+  if (++dec.pending < dec.factor) return false;
+  
+  // Rounded block average
+  out = (uint16_t)((dec.acc + dec.factor / 2) / dec.factor);
+  dec.acc = 0;
+  dec.pending = 0;
+  return true;
+}
+
+size_t decimateBlock(Decimator &dec, const uint16_t *in, size_t n, uint16_t *out) {
+  size_t produced = 0;
+  for (size_t i = 0; i < n; i++) {
+    if (decimatorPush(dec, in[i], out[produced])) produced++;
+  }
+  return produced;
+}
+
+void statsReset(WindowStats &stats) {
+  stats.count = 0;
+  stats.sum = 0;
+  stats.sumSq = 0;
+  stats.min = UINT16_MAX;
+  stats.max = 0;
+}
+
+void statsAdd(WindowStats &stats, uint16_t sample) {
+  stats.count++;
+  stats.sum += sample;
+  stats.sumSq += (uint32_t)sample * sample;
+  if (sample < stats.min) stats.min = sample;
+  if (sample > stats.max) stats.max = sample;
+}
+
+void statsAddBlock(WindowStats &stats, const uint16_t *samples, size_t n) {
+  for (size_t i = 0; i < n; i++) {
+    statsAdd(stats, samples[i]);
+  }
+}
+
+void statsCompute(const WindowStats &stats, WindowResult &result) {
+  if (stats.count == 0) {
+    result.mean = 0;
+    result.rms = 0;
+    result.peak = 0;
+    result.min = 0;
+    result.max = 0;
+    result.count = 0;
+    return;
+  }
+  
+  double n = (double)stats.count;
+  double mean = (double)stats.sum / n;
+  double variance = (double)stats.sumSq / n - mean * mean;
+  if (variance < 0) variance = 0;  // Rounding on a flat signal
+  
+  double above = (double)stats.max - mean;
+  double below = mean - (double)stats.min;
+  
+  result.mean = (float)mean;
+  result.rms = (float)sqrt(variance);
+  result.peak = (float)(above > below ? above : below);
+  result.min = stats.min;
+  result.max = stats.max;
+  result.count = stats.count;
+}
@@ -0,0 +1,105 @@
+/**
+ * @file signal_stats.h
+ * @brief Decimation and per-window statistics for sampled analog signals
+ *
+ * Plain C++ with no Arduino or ESP-IDF dependency, so the same kernels that
+ * run in the analog task can be compiled on a host and fed recorded sample
+ * files. All state lives in caller-owned structs; nothing allocates.
+ *
+ * Samples are raw ADC codes (uint16_t). Results are in ADC codes as well;
+ * the caller converts them to physical units.
+ */
+
+#ifndef SIGNAL_STATS_H
+#define SIGNAL_STATS_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * @struct Decimator
+ * @brief Boxcar (moving block average) decimator for one channel
+ *
+ * Averages every `factor` input samples into one output sample, which both
+ * reduces the rate and low-pass filters the ADC noise.
+ */
+struct Decimator {
+  uint32_t acc;            // Sum of the samples in the current block
+  uint16_t pending;        // Samples in the current block
+  uint16_t factor;         // Input samples per output sample (>= 1)
+};
+
+/**
+ * @struct WindowStats
+ * @brief Running sums for one statistics window
+ */
+struct WindowStats {
+  uint32_t count;          // Samples accumulated
+  uint64_t sum;            // Sum of samples
+  uint64_t sumSq;          // Sum of squared samples
+  uint16_t min;            // Smallest sample
+  uint16_t max;            // Largest sample
+};
+
+/**
+ * @struct WindowResult
+ * @brief Statistics of a completed window, in ADC codes
+ */
+struct WindowResult {
+  float mean;              // DC level
+  float rms;               // AC RMS (DC removed), e.g. for current clamps
+  float peak;              // Largest absolute deviation from the mean
+  uint16_t min;
+  uint16_t max;
+  uint32_t count;
+};
+
+/**
+ * @brief Prepare a decimator
+ * @param dec Decimator state
+ * @param factor Input samples per output sample, 0 is treated as 1
+ */
+void decimatorInit(Decimator &dec, uint16_t factor);
+
+/**
+ * @brief Feed one sample to a decimator
+ * @param dec Decimator state
+ * @param sample Input sample
+ * @param out Receives the averaged sample when a block completes
+ * @return True if `out` was written
+ */
+bool decimatorPush(Decimator &dec, uint16_t sample, uint16_t &out);
+
+/**
+ * @brief Decimate a block of samples
+ * @param dec Decimator state (carries partial blocks between calls)
+ * @param in Input samples
+ * @param n Number of input samples
+ * @param out Output buffer, at least n / factor + 1 samples
+ * @return Number of samples written to `out`
+ */
+size_t decimateBlock(Decimator &dec, const uint16_t *in, size_t n, uint16_t *out);
+
+/**
+ * @brief Clear a window
+ */
+void statsReset(WindowStats &stats);
+
+/**
+ * @brief Add one sample to a window
+ */
+void statsAdd(WindowStats &stats, uint16_t sample);
+
+/**
+ * @brief Add a block of samples to a window
+ */
+void statsAddBlock(WindowStats &stats, const uint16_t *samples, size_t n);
+
+/**
+ * @brief Compute mean, AC RMS and peak of a window
+ * @param stats Accumulated window
+ * @param result Filled with the window statistics (zeros for an empty window)
+ */
+void statsCompute(const WindowStats &stats, WindowResult &result);
+
+#endif // SIGNAL_STATS_H
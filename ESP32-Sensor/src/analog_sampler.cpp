@@ -0,0 +1,189 @@
+/**
+ * @file analog_sampler.cpp
+ * @brief Continuous (DMA) ADC acquisition implementation
+ *
+ * Per frame: demultiplex the type-2 DMA records into per-channel blocks,
+ * decimate each block, then add it to the channel's window. When a window
+ * holds ANALOG_WINDOW_MS worth of decimated samples its statistics are
+ * converted to millivolts and published under a spinlock for the sensor
+ * task to copy into telemetry.
+ */
+
+#include "analog_sampler.h"
+#include "globals.h"
+#include <signal_stats.h>
+#include <driver/adc.h>
+#include <esp_adc_cal.h>
+
+// ===== DERIVED RATES =====
+#define ANALOG_RESULTS_PER_FRAME (ANALOG_DMA_FRAME_BYTES / SOC_ADC_DIGI_RESULT_BYTES)
+#define ANALOG_RATE_PER_CHANNEL (ANALOG_SAMPLE_RATE_HZ / ANALOG_CHANNEL_COUNT / ANALOG_DECIMATION)
+#define ANALOG_WINDOW_SAMPLES ((uint32_t)ANALOG_RATE_PER_CHANNEL * ANALOG_WINDOW_MS / 1000)
+
+static const adc_channel_t analogChannels[ANALOG_CHANNEL_COUNT] = {
+  (adc_channel_t)ANALOG_ADC_CHANNEL_1,
+  (adc_channel_t)ANALOG_ADC_CHANNEL_2
+};
+
+// ===== STATIC SAMPLE BUFFERS =====
+static uint8_t dmaFrame[ANALOG_DMA_FRAME_BYTES];
+static uint16_t rawBlock[ANALOG_CHANNEL_COUNT][ANALOG_RESULTS_PER_FRAME];
+static uint16_t decimatedBlock[ANALOG_RESULTS_PER_FRAME / ANALOG_DECIMATION + 1];
+static uint8_t channelIndex[SOC_ADC_MAX_CHANNEL_NUM];  // ADC channel -> our index
+
+// ===== PROCESSING STATE (TaskAnalog only) =====
+static Decimator decimators[ANALOG_CHANNEL_COUNT];
+static WindowStats windows[ANALOG_CHANNEL_COUNT];
+static esp_adc_cal_characteristics_t adcChars;
+static float mvPerCode = 0;     // Linear calibration from eFuse
+static float mvOffset = 0;
+
+// ===== RESULTS (shared) =====
+static portMUX_TYPE analogMux = portMUX_INITIALIZER_UNLOCKED;
+static AnalogSnapshot latest[ANALOG_CHANNEL_COUNT];
+static uint32_t framesRead = 0;
+static uint32_t dmaOverruns = 0;      // Driver buffer filled faster than we drained it
+static uint32_t invalidRecords = 0;
+static bool samplerRunning = false;
+
+bool initAnalogSampler() {
+  memset(channelIndex, 0xFF, sizeof(channelIndex));
+  uint32_t mask = 0;
+  for (uint8_t i = 0; i < ANALOG_CHANNEL_COUNT; i++) {
+    channelIndex[analogChannels[i]] = i;
+    mask |= BIT(analogChannels[i]);
+    decimatorInit(decimators[i], ANALOG_DECIMATION);
+    statsReset(windows[i]);
+  }
+  
+  // ===== DRIVER AND DMA BUFFER =====
+  adc_digi_init_config_t initConfig = {};
+  initConfig.max_store_buf_size = ANALOG_DMA_BUFFER_BYTES;
+  initConfig.conv_num_each_intr = ANALOG_DMA_FRAME_BYTES;
+  initConfig.adc1_chan_mask = mask;
+  initConfig.adc2_chan_mask = 0;
+  if (adc_digi_initialize(&initConfig) != ESP_OK) {
+    Serial.println("[Analog] ✗ ADC continuous driver init failed");
+    return false;
+  }
+  
+  // ===== CONVERSION PATTERN =====
+  // One entry per channel; the controller cycles through them in order
+  static adc_digi_pattern_config_t pattern[ANALOG_CHANNEL_COUNT];
+  for (uint8_t i = 0; i < ANALOG_CHANNEL_COUNT; i++) {
+    pattern[i].atten = ADC_ATTEN_DB_11;       // ~0-3.1 V input range
+    pattern[i].channel = analogChannels[i];
+    pattern[i].unit = 0;                      // ADC1
+    pattern[i].bit_width = SOC_ADC_DIGI_MAX_BITWIDTH;
+  }
+  
+  adc_digi_configuration_t digiConfig = {};
+  digiConfig.conv_limit_en = ADC_CONV_LIMIT_EN;
+  digiConfig.conv_limit_num = 250;
+  digiConfig.pattern_num = ANALOG_CHANNEL_COUNT;
+  digiConfig.adc_pattern = pattern;
+  digiConfig.sample_freq_hz = ANALOG_SAMPLE_RATE_HZ;
+  digiConfig.conv_mode = ADC_CONV_SINGLE_UNIT_1;
+  digiConfig.format = ADC_DIGI_OUTPUT_FORMAT_TYPE2;
+  if (adc_digi_controller_configure(&digiConfig) != ESP_OK) {
+    Serial.println("[Analog] ✗ ADC pattern config failed");
+    adc_digi_deinitialize();
+    return false;
+  }
+  
+  // Raw codes are converted with the eFuse two-point/Vref calibration
+  esp_adc_cal_characterize(ADC_UNIT_1, ADC_ATTEN_DB_11, ADC_WIDTH_BIT_12, 1100, &adcChars);
+  mvPerCode = adcChars.coeff_a / 65536.0f;
+  mvOffset = adcChars.coeff_b;
+  
+  adc_digi_start();
+  samplerRunning = true;
+  Serial.printf("[Analog] ✓ %d channels, %d Hz DMA, %d Hz per channel after decimation\n",
+                ANALOG_CHANNEL_COUNT, ANALOG_SAMPLE_RATE_HZ, ANALOG_RATE_PER_CHANNEL);
+  return true;
+}
+
+/**
+ * @brief Convert a completed window to millivolts and publish it
+ */
+static void finishWindow(uint8_t idx) {
+  WindowResult result;
+  statsCompute(windows[idx], result);
+  statsReset(windows[idx]);
+  
+  portENTER_CRITICAL(&analogMux);
+  latest[idx].meanMv = result.mean * mvPerCode + mvOffset;
+  latest[idx].rmsMv = result.rms * mvPerCode;
+  latest[idx].peakMv = result.peak * mvPerCode;
+  latest[idx].windows++;
+  portEXIT_CRITICAL(&analogMux);
+}
+
+/**
+ * @brief Decimate one channel's block and add it to the window, closing
+ *        the window (possibly mid-block) when it is full
+ */
+static void processChannelBlock(uint8_t idx, const uint16_t *samples, size_t n) {
+  size_t produced = decimateBlock(decimators[idx], samples, n, decimatedBlock);
+  const uint16_t *next = decimatedBlock;
+  
+  while (produced > 0) {
+    uint32_t room = ANALOG_WINDOW_SAMPLES - windows[idx].count;
+    size_t take = produced < room ? produced : room;
+    statsAddBlock(windows[idx], next, take);
+    next += take;
+    produced -= take;
+  
+    if (windows[idx].count >= ANALOG_WINDOW_SAMPLES) finishWindow(idx);
+  }
+}
+
+void processAnalogFrame() {
+  if (!samplerRunning) {
+    vTaskDelay(portMAX_DELAY);
+    return;
+  }
+  
+  uint32_t length = 0;
+  esp_err_t err = adc_digi_read_bytes(dmaFrame, sizeof(dmaFrame), &length, ADC_MAX_DELAY);
+  // INVALID_STATE still returns data, it only reports that the driver's
+  // buffer overflowed and older conversions were dropped
+  if (err == ESP_ERR_INVALID_STATE) {
+    dmaOverruns++;
+  } else if (err != ESP_OK) {
+    return;
+  }
+  framesRead++;
+  
+  // ===== DEMULTIPLEX =====
+  size_t counts[ANALOG_CHANNEL_COUNT] = {0};
+  for (uint32_t i = 0; i + SOC_ADC_DIGI_RESULT_BYTES <= length; i += SOC_ADC_DIGI_RESULT_BYTES) {
+    const adc_digi_output_data_t *record = (const adc_digi_output_data_t*)&dmaFrame[i];
+    uint8_t channel = record->type2.channel;
+    uint8_t idx = (channel < SOC_ADC_MAX_CHANNEL_NUM) ? channelIndex[channel] : 0xFF;
+    if (idx == 0xFF || record->type2.unit != 0) {
+      invalidRecords++;
+      continue;
+    }
+    rawBlock[idx][counts[idx]++] = record->type2.data;
+  }
+  
+  for (uint8_t idx = 0; idx < ANALOG_CHANNEL_COUNT; idx++) {
+    processChannelBlock(idx, rawBlock[idx], counts[idx]);
+  }
+}
+
+void getAnalogSnapshot(AnalogSnapshot out[ANALOG_CHANNEL_COUNT]) {
+  portENTER_CRITICAL(&analogMux);
+  memcpy(out, latest, sizeof(latest));
+  portEXIT_CRITICAL(&analogMux);
+}
+
+void analogSamplerToJson(JsonObject obj) {
+  obj["running"] = samplerRunning;
+  obj["sampleRateHz"] = ANALOG_SAMPLE_RATE_HZ;
+  obj["channelRateHz"] = ANALOG_RATE_PER_CHANNEL;
+  obj["frames"] = framesRead;
+  obj["overruns"] = dmaOverruns;
+  obj["invalid"] = invalidRecords;
+}
@@ -23,7 +23,7 @@
  * Comprehensive system health check:
  * 1. I2C bus scan - Detects all devices on I2C bus
  * 2. DHT20 validation - Re-initializes sensor and performs test read
- * 3. NeoPixel test - Brief LED flash test
+ * 3. NeoPixel test - Brief non-blocking LED flash
  * 4. Results publishing - Sends diagnostics via MQTT
  * 
  * Thread-safe: Acquires i2cMutex before I2C operations.
@@ -90,12 +90,9 @@ void runDiagnostics() {
   }
   
   // ===== NEOPIXEL LED TEST =====
-  // Brief flash to red, then back to normal state
+  // Brief red flash; TaskUI draws it and restores the status colour itself
   lastDiagnostics.neopixelOk = true;
-  pixel.setPixelColor(0, pixel.Color(255, 0, 0));  // Red flash
-  pixel.show();
-  delay(100);
-  updateNeoPixel();  // Restore normal state indicator
+  flashLeds(pixel.Color(255, 0, 0), 100);
   
   Serial.println("[Diag] Complete");
   
@@ -37,6 +37,8 @@
 #include "diagnostics.h"
 #include "web_server.h"
 #include "tasks.h"
+#include "pulse_counter.h"
+#include "analog_sampler.h"
 
 // ========== GLOBAL OBJECT INSTANCES ==========
 Preferences prefs;
@@ -44,7 +46,7 @@ WebServer webServer(WEB_PORT);
 DNSServer dnsServer;
 WiFiClient espClient;
 PubSubClient mqttClient(espClient);
-Adafruit_NeoPixel pixel(1, NEOPIXEL_WIFI, NEO_GRB + NEO_KHZ800);
+Adafruit_NeoPixel pixel(NEOPIXEL_COUNT, NEOPIXEL_WIFI, NEO_GRB + NEO_KHZ800);
 DHT20 dht20;
 
 // ========== GLOBAL VARIABLES ==========
@@ -102,15 +104,9 @@ void checkResetButton() {
       Serial.println("[Button] LONG PRESS DETECTED - RESETTING CONFIG!");
       Serial.println(String('=', 50));
       
-      // Blink LED rapidly to indicate reset
-      for (int i = 0; i < 10; i++) {
-        pixel.setPixelColor(0, pixel.Color(255, 0, 0));
-        pixel.show();
-        delay(100);
-        pixel.setPixelColor(0, pixel.Color(0, 0, 0));
-        pixel.show();
-        delay(100);
-      }
+      // Blink LED rapidly to indicate reset (drawn by TaskUI)
+      flashLeds(pixel.Color(255, 0, 0), 2000, 100);
+      delay(2000);
       
       // Clear saved configuration
       prefs.begin("esp32-iot", false);
@@ -223,10 +219,17 @@ void setup() {
   // Setup web server
   setupWebServer();
   
+  // Start meter pulse counters (PCNT) with the saved totals
+  initPulseCounters();
+  
+  // Start continuous ADC conversions; TaskAnalog drains the DMA frames
+  initAnalogSampler();
+  
   // Create FreeRTOS tasks
   xTaskCreatePinnedToCore(TaskSensors, "Sensors", 4096, NULL, 1, NULL, 0);
   xTaskCreatePinnedToCore(TaskUI, "UI", 2048, NULL, 1, NULL, 0);
   xTaskCreatePinnedToCore(TaskMQTT, "MQTT", 4096, NULL, 2, NULL, 1);
+  xTaskCreatePinnedToCore(TaskAnalog, "Analog", 3072, NULL, 2, NULL, 0);
   
   Serial.println("[Setup] Complete!");
 }
@@ -11,15 +11,104 @@
 #include "globals.h"
 #include "neopixel_handler.h"
 #include "diagnostics.h"
+#include "json_pool.h"
+#include "pulse_counter.h"
+#include "analog_sampler.h"
 #include <Arduino.h>
 #include <ArduinoJson.h>
 
+// ========== TOPIC ROUTING ==========
+
+/**
+ * @brief Handler invoked for a routed topic with the parsed payload
+ */
+typedef void (*TopicHandler)(JsonDocument &doc);
+
+/**
+ * @struct TopicRoute
+ * @brief Exact-match topic to handler mapping
+ * 
+ * Topic strings are built once per connection so the callback only needs
+ * a strcmp per route instead of String allocation and suffix matching.
+ */
+struct TopicRoute {
+  char topic[MQTT_TOPIC_MAX_LEN];  // Fully expanded topic (devices/<id>/...)
+  TopicHandler handler;            // Function receiving the parsed document
+};
+
+static TopicRoute routes[MQTT_MAX_ROUTES];
+static uint8_t routeCount = 0;
+
+// Static parse arena - callbacks never allocate JSON on the heap
+static StaticJsonPool<MQTT_JSON_POOL_SIZE> jsonPool;
+static JsonDocument mqttDoc(&jsonPool);
+
+/**
+ * @brief Handle devices/<id>/cmd messages (reboot, diagnostics, led, pulse_set)
+ * @param doc Parsed command document
+ */
+static void handleCommand(JsonDocument &doc) {
+  const char* cmd = doc["cmd"];
+  if (cmd == NULL) return;
+  
+  // Reboot command
+  if (strcmp(cmd, "reboot") == 0) {
+    Serial.println("[CMD] Rebooting...");
+    delay(1000);
+    ESP.restart();
+  } 
+  // Run diagnostics command
+  else if (strcmp(cmd, "diagnostics") == 0) {
+    runDiagnostics();
+  }
+  // User LED layer: {"cmd":"led","color":{"r":0,"g":0,"b":255},"effect":"breathe"}
+  else if (strcmp(cmd, "led") == 0) {
+    const char* effectName = doc["effect"] | "solid";
+    LedEffect effect = LED_SOLID;
+    if (strcmp(effectName, "off") == 0) {
+      clearUserLeds();
+    } else if (parseLedEffect(effectName, effect)) {
+      uint32_t color = Adafruit_NeoPixel::Color(doc["color"]["r"] | 0, doc["color"]["g"] | 0,
+                                                doc["color"]["b"] | 0);
+      setUserLeds(color, effect, doc["periodMs"] | 0, doc["first"] | 0, doc["count"] | 0);
+    } else {
+      Serial.println("[CMD] Unknown LED effect: " + String(effectName));
+    }
+  }
+  // Align a meter counter with its register: {"cmd":"pulse_set","ch":1,"count":123456}
+  else if (strcmp(cmd, "pulse_set") == 0) {
+    uint8_t ch = doc["ch"] | 0;
+    if (!setPulseCount(ch, doc["count"] | (uint64_t)0)) {
+      Serial.printf("[CMD] ✗ Invalid pulse channel %d\n", ch);
+    }
+  }
+}
+
+/**
+ * @brief Register a route and subscribe to its topic
+ * @param suffix Topic suffix after devices/<device_id>/
+ * @param handler Function called with the parsed payload
+ */
+static void addRoute(const char* suffix, TopicHandler handler) {
+  if (routeCount >= MQTT_MAX_ROUTES) return;
+  
+  TopicRoute &route = routes[routeCount];
+  snprintf(route.topic, sizeof(route.topic), "devices/%s/%s", deviceId.c_str(), suffix);
+  route.handler = handler;
+  routeCount++;
+  
+  mqttClient.subscribe(route.topic);
+}
+
 /**
  * @brief Connect to MQTT broker
  * 
  * Establishes MQTT connection using configured server and port.
+ * Registers a retained Last Will of {"online":false} on the status topic,
+ * so the broker marks the device offline when the connection drops
+ * without waiting for a timeout.
  * On success:
- * - Subscribes to command and config topics
+ * - Subscribes to the command topic
  * - Publishes initial status and pairing messages
  * - Sets event group bit for other tasks
  */
@@ -30,22 +119,25 @@ void connectMQTT() {
   // Configure MQTT client
   mqttClient.setServer(mqttServer.c_str(), mqttPort);
   mqttClient.setCallback(mqttCallback);  // Set message handler
-  mqttClient.setBufferSize(512);  // Increase buffer for larger messages
+  mqttClient.setBufferSize(1024);  // Increase buffer for larger messages
+  mqttClient.setKeepAlive(MQTT_KEEPALIVE_S);
   
   Serial.print("[MQTT] Connecting to: " + mqttServer + ":" + String(mqttPort));
   
-  // Attempt connection with device ID as client ID
-  if (mqttClient.connect(deviceId.c_str())) {
+  // Will topic must outlive connect(); publishStatus() later overwrites it
+  static char willTopic[MQTT_TOPIC_MAX_LEN];
+  snprintf(willTopic, sizeof(willTopic), "devices/%s/status", deviceId.c_str());
+  
+  // Attempt connection with device ID as client ID (will: QoS 1, retained)
+  if (mqttClient.connect(deviceId.c_str(), willTopic, 1, true, "{\"online\":false}")) {
     // ===== CONNECTION SUCCESS =====
     mqttConnected = true;
     xEventGroupSetBits(connectionEvents, MQTT_CONNECTED_BIT);  // Notify other tasks
     Serial.println(" Connected!");
     
-    // Subscribe to command and configuration topics
-    String configTopic = "devices/" + deviceId + "/config";
-    String cmdTopic = "devices/" + deviceId + "/cmd";
-    mqttClient.subscribe(configTopic.c_str());
-    mqttClient.subscribe(cmdTopic.c_str());
+    // Build the routing table and subscribe to the command topic
+    routeCount = 0;
+    addRoute("cmd", handleCommand);
     
     // Publish initial messages
     publishStatus();   // Announce device online
@@ -63,42 +155,33 @@ void connectMQTT() {
  * @param payload Raw message payload bytes
  * @param length Payload length in bytes
  * 
- * Processes incoming MQTT messages from subscribed topics.
- * Parses JSON payloads and executes corresponding commands.
+ * Dispatches incoming messages through the precomputed routing table.
+ * The payload is parsed in place from PubSubClient's receive buffer into
+ * a statically sized document; it is never copied into a String.
  */
 void mqttCallback(char* topic, byte* payload, unsigned int length) {
-  // Convert topic and payload to strings
-  String topicStr = String(topic);
-  String payloadStr;
-  for (unsigned int i = 0; i < length; i++) {
-    payloadStr += (char)payload[i];
-  }
+  Serial.printf("[MQTT] %s: %.*s\n", topic, (int)length, (const char*)payload);
   
-  Serial.println("[MQTT] " + topicStr + ": " + payloadStr);
+  // Find the handler for this exact topic
+  const TopicRoute* route = NULL;
+  for (uint8_t i = 0; i < routeCount; i++) {
+    if (strcmp(routes[i].topic, topic) == 0) {
+      route = &routes[i];
+      break;
+    }
+  }
+  if (route == NULL) return;
   
-  // Parse JSON payload
-  JsonDocument doc;
-  DeserializationError error = deserializeJson(doc, payloadStr);
+  // Parse JSON payload into the static pool
+  mqttDoc.clear();
+  jsonPool.reset();
+  DeserializationError error = deserializeJson(mqttDoc, (const uint8_t*)payload, length);
   if (error) {
-    Serial.println("[MQTT] JSON parse error");
+    Serial.printf("[MQTT] JSON parse error: %s\n", error.c_str());
     return;
   }
   
-  // ===== HANDLE COMMANDS =====
-  if (topicStr.endsWith("/cmd")) {
-    const char* cmd = doc["cmd"];
-    
-    // Reboot command
-    if (strcmp(cmd, "reboot") == 0) {
-      Serial.println("[CMD] Rebooting...");
-      delay(1000);
-      ESP.restart();
-    } 
-    // Run diagnostics command
-    else if (strcmp(cmd, "diagnostics") == 0) {
-      runDiagnostics();
-    }
-  }
+  route->handler(mqttDoc);
 }
 
 /**
@@ -151,8 +234,29 @@ bool publishTelemetry(TelemetryData &data) {
   doc["valid"] = data.valid;          // Overall data validity
   doc["ts"] = millis();               // Timestamp
   
+  // Meter counters: total pulses and pulses/s over the short and long windows
+  JsonArray pulses = doc["pulses"].to<JsonArray>();
+  for (uint8_t i = 0; i < PULSE_CHANNEL_COUNT; i++) {
+    JsonObject ch = pulses.add<JsonObject>();
+    ch["ch"] = i + 1;
+    ch["count"] = data.pulses[i].count;
+    ch["rate"] = data.pulses[i].rateShort;
+    ch["rateLong"] = data.pulses[i].rateLong;
+  }
+  
+  // Analog channels: mean, AC RMS and peak deviation (mV) of the last window
+  JsonArray analog = doc["analog"].to<JsonArray>();
+  for (uint8_t i = 0; i < ANALOG_CHANNEL_COUNT; i++) {
+    if (data.analog[i].windows == 0) continue;  // No completed window yet
+    JsonObject ch = analog.add<JsonObject>();
+    ch["ch"] = i + 1;
+    ch["mean"] = data.analog[i].meanMv;
+    ch["rms"] = data.analog[i].rmsMv;
+    ch["peak"] = data.analog[i].peakMv;
+  }
+  
   // Serialize and publish (not retained - high frequency data)
-  char buffer[256];
+  char buffer[768];
   serializeJson(doc, buffer);
   bool published = mqttClient.publish(topic.c_str(), buffer);
   
@@ -0,0 +1,252 @@
+/**
+ * @file pulse_counter.cpp
+ * @brief Hardware pulse counting (PCNT) implementation
+ *
+ * Total for a channel = base + overflow + hardware count, where base is the
+ * restored (or user-set) total and overflow is advanced by the PCNT limit
+ * interrupt. Only TaskSensors samples and updates base; the ISR only touches
+ * the overflow accumulator.
+ *
+ * The ISR clears the limit interrupt and advances overflow under pulseMux,
+ * so a reader holding pulseMux sees a wrap either already counted or still
+ * pending in the raw interrupt status, never half-done.
+ */
+
+#include "pulse_counter.h"
+#include "globals.h"
+#include <driver/pcnt.h>
+#include <soc/pcnt_struct.h>
+#include <esp_timer.h>
+#include <esp_rom_crc.h>
+#include <esp_system.h>
+
+#define PULSE_MAGIC 0x50434E54UL  // "PCNT"
+
+/**
+ * @struct RetainedPulses
+ * @brief Counter totals kept in RTC memory across non-power-on resets
+ */
+struct RetainedPulses {
+  uint32_t magic;
+  uint64_t totals[PULSE_CHANNEL_COUNT];
+  uint32_t crc;
+};
+
+static RTC_NOINIT_ATTR RetainedPulses retained;
+
+static const uint8_t pulsePins[PULSE_CHANNEL_COUNT] = {PULSE_PIN_1, PULSE_PIN_2};
+
+// ===== COUNTER STATE =====
+static portMUX_TYPE pulseMux = portMUX_INITIALIZER_UNLOCKED;
+static volatile uint64_t overflow[PULSE_CHANNEL_COUNT];  // Advanced by the ISR
+static uint64_t base[PULSE_CHANNEL_COUNT];               // Restored/set total
+static uint64_t lastTotal[PULSE_CHANNEL_COUNT];          // Last sampled total
+static uint64_t pendingSet[PULSE_CHANNEL_COUNT];         // setPulseCount() value
+static volatile uint8_t pendingSetMask = 0;
+
+// ===== RATE WINDOW =====
+// Ring of samples shared by all channels; one entry per sample call
+static int64_t sampleUs[PULSE_RATE_SAMPLES];
+static uint64_t sampleTotals[PULSE_RATE_SAMPLES][PULSE_CHANNEL_COUNT];
+static uint8_t sampleHead = 0;     // Next slot to write
+static uint8_t sampleCount = 0;
+
+// ===== PERSISTENCE =====
+static Preferences pulsePrefs;
+static uint64_t committed[PULSE_CHANNEL_COUNT];
+static uint32_t lastCommitMs = 0;
+static uint32_t nvsWrites = 0;
+static const char* restoreSource = "none";
+static bool pcntReady = false;
+
+static uint32_t retainedCrc(const RetainedPulses &state) {
+  return esp_rom_crc32_le(0, (const uint8_t*)&state, offsetof(RetainedPulses, crc));
+}
+
+/**
+ * @brief PCNT interrupt: every unit flagged has hit its high limit and reset
+ *        to zero
+ *
+ * Registered for the whole peripheral (not through the ISR service, which
+ * clears the status before calling handlers) so clearing and counting the
+ * wrap happen in one critical section.
+ */
+static void IRAM_ATTR pulseOverflowIsr(void* arg) {
+  portENTER_CRITICAL_ISR(&pulseMux);
+  uint32_t status = PCNT.int_st.val;
+  for (uint8_t i = 0; i < PULSE_CHANNEL_COUNT; i++) {
+    if (status & BIT(i)) overflow[i] += PULSE_PCNT_LIMIT;
+  }
+  PCNT.int_clr.val = status;
+  portEXIT_CRITICAL_ISR(&pulseMux);
+}
+
+/**
+ * @brief Read the 64-bit total for one channel
+ *
+ * The raw interrupt bit is read before and after the hardware count. Set
+ * both times, the unit wrapped before the count was read and the ISR has
+ * not counted it yet; changed in between, it wrapped during the read, so
+ * the read is repeated.
+ */
+static uint64_t readTotal(uint8_t idx) {
+  for (;;) {
+    portENTER_CRITICAL(&pulseMux);
+    uint32_t pendingBefore = PCNT.int_raw.val & BIT(idx);
+    int16_t count = 0;
+    pcnt_get_counter_value((pcnt_unit_t)idx, &count);
+    uint32_t pendingAfter = PCNT.int_raw.val & BIT(idx);
+    uint64_t wrapped = overflow[idx];
+    portEXIT_CRITICAL(&pulseMux);
+    
+    if (pendingBefore != pendingAfter) continue;
+    if (pendingBefore) wrapped += PULSE_PCNT_LIMIT;
+    return base[idx] + wrapped + (uint16_t)count;
+  }
+}
+
+/**
+ * @brief Pulses per second between now and the sample closest to windowS ago
+ */
+static float rateOver(uint8_t idx, int64_t nowUs, uint64_t total, uint32_t windowS) {
+  if (sampleCount == 0) return 0;
+  
+  // Walk back from the newest stored sample until the window is covered,
+  // or use the oldest one while the ring is still filling
+  int64_t windowUs = (int64_t)windowS * 1000000;
+  uint8_t slot = (sampleHead + PULSE_RATE_SAMPLES - 1) % PULSE_RATE_SAMPLES;
+  for (uint8_t n = 1; n < sampleCount && nowUs - sampleUs[slot] < windowUs; n++) {
+    slot = (slot + PULSE_RATE_SAMPLES - 1) % PULSE_RATE_SAMPLES;
+  }
+  
+  int64_t elapsed = nowUs - sampleUs[slot];
+  if (elapsed <= 0) return 0;
+  return (float)(total - sampleTotals[slot][idx]) * 1e6f / (float)elapsed;
+}
+
+void initPulseCounters() {
+  pulsePrefs.begin(PULSE_NVS_NAMESPACE, false);
+  memset(committed, 0, sizeof(committed));
+  if (pulsePrefs.getBytesLength("totals") == sizeof(committed)) {
+    pulsePrefs.getBytes("totals", committed, sizeof(committed));
+    restoreSource = "nvs";
+  }
+  memcpy(base, committed, sizeof(base));
+  
+  if (esp_reset_reason() != ESP_RST_POWERON && retained.magic == PULSE_MAGIC &&
+      retained.crc == retainedCrc(retained)) {
+    memcpy(base, retained.totals, sizeof(base));
+    restoreSource = "rtc";
+  }
+  memcpy(lastTotal, base, sizeof(lastTotal));
+  
+  // ===== CONFIGURE PCNT UNITS =====
+  // Rising edges count up, falling edges are ignored; the driver enables
+  // the pin's pull-up for open-collector meter outputs
+  for (uint8_t i = 0; i < PULSE_CHANNEL_COUNT; i++) {
+    pcnt_config_t config = {};
+    config.pulse_gpio_num = pulsePins[i];
+    config.ctrl_gpio_num = PCNT_PIN_NOT_USED;
+    config.channel = PCNT_CHANNEL_0;
+    config.unit = (pcnt_unit_t)i;
+    config.pos_mode = PCNT_COUNT_INC;
+    config.neg_mode = PCNT_COUNT_DIS;
+    config.lctrl_mode = PCNT_MODE_KEEP;
+    config.hctrl_mode = PCNT_MODE_KEEP;
+    config.counter_h_lim = PULSE_PCNT_LIMIT;
+    config.counter_l_lim = 0;
+  
+    if (pcnt_unit_config(&config) != ESP_OK) {
+      Serial.printf("[Pulses] ✗ PCNT unit %d config failed\n", i);
+      return;
+    }
+    pcnt_set_filter_value((pcnt_unit_t)i, PULSE_FILTER_CYCLES);
+    pcnt_filter_enable((pcnt_unit_t)i);
+    pcnt_event_enable((pcnt_unit_t)i, PCNT_EVT_H_LIM);
+    pcnt_counter_pause((pcnt_unit_t)i);
+    pcnt_counter_clear((pcnt_unit_t)i);
+    pcnt_intr_enable((pcnt_unit_t)i);
+    pcnt_counter_resume((pcnt_unit_t)i);
+  }
+  pcnt_isr_register(pulseOverflowIsr, NULL, 0, NULL);
+  pcntReady = true;
+  lastCommitMs = millis();
+  
+  Serial.printf("[Pulses] ✓ %d counters on GPIO %d/%d, restored from %s\n",
+                PULSE_CHANNEL_COUNT, PULSE_PIN_1, PULSE_PIN_2, restoreSource);
+}
+
+void samplePulseCounters(PulseSnapshot out[PULSE_CHANNEL_COUNT]) {
+  if (!pcntReady) {
+    memset(out, 0, sizeof(PulseSnapshot) * PULSE_CHANNEL_COUNT);
+    return;
+  }
+  
+  // ===== APPLY setPulseCount() REQUESTS =====
+  portENTER_CRITICAL(&pulseMux);
+  uint8_t setMask = pendingSetMask;
+  pendingSetMask = 0;
+  portEXIT_CRITICAL(&pulseMux);
+  
+  for (uint8_t i = 0; i < PULSE_CHANNEL_COUNT; i++) {
+    if (!(setMask & (1 << i))) continue;
+    uint64_t counted = readTotal(i) - base[i];
+    base[i] = pendingSet[i] - counted;
+    lastTotal[i] = pendingSet[i];
+    // Old samples would show a huge or negative rate across the jump
+    sampleCount = 0;
+  }
+  
+  // ===== SAMPLE =====
+  int64_t nowUs = esp_timer_get_time();
+  uint64_t totals[PULSE_CHANNEL_COUNT];
+  for (uint8_t i = 0; i < PULSE_CHANNEL_COUNT; i++) {
+    totals[i] = readTotal(i);
+    lastTotal[i] = totals[i];
+    out[i].count = totals[i];
+    out[i].rateShort = rateOver(i, nowUs, totals[i], PULSE_RATE_SHORT_S);
+    out[i].rateLong = rateOver(i, nowUs, totals[i], PULSE_RATE_LONG_S);
+  }
+  
+  sampleUs[sampleHead] = nowUs;
+  memcpy(sampleTotals[sampleHead], totals, sizeof(totals));
+  sampleHead = (sampleHead + 1) % PULSE_RATE_SAMPLES;
+  if (sampleCount < PULSE_RATE_SAMPLES) sampleCount++;
+  
+  // ===== PERSIST =====
+  // RTC every sample (a plain memory write), flash only every few minutes
+  retained.magic = PULSE_MAGIC;
+  memcpy(retained.totals, totals, sizeof(totals));
+  retained.crc = retainedCrc(retained);
+  
+  if (millis() - lastCommitMs >= PULSE_NVS_INTERVAL_MS || setMask) {
+    lastCommitMs = millis();
+    if (memcmp(committed, totals, sizeof(totals)) != 0) {
+      pulsePrefs.putBytes("totals", totals, sizeof(totals));
+      memcpy(committed, totals, sizeof(committed));
+      nvsWrites++;
+    }
+  }
+}
+
+bool setPulseCount(uint8_t channel, uint64_t count) {
+  if (channel < 1 || channel > PULSE_CHANNEL_COUNT) return false;
+  
+  portENTER_CRITICAL(&pulseMux);
+  pendingSet[channel - 1] = count;
+  pendingSetMask |= (1 << (channel - 1));
+  portEXIT_CRITICAL(&pulseMux);
+  return true;
+}
+
+void pulseCountersToJson(JsonObject obj) {
+  obj["restored"] = restoreSource;
+  obj["nvsWrites"] = nvsWrites;
+  JsonArray list = obj["channels"].to<JsonArray>();
+  for (uint8_t i = 0; i < PULSE_CHANNEL_COUNT; i++) {
+    JsonObject ch = list.add<JsonObject>();
+    ch["ch"] = i + 1;
+    ch["pin"] = pulsePins[i];
+    ch["count"] = lastTotal[i];
+  }
+}
@@ -4,9 +4,10 @@
  * 
  * Implements three concurrent tasks for multi-threaded operation:
  * 
- * 1. TaskSensors - Reads DHT20 sensor data (Core 0, Priority 1)
+ * 1. TaskSensors - Reads DHT20 sensor data and meter counters (Core 0, Priority 1)
  * 2. TaskUI - Updates NeoPixel LED status (Core 0, Priority 1)
  * 3. TaskMQTT - Manages MQTT communication (Core 1, Priority 2)
+ * 4. TaskAnalog - Processes ADC DMA frames (Core 0, Priority 2)
  * 
  * Tasks communicate via:
  * - FreeRTOS queues (telemetry data)
@@ -18,6 +19,8 @@
 #include "globals.h"
 #include "neopixel_handler.h"
 #include "mqtt_handler.h"
+#include "pulse_counter.h"
+#include "analog_sampler.h"
 #include <Arduino.h>
 
 /**
@@ -27,6 +30,7 @@
  * Continuously reads DHT20 temperature/humidity sensor:
  * - Reads sensor every 1 second with mutex protection
  * - Validates data quality (range checks, NaN detection)
+ * - Samples the PCNT meter counters (counts, rates, persistence)
  * - Queues valid telemetry for MQTT transmission
  * - Tracks read/error statistics
  * 
@@ -103,6 +107,8 @@ void TaskSensors(void *pvParameters) {
     data.humidity = humidity;
     data.heap = ESP.getFreeHeap();  // Free heap memory
     data.uptime = millis() / 1000;   // Uptime in seconds
+    samplePulseCounters(data.pulses); // Meter counts and rates
+    getAnalogSnapshot(data.analog);   // Last completed ADC windows
     
     // ===== QUEUE TELEMETRY FOR MQTT TASK =====
     // Only queue if WiFi is connected (prevents queue overflow)
@@ -126,17 +132,21 @@ void TaskSensors(void *pvParameters) {
  * @brief User interface update task (FreeRTOS)
  * @param pvParameters Unused FreeRTOS parameter
  * 
- * Updates NeoPixel LED color based on system connection state.
- * Provides visual feedback to user every 500ms.
+ * Owns the NeoPixel strip: refreshes the status layer and renders a
+ * composited frame every LED_FRAME_MS on a fixed cadence.
  * 
  * Pinned to Core 0, Priority 1
  */
 void TaskUI(void *pvParameters) {
-  const TickType_t xDelay = pdMS_TO_TICKS(UI_UPDATE_INTERVAL_MS);  // 500ms
+  const TickType_t frame = pdMS_TO_TICKS(LED_FRAME_MS);  // 20ms
+  TickType_t lastWake = xTaskGetTickCount();
+  
+  startLedRenderer();
   
   for (;;) {
-    updateNeoPixel();  // Update LED color based on connection state
-    vTaskDelay(xDelay);
+    updateNeoPixel();  // Update status layer from connection state
+    renderLeds();      // Push the frame if any pixel changed
+    vTaskDelayUntil(&lastWake, frame);
   }
 }
 
@@ -218,3 +228,21 @@ void TaskMQTT(void *pvParameters) {
     vTaskDelay(xDelay);  // Wait 100ms before next loop
   }
 }
+
+/**
+ * @brief Analog acquisition task (FreeRTOS)
+ * @param pvParameters Unused FreeRTOS parameter
+ * 
+ * Each pass blocks until the ADC driver has a DMA frame, then decimates it
+ * and updates the per-channel windows. No sample ever leaves the module's
+ * static buffers; only window statistics are shared.
+ * 
+ * Pinned to Core 0, Priority 2
+ */
+void TaskAnalog(void *pvParameters) {
+  Serial.println("[Analog] Task started");
+  
+  for (;;) {
+    processAnalogFrame();
+  }
+}
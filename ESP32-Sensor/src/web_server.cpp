@@ -6,6 +6,8 @@
 #include "globals.h"
 #include "config_manager.h"
 #include "diagnostics.h"
+#include "pulse_counter.h"
+#include "analog_sampler.h"
 #include <Arduino.h>
 #include <ArduinoJson.h>
 
@@ -435,8 +437,10 @@ void handleStatus() {
     doc["ip"] = WiFi.localIP().toString();
     doc["rssi"] = WiFi.RSSI();
   }
+  pulseCountersToJson(doc["pulses"].to<JsonObject>());
+  analogSamplerToJson(doc["analog"].to<JsonObject>());
   
-  char buffer[256];
+  char buffer[512];
   serializeJson(doc, buffer);
   webServer.send(200, "application/json", buffer);
 }
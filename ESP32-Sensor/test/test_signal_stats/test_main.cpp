@@ -0,0 +1,160 @@
+/*
+ * SignalStats Host Tests (runs on the build machine: pio test -e native)
+ *
+ * Feeds the decimator and window kernels from lib/SignalStats with sample
+ * fixtures in fixtures/ - 200 ms of raw 12-bit ADC codes per channel at
+ * the 10 kHz per-channel rate TaskAnalog sees - and checks the window
+ * statistics against reference values computed independently from the
+ * same files (exact integer decimation, double precision statistics).
+ */
+
+#include <unity.h>
+#include <signal_stats.h>
+
+#define DECIMATION 5
+
+static const uint16_t ctClamp[] = {
+#include "fixtures/ct_clamp_50hz.csv"
+};
+
+static const uint16_t pressureStep[] = {
+#include "fixtures/pressure_step.csv"
+};
+
+#define COUNT_OF(a) (sizeof(a) / sizeof((a)[0]))
+
+static uint16_t decimated[COUNT_OF(ctClamp) / DECIMATION + 1];
+
+// Decimate a fixture in uneven chunks, the way DMA frames split it, and
+// accumulate one window over the whole result
+static void runFixture(const uint16_t *samples, size_t n, size_t chunk, WindowResult &result) {
+  Decimator dec;
+  WindowStats window;
+  decimatorInit(dec, DECIMATION);
+  statsReset(window);
+
+  size_t total = 0;
+  for (size_t i = 0; i < n; i += chunk) {
+    size_t take = (n - i < chunk) ? n - i : chunk;
+    size_t produced = decimateBlock(dec, samples + i, take, decimated + total);
+    statsAddBlock(window, decimated + total, produced);
+    total += produced;
+  }
+  TEST_ASSERT_EQUAL_UINT32(n / DECIMATION, total);
+  statsCompute(window, result);
+}
+
+void setUp() {}
+void tearDown() {}
+
+void test_decimator_rounds_block_average() {
+  Decimator dec;
+  uint16_t out = 0;
+  decimatorInit(dec, 5);
+
+  const uint16_t up[] = {1, 2, 2, 2, 2};        // 1.8 -> 2
+  for (int i = 0; i < 4; i++) TEST_ASSERT_FALSE(decimatorPush(dec, up[i], out));
+  TEST_ASSERT_TRUE(decimatorPush(dec, up[4], out));
+  TEST_ASSERT_EQUAL_UINT16(2, out);
+
+  const uint16_t down[] = {0, 0, 0, 0, 2};      // 0.4 -> 0
+  for (int i = 0; i < 5; i++) decimatorPush(dec, down[i], out);
+  TEST_ASSERT_EQUAL_UINT16(0, out);
+
+  const uint16_t full[] = {4095, 4095, 4095, 4095, 4095};
+  for (int i = 0; i < 5; i++) decimatorPush(dec, full[i], out);
+  TEST_ASSERT_EQUAL_UINT16(4095, out);
+}
+
+void test_decimator_factor_zero_passes_through() {
+  Decimator dec;
+  uint16_t out = 0;
+  decimatorInit(dec, 0);
+  TEST_ASSERT_TRUE(decimatorPush(dec, 1234, out));
+  TEST_ASSERT_EQUAL_UINT16(1234, out);
+}
+
+// A block split across calls gives the same output as one call
+void test_decimator_carries_partial_blocks() {
+  Decimator whole, split;
+  uint16_t a[COUNT_OF(ctClamp) / DECIMATION + 1];
+  uint16_t b[COUNT_OF(ctClamp) / DECIMATION + 1];
+  decimatorInit(whole, DECIMATION);
+  decimatorInit(split, DECIMATION);
+
+  size_t n = decimateBlock(whole, ctClamp, 23, a);
+  size_t m = decimateBlock(split, ctClamp, 7, b);
+  TEST_ASSERT_EQUAL_UINT32(1, m);
+  TEST_ASSERT_EQUAL_UINT16(2, split.pending);
+  m += decimateBlock(split, ctClamp + 7, 1, b + m);
+  m += decimateBlock(split, ctClamp + 8, 15, b + m);
+
+  TEST_ASSERT_EQUAL_UINT32(4, n);
+  TEST_ASSERT_EQUAL_UINT32(n, m);
+  TEST_ASSERT_EQUAL_UINT16_ARRAY(a, b, n);
+  TEST_ASSERT_EQUAL_UINT16(whole.pending, split.pending);
+}
+
+void test_empty_window_is_zero() {
+  WindowStats window;
+  WindowResult result;
+  statsReset(window);
+  statsCompute(window, result);
+  TEST_ASSERT_EQUAL_UINT32(0, result.count);
+  TEST_ASSERT_EQUAL_FLOAT(0, result.mean);
+  TEST_ASSERT_EQUAL_FLOAT(0, result.rms);
+  TEST_ASSERT_EQUAL_FLOAT(0, result.peak);
+}
+
+void test_flat_signal_has_no_ac() {
+  WindowStats window;
+  WindowResult result;
+  statsReset(window);
+  for (int i = 0; i < 2000; i++) statsAdd(window, 3071);
+  statsCompute(window, result);
+  TEST_ASSERT_EQUAL_FLOAT(3071, result.mean);
+  TEST_ASSERT_EQUAL_FLOAT(0, result.rms);
+  TEST_ASSERT_EQUAL_FLOAT(0, result.peak);
+  TEST_ASSERT_EQUAL_UINT16(3071, result.min);
+  TEST_ASSERT_EQUAL_UINT16(3071, result.max);
+}
+
+// 900-code 50 Hz sine: RMS is 900 / sqrt(2) less the boxcar's ~0.1 %
+// attenuation at 50 Hz, peak is the amplitude plus noise
+void test_ct_clamp_fixture() {
+  const size_t chunks[] = {COUNT_OF(ctClamp), 512, 37, 1};
+  for (size_t c = 0; c < COUNT_OF(chunks); c++) {
+    WindowResult result;
+    runFixture(ctClamp, COUNT_OF(ctClamp), chunks[c], result);
+    TEST_ASSERT_EQUAL_UINT32(400, result.count);
+    TEST_ASSERT_FLOAT_WITHIN(0.01f, 2048.0525f, result.mean);
+    TEST_ASSERT_FLOAT_WITHIN(0.01f, 635.8281f, result.rms);
+    TEST_ASSERT_FLOAT_WITHIN(0.01f, 903.0525f, result.peak);
+    TEST_ASSERT_EQUAL_UINT16(1145, result.min);
+    TEST_ASSERT_EQUAL_UINT16(2950, result.max);
+  }
+}
+
+// Half the window at each level: RMS is half the step
+void test_pressure_step_fixture() {
+  WindowResult result;
+  runFixture(pressureStep, COUNT_OF(pressureStep), 250, result);
+  TEST_ASSERT_EQUAL_UINT32(400, result.count);
+  TEST_ASSERT_FLOAT_WITHIN(0.01f, 1640.065f, result.mean);
+  TEST_ASSERT_FLOAT_WITHIN(0.01f, 820.1969f, result.rms);
+  TEST_ASSERT_FLOAT_WITHIN(0.01f, 826.065f, result.peak);
+  TEST_ASSERT_EQUAL_UINT16(814, result.min);
+  TEST_ASSERT_EQUAL_UINT16(2465, result.max);
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_decimator_rounds_block_average);
+  RUN_TEST(test_decimator_factor_zero_passes_through);
+  RUN_TEST(test_decimator_carries_partial_blocks);
+  RUN_TEST(test_empty_window_is_zero);
+  RUN_TEST(test_flat_signal_has_no_ac);
+  RUN_TEST(test_ct_clamp_fixture);
+  RUN_TEST(test_pressure_step_fixture);
+  return UNITY_END();
+}
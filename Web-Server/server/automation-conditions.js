@@ -0,0 +1,293 @@
+/**
+ * Automation Conditions
+ *
+ * A rule condition is a JSON tree, validated once and compiled into
+ * closures. Leaves compare one telemetry parameter against a threshold;
+ * `all` / `any` combine children:
+ *
+ *   { parameter: 'tC', operator: '>', threshold: 30,
+ *     hysteresis: 1,                       // release only below 29
+ *     aggregate: 'avg', windowSeconds: 300, // compare the 5 min average
+ *     forSeconds: 60 }                      // must hold for 60 s
+ *
+ *   { all: [ { parameter: 'tC', ... }, { deviceId: 'OTHER', parameter: 'rh', ... } ],
+ *     forSeconds: 10 }
+ *
+ * `deviceId` on the root is the default for every leaf; a leaf may name
+ * another device. A plain { deviceId, parameter, operator, threshold }
+ * condition is a single leaf and behaves exactly as before.
+ *
+ * Windowed aggregates are kept incrementally in ring deques: avg keeps a
+ * running sum, max/min a monotonic deque. Each sample is pushed and
+ * evicted once, so evaluation cost does not depend on the window length.
+ */
+
+const OPERATORS = {
+  '>': (value, threshold) => value > threshold,
+  '<': (value, threshold) => value < threshold,
+  '>=': (value, threshold) => value >= threshold,
+  '<=': (value, threshold) => value <= threshold,
+  '==': (value, threshold) => Math.abs(value - threshold) < 0.01
+};
+
+// Once active, a leaf releases only when the value leaves the band
+const RELEASES = {
+  '>': (value, threshold, band) => value <= threshold - band,
+  '<': (value, threshold, band) => value >= threshold + band,
+  '>=': (value, threshold, band) => value < threshold - band,
+  '<=': (value, threshold, band) => value > threshold + band,
+  '==': (value, threshold, band) => Math.abs(value - threshold) >= Math.max(band, 0.01)
+};
+
+const AGGREGATES = ['avg', 'max', 'min'];
+const MAX_DEPTH = 4;
+const MAX_LEAVES = 16;
+const MAX_SECONDS = 86400;
+
+// ===== VALIDATION =====
+
+function optionalSeconds(value, name) {
+  if (value === undefined || value === null || value === 0) return 0;
+  const seconds = parseFloat(value);
+  if (!Number.isFinite(seconds) || seconds < 0 || seconds > MAX_SECONDS) {
+    throw new Error(`${name} must be between 0 and ${MAX_SECONDS}`);
+  }
+  return seconds;
+}
+
+// Returns a normalized copy; throws with a message suitable for a 400 response
+function parseCondition(node, defaultDeviceId, state = { depth: 0, leaves: 0 }) {
+  if (!node || typeof node !== 'object') throw new Error('Condition must be an object');
+  if (state.depth > MAX_DEPTH) throw new Error(`Conditions nest at most ${MAX_DEPTH} levels`);
+  const deviceId = typeof node.deviceId === 'string' ? node.deviceId : defaultDeviceId;
+  const forSeconds = optionalSeconds(node.forSeconds, 'forSeconds');
+  let parsed;
+
+  if (Array.isArray(node.all) || Array.isArray(node.any)) {
+    const kind = Array.isArray(node.all) ? 'all' : 'any';
+    if (node[kind].length === 0) throw new Error(`'${kind}' needs at least one condition`);
+    state.depth++;
+    parsed = { [kind]: node[kind].map(child => parseCondition(child, deviceId, state)) };
+    state.depth--;
+  } else {
+    if (++state.leaves > MAX_LEAVES) throw new Error(`At most ${MAX_LEAVES} comparisons per rule`);
+    if (typeof deviceId !== 'string' || typeof node.parameter !== 'string') {
+      throw new Error('Condition needs deviceId and parameter');
+    }
+    if (!OPERATORS[node.operator]) throw new Error(`Unknown operator ${node.operator}`);
+    const threshold = parseFloat(node.threshold);
+    if (!Number.isFinite(threshold)) throw new Error('Threshold must be a number');
+
+    parsed = { deviceId, parameter: node.parameter, operator: node.operator, threshold };
+
+    if (node.hysteresis !== undefined && node.hysteresis !== null && node.hysteresis !== 0) {
+      const hysteresis = parseFloat(node.hysteresis);
+      if (!Number.isFinite(hysteresis) || hysteresis < 0) throw new Error('Hysteresis must be a positive number');
+      parsed.hysteresis = hysteresis;
+    }
+    if (node.aggregate) {
+      if (!AGGREGATES.includes(node.aggregate)) throw new Error(`Unknown aggregate ${node.aggregate}`);
+      const windowSeconds = optionalSeconds(node.windowSeconds, 'windowSeconds');
+      if (windowSeconds === 0) throw new Error('Aggregates need windowSeconds');
+      parsed.aggregate = node.aggregate;
+      parsed.windowSeconds = windowSeconds;
+    }
+  }
+
+  // The root keeps its deviceId so simple rules read as before
+  if (state.depth === 0 && !parsed.deviceId && typeof node.deviceId === 'string') parsed.deviceId = node.deviceId;
+  if (forSeconds > 0) parsed.forSeconds = forSeconds;
+  return parsed;
+}
+
+// ===== SLIDING WINDOWS =====
+
+// Growable ring of (time, value) pairs
+class RingDeque {
+  constructor() {
+    this.t = new Float64Array(16);
+    this.v = new Float64Array(16);
+    this.head = 0;
+    this.size = 0;
+  }
+
+  _grow() {
+    const capacity = this.t.length * 2;
+    const t = new Float64Array(capacity);
+    const v = new Float64Array(capacity);
+    for (let i = 0; i < this.size; i++) {
+      const j = (this.head + i) & (this.t.length - 1);
+      t[i] = this.t[j];
+      v[i] = this.v[j];
+    }
+    this.t = t;
+    this.v = v;
+    this.head = 0;
+  }
+
+  push(t, v) {
+    if (this.size === this.t.length) this._grow();
+    const j = (this.head + this.size) & (this.t.length - 1);
+    this.t[j] = t;
+    this.v[j] = v;
+    this.size++;
+  }
+
+  frontTime() { return this.t[this.head]; }
+  frontValue() { return this.v[this.head]; }
+  backValue() { return this.v[(this.head + this.size - 1) & (this.t.length - 1)]; }
+
+  shift() {
+    this.head = (this.head + 1) & (this.t.length - 1);
+    this.size--;
+  }
+
+  pop() {
+    this.size--;
+  }
+}
+
+class WindowAverage {
+  constructor(windowMs) {
+    this.windowMs = windowMs;
+    this.samples = new RingDeque();
+    this.sum = 0;
+  }
+
+  push(t, v) {
+    this.samples.push(t, v);
+    this.sum += v;
+  }
+
+  evict(now) {
+    const samples = this.samples;
+    while (samples.size > 0 && samples.frontTime() <= now - this.windowMs) {
+      this.sum -= samples.frontValue();
+      samples.shift();
+    }
+    if (samples.size === 0) this.sum = 0;  // No drift carried into the next run
+  }
+
+  result() {
+    return this.samples.size > 0 ? this.sum / this.samples.size : undefined;
+  }
+}
+
+// Monotonic deque: values decrease (max) or increase (min) front to back,
+// so the front is the extreme of the window
+class WindowExtreme {
+  constructor(windowMs, wantMax) {
+    this.windowMs = windowMs;
+    this.wantMax = wantMax;
+    this.samples = new RingDeque();
+  }
+
+  push(t, v) {
+    const samples = this.samples;
+    while (samples.size > 0 && (this.wantMax ? samples.backValue() <= v : samples.backValue() >= v)) {
+      samples.pop();
+    }
+    samples.push(t, v);
+  }
+
+  evict(now) {
+    const samples = this.samples;
+    while (samples.size > 0 && samples.frontTime() <= now - this.windowMs) samples.shift();
+  }
+
+  result() {
+    return this.samples.size > 0 ? this.samples.frontValue() : undefined;
+  }
+}
+
+function createWindow(aggregate, windowMs) {
+  if (aggregate === 'avg') return new WindowAverage(windowMs);
+  return new WindowExtreme(windowMs, aggregate === 'max');
+}
+
+// ===== COMPILATION =====
+
+// Returns { evaluate(now, ctx), leaves }. Leaves are what telemetry feeds:
+// leaf.observe(value, now) for its (deviceId, parameter). evaluate() lowers
+// ctx.wakeAt to the next time a `forSeconds` hold could complete.
+function compileCondition(spec) {
+  const leaves = [];
+  const evaluate = compileNode(spec, leaves);
+  return { evaluate, leaves };
+}
+
+function compileNode(spec, leaves) {
+  let evaluate;
+  if (spec.all || spec.any) {
+    const children = (spec.all || spec.any).map(child => compileNode(child, leaves));
+    const wantAll = Boolean(spec.all);
+    // Every child is evaluated: holds and hysteresis track state on each pass
+    evaluate = (now, ctx) => {
+      let result = wantAll;
+      for (const child of children) {
+        const met = child(now, ctx);
+        result = wantAll ? result && met : result || met;
+      }
+      return result;
+    };
+  } else {
+    evaluate = compileLeaf(spec, leaves);
+  }
+  return spec.forSeconds ? compileHold(evaluate, spec.forSeconds * 1000) : evaluate;
+}
+
+function compileLeaf(spec, leaves) {
+  const { threshold } = spec;
+  const compare = OPERATORS[spec.operator];
+  const release = RELEASES[spec.operator];
+  const band = spec.hysteresis || 0;
+  const window = spec.aggregate ? createWindow(spec.aggregate, spec.windowSeconds * 1000) : null;
+  let latest;
+  let active = false;
+
+  leaves.push({
+    deviceId: spec.deviceId,
+    parameter: spec.parameter,
+    observe(value, now) {
+      const numeric = typeof value === 'number' ? value : (typeof value === 'boolean' ? +value : undefined);
+      if (window) {
+        // A message without the parameter leaves the window as it was
+        if (numeric !== undefined) window.push(now, numeric);
+      } else {
+        latest = numeric;
+      }
+    }
+  });
+
+  return (now) => {
+    let value = latest;
+    if (window) {
+      window.evict(now);
+      value = window.result();
+    }
+    if (value === undefined) {
+      active = false;
+    } else if (!active) {
+      active = compare(value, threshold);
+    } else {
+      active = !release(value, threshold, band);
+    }
+    return active;
+  };
+}
+
+function compileHold(inner, holdMs) {
+  let since = null;
+  return (now, ctx) => {
+    if (!inner(now, ctx)) {
+      since = null;
+      return false;
+    }
+    if (since === null) since = now;
+    if (now - since >= holdMs) return true;
+    if (since + holdMs < ctx.wakeAt) ctx.wakeAt = since + holdMs;
+    return false;
+  };
+}
+
+module.exports = { parseCondition, compileCondition, OPERATORS };
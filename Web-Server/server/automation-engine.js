@@ -0,0 +1,300 @@
+/**
+ * Automation Engine
+ *
+ * Rules evaluated on the server as telemetry arrives:
+ *
+ *   IF <condition>   (see automation-conditions.js)
+ *   THEN set <action.deviceId> GPIO <action.gpio> to <action.state>
+ *
+ * Each comparison in a condition is indexed by its device and parameter,
+ * so a telemetry message only touches the rules watching that device; a
+ * device nobody watches costs one Map lookup and its payload is never
+ * parsed. A rule fires on the rising edge of its condition; with
+ * autoToggle it also sends state 0 on the falling edge. A `forSeconds`
+ * hold that is still pending re-evaluates its rule on a timer, so it
+ * completes even if no further telemetry arrives.
+ *
+ * Rules are persisted as JSON (written to a temp file, then renamed) and
+ * reloaded at startup. Edge state is runtime only.
+ */
+
+const fs = require('fs');
+const path = require('path');
+const crypto = require('crypto');
+const { parseCondition, compileCondition } = require('./automation-conditions');
+
+const SAVE_DELAY_MS = 200;             // Coalesce bursts of API edits
+const LATENCY_WINDOW = 256;            // Samples kept for percentiles
+
+// Validates API input; throws with a message suitable for a 400 response
+function parseRule(input, id) {
+  if (!input || typeof input !== 'object') throw new Error('Rule must be an object');
+  const { name, condition, action } = input;
+  if (typeof name !== 'string' || name.length === 0) throw new Error('Missing rule name');
+  const parsedCondition = parseCondition(condition);
+  if (!action || typeof action.deviceId !== 'string') throw new Error('Action needs deviceId');
+  const gpio = parseInt(action.gpio);
+  if (!Number.isInteger(gpio) || gpio < 1 || gpio > 8) throw new Error('Action GPIO must be 1-8');
+
+  return {
+    id,
+    name,
+    enabled: input.enabled !== false,
+    condition: parsedCondition,
+    action: {
+      deviceId: action.deviceId,
+      gpio,
+      state: action.state === true || parseInt(action.state) === 1 ? 1 : 0
+    },
+    autoToggle: input.autoToggle === true
+  };
+}
+
+class AutomationEngine {
+  // execute(action, rule, trigger) publishes the command and returns false
+  // if it was skipped; it calls trigger.done() once the broker has routed it
+  constructor({ file, execute }) {
+    this.file = file;
+    this.execute = execute;
+    this.rules = new Map();          // id -> rule
+    this.compiled = new Map();       // id -> { evaluate, leaves, timer, pass }
+    this.index = new Map();          // deviceId -> Map(parameter -> [{ rule, compiled, leaf }])
+    this.pass = 0;                   // Telemetry messages evaluated, marks rules already touched
+    this.ctx = { wakeAt: Infinity }; // Reused by every evaluation (synchronous)
+    this.saveTimer = null;
+    this.saving = Promise.resolve();
+    this.stats = {
+      evaluations: 0,
+      fired: 0,
+      skipped: 0,
+      latency: { samples: [], next: 0, last: 0, max: 0 }
+    };
+    this._load();
+  }
+
+  // ===== RULE STORE =====
+
+  _load() {
+    let stored = [];
+    try {
+      stored = JSON.parse(fs.readFileSync(this.file, 'utf8'));
+    } catch (error) {
+      if (error.code !== 'ENOENT') console.error('[AUTOMATION] Could not load rules:', error.message);
+    }
+    for (const input of stored) {
+      try {
+        this._insert(parseRule(input, input.id));
+      } catch (error) {
+        console.error('[AUTOMATION] Skipping stored rule:', error.message);
+      }
+    }
+    if (this.rules.size > 0) console.log('[AUTOMATION] Loaded', this.rules.size, 'rules');
+  }
+
+  _save() {
+    if (this.saveTimer) return;
+    this.saveTimer = setTimeout(() => {
+      this.saveTimer = null;
+      this._write();
+    }, SAVE_DELAY_MS);
+  }
+
+  _write() {
+    // Runtime fields are not persisted
+    const json = JSON.stringify(this.list().map(({ lastState, lastFiredAt, lastLatencyMs, ...rule }) => rule), null, 2);
+    const temp = this.file + '.tmp';
+    this.saving = this.saving
+      .then(() => fs.promises.mkdir(path.dirname(this.file), { recursive: true }))
+      .then(() => fs.promises.writeFile(temp, json))
+      .then(() => fs.promises.rename(temp, this.file))
+      .catch((error) => console.error('[AUTOMATION] Could not save rules:', error.message));
+  }
+
+  _insert(rule) {
+    rule.lastState = false;
+    rule.lastFiredAt = null;
+    rule.lastLatencyMs = null;
+    this.rules.set(rule.id, rule);
+
+    const compiled = compileCondition(rule.condition);
+    compiled.timer = null;
+    compiled.pass = 0;
+    this.compiled.set(rule.id, compiled);
+
+    for (const leaf of compiled.leaves) {
+      let params = this.index.get(leaf.deviceId);
+      if (!params) {
+        params = new Map();
+        this.index.set(leaf.deviceId, params);
+      }
+      if (!params.has(leaf.parameter)) params.set(leaf.parameter, []);
+      params.get(leaf.parameter).push({ rule, compiled, leaf });
+    }
+  }
+
+  _unindex(rule) {
+    const compiled = this.compiled.get(rule.id);
+    if (!compiled) return;
+    clearTimeout(compiled.timer);
+    this.compiled.delete(rule.id);
+
+    for (const leaf of compiled.leaves) {
+      const params = this.index.get(leaf.deviceId);
+      const bucket = params && params.get(leaf.parameter);
+      if (!bucket) continue;
+      const index = bucket.findIndex(entry => entry.leaf === leaf);
+      if (index !== -1) bucket.splice(index, 1);
+      if (bucket.length === 0) params.delete(leaf.parameter);
+      if (params.size === 0) this.index.delete(leaf.deviceId);
+    }
+  }
+
+  list() {
+    return Array.from(this.rules.values());
+  }
+
+  get(id) {
+    return this.rules.get(id) || null;
+  }
+
+  add(input) {
+    const rule = parseRule(input, crypto.randomBytes(6).toString('hex'));
+    this._insert(rule);
+    this._save();
+    return rule;
+  }
+
+  // Replaces the rule's definition; edge state restarts from false
+  update(id, input) {
+    const existing = this.rules.get(id);
+    if (!existing) return null;
+    const rule = parseRule({ ...existing, ...input }, id);
+    this._unindex(existing);
+    this._insert(rule);
+    this._save();
+    return rule;
+  }
+
+  remove(id) {
+    const rule = this.rules.get(id);
+    if (!rule) return false;
+    this._unindex(rule);
+    this.rules.delete(id);
+    this._save();
+    return true;
+  }
+
+  // Writes a pending save now; resolves when the file is in place
+  flush() {
+    if (this.saveTimer) {
+      clearTimeout(this.saveTimer);
+      this.saveTimer = null;
+      this._write();
+    }
+    return this.saving;
+  }
+
+  // ===== EVALUATION =====
+
+  // Called from the telemetry route with the shared TopicMessage
+  onTelemetry(deviceId, message) {
+    const params = this.index.get(deviceId);
+    if (!params) return;
+
+    // The hook runs synchronously on receipt, so this is the trigger time
+    const triggeredAt = process.hrtime.bigint();
+    const telemetry = message.json();
+    if (!telemetry) return;
+
+    // Feed every watching comparison first, then evaluate each rule once;
+    // a rule with several leaves on this device is collected only once
+    const now = message.receivedAt;
+    const pass = ++this.pass;
+    const touched = [];
+    for (const [parameter, entries] of params) {
+      const value = telemetry[parameter];
+      for (const entry of entries) {
+        if (!entry.rule.enabled) continue;
+        entry.leaf.observe(value, now);
+        if (entry.compiled.pass !== pass) {
+          entry.compiled.pass = pass;
+          touched.push(entry);
+        }
+      }
+    }
+    for (const { rule, compiled } of touched) this._evaluate(rule, compiled, now, triggeredAt);
+  }
+
+  _evaluate(rule, compiled, now, triggeredAt) {
+    this.stats.evaluations++;
+
+    const ctx = this.ctx;
+    ctx.wakeAt = Infinity;
+    const met = compiled.evaluate(now, ctx);
+    const previous = rule.lastState;
+    rule.lastState = met;
+
+    if (met && !previous) {
+      this._fire(rule, rule.action, triggeredAt);
+    } else if (!met && previous && rule.autoToggle) {
+      this._fire(rule, { ...rule.action, state: 0 }, triggeredAt);
+    }
+
+    // A pending hold completes at wakeAt even without new telemetry
+    if (compiled.timer) {
+      clearTimeout(compiled.timer);
+      compiled.timer = null;
+    }
+    if (ctx.wakeAt !== Infinity) {
+      compiled.timer = setTimeout(() => {
+        compiled.timer = null;
+        if (rule.enabled) this._evaluate(rule, compiled, Date.now(), process.hrtime.bigint());
+      }, Math.max(0, ctx.wakeAt - now));
+      compiled.timer.unref();
+    }
+  }
+
+  _fire(rule, action, triggeredAt) {
+    const trigger = {
+      done: () => {
+        const latencyMs = Number(process.hrtime.bigint() - triggeredAt) / 1e6;
+        rule.lastLatencyMs = latencyMs;
+        this._recordLatency(latencyMs);
+      }
+    };
+    if (this.execute(action, rule, trigger) === false) {
+      this.stats.skipped++;
+      return;
+    }
+    rule.lastFiredAt = Date.now();
+    this.stats.fired++;
+  }
+
+  _recordLatency(ms) {
+    const latency = this.stats.latency;
+    if (latency.samples.length < LATENCY_WINDOW) latency.samples.push(ms);
+    else latency.samples[latency.next] = ms;
+    latency.next = (latency.next + 1) % LATENCY_WINDOW;
+    latency.last = ms;
+    if (ms > latency.max) latency.max = ms;
+  }
+
+  // Trigger-to-command latency: receipt of the telemetry to the command
+  // having been routed by the broker
+  summary() {
+    const { samples, last, max } = this.stats.latency;
+    const sorted = samples.slice().sort((a, b) => a - b);
+    const round = (ms) => ms === null ? null : Math.round(ms * 100) / 100;
+    const percentile = (p) => sorted.length ? round(sorted[Math.min(sorted.length - 1, Math.floor(sorted.length * p))]) : null;
+    return {
+      rules: this.rules.size,
+      watchedDevices: this.index.size,
+      evaluations: this.stats.evaluations,
+      fired: this.stats.fired,
+      skipped: this.stats.skipped,
+      latencyMs: { last: round(last), max: round(max), p50: percentile(0.5), p99: percentile(0.99) }
+    };
+  }
+}
+
+module.exports = { AutomationEngine };
@@ -0,0 +1,114 @@
+/**
+ * Automation Engine Benchmark
+ *
+ * `npm run bench:automation` loads 10k threshold rules into an
+ * AutomationEngine, spread over the watched devices three ways
+ * (1000 x 10, 100 x 100, 1 x 10000), and feeds telemetry through
+ * onTelemetry() as the telemetry route does. Per layout it reports:
+ *
+ *   indexed     time per message, JSON parse and edge handling included
+ *   unwatched   time per message from a device no rule watches
+ *   linear      one pass of plain comparisons over all rules per message:
+ *               the least an engine without the device/parameter index
+ *               would spend, with no hysteresis, windows or edge handling
+ *
+ * Telemetry cycles through values that cross the thresholds, so rules keep
+ * firing; `steady` as the first argument keeps values constant instead.
+ * Rules are not saved; commands go to a counter.
+ *
+ *   node bench/automation.js [steady]
+ */
+
+const os = require('os');
+const path = require('path');
+const { AutomationEngine } = require('../automation-engine');
+const { TopicMessage } = require('../topic-router');
+
+const RULES = 10000;
+const LAYOUTS = [[1000, 10], [100, 100], [1, 10000]];
+const PARAMETERS = ['tC', 'rh', 'heap', 'rssi'];
+const OPERATORS = ['>', '<', '>=', '<=', '=='];
+const STEADY = process.argv[2] === 'steady';
+
+function createEngine(devices, perDevice) {
+  let fired = 0;
+  const engine = new AutomationEngine({
+    file: path.join(os.tmpdir(), `bench-automation-${process.pid}.json`),
+    execute: (action, rule, trigger) => {
+      fired++;
+      trigger.done();
+    }
+  });
+  engine._save = () => {};           // Keep the benchmark off the disk
+  for (let d = 0; d < devices; d++) {
+    for (let i = 0; i < perDevice; i++) {
+      engine.add({
+        name: 'rule ' + i,
+        condition: {
+          deviceId: 'S' + d,
+          parameter: PARAMETERS[i % PARAMETERS.length],
+          operator: OPERATORS[i % OPERATORS.length],
+          threshold: 20 + (i % 10)
+        },
+        action: { deviceId: 'A', gpio: 1 + (i % 8), state: 1 },
+        autoToggle: i % 2 === 0
+      });
+    }
+  }
+  return { engine, fired: () => fired };
+}
+
+// The same comparisons evaluated for every rule, as an unindexed engine would
+function linearPass(rules, telemetry) {
+  let met = 0;
+  for (const rule of rules) {
+    const { parameter, operator, threshold } = rule.condition;
+    const value = telemetry[parameter];
+    if (value === undefined) continue;
+    switch (operator) {
+      case '>': met += value > threshold; break;
+      case '<': met += value < threshold; break;
+      case '>=': met += value >= threshold; break;
+      case '<=': met += value <= threshold; break;
+      default: met += Math.abs(value - threshold) < 0.01;
+    }
+  }
+  return met;
+}
+
+// 20 payloads, tC sweeping 15..34 across every threshold
+const payloads = Array.from({ length: 20 }, (_, k) =>
+  Buffer.from(JSON.stringify({ tC: 15 + k, rh: 40 + k / 10, heap: 100000, rssi: -60 })));
+
+// The round-th message of a device carries payload `round`
+function telemetryMessage(deviceId, round) {
+  const payload = payloads[STEADY ? 7 : round % payloads.length];
+  return new TopicMessage('devices/' + deviceId + '/telemetry', { payload }, null);
+}
+
+function timePerMessage(count, fn) {
+  const start = process.hrtime.bigint();
+  for (let i = 0; i < count; i++) fn(i);
+  return Number(process.hrtime.bigint() - start) / count / 1000;
+}
+
+console.log(`[BENCH] ${RULES} rules, ${STEADY ? 'steady' : 'changing'} telemetry, node ${process.version}`);
+for (const [devices, perDevice] of LAYOUTS) {
+  const { engine, fired } = createEngine(devices, perDevice);
+  const messages = Math.max(2000, Math.min(200000, 2e6 / perDevice));
+
+  const indexedUs = timePerMessage(messages, (i) => {
+    const deviceId = 'S' + (i % devices);
+    engine.onTelemetry(deviceId, telemetryMessage(deviceId, Math.floor(i / devices)));
+  });
+  const unwatchedUs = timePerMessage(200000, (i) => engine.onTelemetry('OTHER', telemetryMessage('OTHER', i)));
+
+  const rules = engine.list();
+  const telemetry = JSON.parse(payloads[7]);
+  const linearUs = timePerMessage(2000, () => linearPass(rules, telemetry));
+
+  const summary = engine.summary();
+  console.log(`[BENCH] ${devices} devices x ${perDevice} rules: indexed ${indexedUs.toFixed(2)} us/msg, ` +
+              `unwatched ${(unwatchedUs * 1000).toFixed(0)} ns/msg, linear ${linearUs.toFixed(1)} us/msg; ` +
+              `${messages} msgs, fired ${fired()}, latency p99 ${summary.latencyMs.p99} ms`);
+}
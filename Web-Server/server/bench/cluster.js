@@ -0,0 +1,198 @@
+/**
+ * Cluster Ingest Benchmark
+ *
+ * `npm run bench:cluster` connects simulated devices to a running server
+ * (`npm start` or `npm run cluster`) over MQTT and publishes telemetry at a
+ * paced rate, QoS 0. Before and after the run it reads /api/health and
+ * reports, per process, the messages its topic router handled, its rate
+ * and the CPU it spent per message:
+ *
+ *   app        server.js (all handling under `npm start`; registry,
+ *              presence and automation in cluster mode)
+ *   broker N   broker worker in slot N (aedes and history ingest of its
+ *              own clients)
+ *   bench      this load generator, when sharing the machine
+ *
+ * Compare `npm start` with `npm run cluster` at the same rate, and cluster
+ * runs with different CLUSTER_BROKERS. Scaling needs spare cores: on one
+ * core every process shares it, so only the per-message CPU is meaningful.
+ *
+ *   node bench/cluster.js [devices=1000] [msgs/s=10000] [seconds=10]
+ */
+
+const net = require('net');
+const http = require('http');
+
+const DEVICES = parseInt(process.argv[2], 10) || 1000;
+const RATE = parseInt(process.argv[3], 10) || 10000;
+const SECONDS = parseFloat(process.argv[4]) || 10;
+const HOST = process.env.BENCH_HOST || 'localhost';
+const MQTT_PORT = parseInt(process.env.MQTT_PORT, 10) || 1883;
+const HTTP_PORT = parseInt(process.env.HTTP_PORT, 10) || 3000;
+const TICK_MS = 10;
+const DRAIN_TIMEOUT_MS = 10000;
+
+// ===== MQTT PACKETS =====
+// Just enough of MQTT 3.1.1 to connect and publish at QoS 0
+function remainingLength(length) {
+  const bytes = [];
+  do {
+    let byte = length % 128;
+    length = Math.floor(length / 128);
+    if (length > 0) byte |= 0x80;
+    bytes.push(byte);
+  } while (length > 0);
+  return Buffer.from(bytes);
+}
+
+function mqttString(value) {
+  const data = Buffer.from(value);
+  const length = Buffer.alloc(2);
+  length.writeUInt16BE(data.length);
+  return Buffer.concat([length, data]);
+}
+
+function connectPacket(clientId) {
+  // Protocol "MQTT" level 4, clean session, keepalive off
+  const body = Buffer.concat([mqttString('MQTT'), Buffer.from([4, 0x02, 0, 0]), mqttString(clientId)]);
+  return Buffer.concat([Buffer.from([0x10]), remainingLength(body.length), body]);
+}
+
+function publishPacket(topic, payload) {
+  const body = Buffer.concat([mqttString(topic), payload]);
+  return Buffer.concat([Buffer.from([0x30]), remainingLength(body.length), body]);
+}
+
+// ===== DEVICES =====
+function connectDevice(index) {
+  return new Promise((resolve, reject) => {
+    const id = 'BENCH-' + index.toString(16).padStart(4, '0');
+    const socket = net.connect(MQTT_PORT, HOST);
+    socket.setNoDelay(true);
+    socket.once('error', reject);
+    socket.once('data', (data) => {
+      // CONNACK with return code 0
+      if (data[0] !== 0x20 || data[3] !== 0) return reject(new Error('Connection refused for ' + id));
+      resolve({ id, socket, topic: 'devices/' + id + '/telemetry' });
+    });
+    socket.write(connectPacket(id));
+  });
+}
+
+async function connectAll() {
+  const devices = [];
+  for (let i = 0; i < DEVICES; i += 100) {
+    const batch = [];
+    for (let j = i; j < Math.min(DEVICES, i + 100); j++) batch.push(connectDevice(j));
+    devices.push(...await Promise.all(batch));
+  }
+  return devices;
+}
+
+// ===== HEALTH =====
+function health() {
+  return new Promise((resolve, reject) => {
+    http.get({ host: HOST, port: HTTP_PORT, path: '/api/health' }, (res) => {
+      let body = '';
+      res.on('data', (chunk) => body += chunk);
+      res.on('end', () => {
+        try {
+          resolve(JSON.parse(body));
+        } catch (error) {
+          reject(error);
+        }
+      });
+    }).on('error', reject);
+  });
+}
+
+// One { name, dispatched, cpuUs } per process found in a health report
+function processes(report) {
+  const list = [{
+    name: 'app',
+    dispatched: report.router.dispatched,
+    cpuUs: report.cpu ? report.cpu.user + report.cpu.system : NaN
+  }];
+  const brokers = (report.cluster && report.cluster.brokers) || [];
+  for (const broker of brokers) {
+    if (!broker) continue;
+    list.push({
+      name: 'broker ' + broker.slot,
+      dispatched: broker.router.dispatched,
+      cpuUs: broker.cpu.user + broker.cpu.system
+    });
+  }
+  return list;
+}
+
+// ===== RUN =====
+// Sends RATE msgs/s for SECONDS every TICK_MS, round-robin over devices
+function publishPaced(devices) {
+  return new Promise((resolve) => {
+    const total = Math.round(RATE * SECONDS);
+    let sent = 0;
+    const start = Date.now();
+    const timer = setInterval(() => {
+      // Whatever is due by now, so late ticks catch up
+      const due = Math.min(total, Math.round(RATE * (Date.now() - start + TICK_MS) / 1000));
+      while (sent < due) {
+        const device = devices[sent % devices.length];
+        const payload = Buffer.from(JSON.stringify({
+          tC: 20 + (sent % 50) / 10, rh: 40 + (sent % 30) / 10, heap: 180000 - (sent % 1000), rssi: -60, uptime: sent
+        }));
+        device.socket.write(publishPacket(device.topic, payload));
+        sent++;
+      }
+      if (sent < total) return;
+      clearInterval(timer);
+      resolve({ sent, seconds: (Date.now() - start) / 1000 });
+    }, TICK_MS);
+  });
+}
+
+// Waits until the app has routed everything sent, or gives up
+async function drain(before, sent) {
+  const deadline = Date.now() + DRAIN_TIMEOUT_MS;
+  let report;
+  do {
+    await new Promise((resolve) => setTimeout(resolve, 200));
+    report = await health();
+  } while (report.router.dispatched - before.router.dispatched < sent && Date.now() < deadline);
+  return report;
+}
+
+async function main() {
+  const devices = await connectAll();
+  const before = await health();
+  const startedAt = Date.now();
+  const cpuStart = process.cpuUsage();
+  console.log(`[BENCH] ${devices.length} devices, ${RATE} msgs/s for ${SECONDS} s, ` +
+              `${before.cluster ? (before.cluster.brokers || []).length + ' broker workers' : 'single process'}, node ${process.version}`);
+
+  const { sent, seconds } = await publishPaced(devices);
+  const benchCpu = process.cpuUsage(cpuStart);
+  const after = await drain(before, sent);
+  const elapsed = (Date.now() - startedAt) / 1000;
+
+  console.log(`[BENCH] sent ${sent} in ${seconds.toFixed(1)} s (${Math.round(sent / seconds)} msgs/s)`);
+  console.log('[BENCH] process      msgs   msgs/s   CPU us/msg   CPU %');
+  const start = new Map(processes(before).map((p) => [p.name, p]));
+  const rows = processes(after).map((p) => {
+    const first = start.get(p.name);
+    if (!first) return null;
+    return { name: p.name, messages: p.dispatched - first.dispatched, cpuUs: p.cpuUs - first.cpuUs };
+  }).filter(Boolean);
+  rows.push({ name: 'bench', messages: sent, cpuUs: benchCpu.user + benchCpu.system });
+  for (const row of rows) {
+    console.log(`[BENCH] ${row.name.padEnd(10)} ${String(row.messages).padStart(7)} ${String(Math.round(row.messages / elapsed)).padStart(8)} ` +
+                `${(row.messages ? row.cpuUs / row.messages : 0).toFixed(1).padStart(12)} ${(row.cpuUs / elapsed / 1e4).toFixed(1).padStart(7)}`);
+  }
+  if (rows[0].messages < sent) console.log(`[BENCH] app fell behind: ${sent - rows[0].messages} messages not routed within ${DRAIN_TIMEOUT_MS / 1000} s`);
+
+  for (const device of devices) device.socket.end();
+}
+
+main().catch((error) => {
+  console.error('[BENCH] Error:', error.message);
+  process.exit(1);
+});
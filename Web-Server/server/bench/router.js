@@ -0,0 +1,148 @@
+/**
+ * Publish Hook Benchmark
+ *
+ * `npm run bench:router` feeds a fleet-like packet mix through three variants
+ * of the aedes publish hook:
+ *
+ *   baseline   the hook before topic-router.js: startsWith/endsWith checks,
+ *              topic.split() and JSON.parse per route
+ *   trie       TopicRouter with the server's routes; the telemetry handler
+ *              parses once, as history and automation do in server.js
+ *   trie-lazy  the same, with nobody reading the payload
+ *
+ * For each it reports the maximum rate on one loop and the CPU used at a
+ * paced 1k, 10k and 100k msgs/s. Handlers only do the routing work; the
+ * registry, history and automation behind them are benchmarked separately.
+ *
+ *   node bench/router.js [devices=1000] [seconds per paced run=3]
+ */
+
+const { TopicRouter } = require('../topic-router');
+
+const DEVICES = parseInt(process.argv[2], 10) || 1000;
+const PACED_SECONDS = parseFloat(process.argv[3]) || 3;
+const RATES = [1000, 10000, 100000];
+const MAX_PACKETS = 300000;
+const TICK_MS = 10;
+
+// ===== PACKET MIX =====
+// Per 100 packets: 90 telemetry, 4 status, 3 acks, 3 command echoes, like
+// a fleet of sensors reporting every few seconds with some actuators
+function buildPackets(count) {
+  const packets = [];
+  for (let i = 0; i < count; i++) {
+    const id = 'ESP32-IOT-SENSORS-' + (i % DEVICES).toString(16).padStart(4, '0');
+    const kind = i % 100;
+    let topic;
+    let body;
+    if (kind < 90) {
+      topic = 'devices/' + id + '/telemetry';
+      body = { tC: 20 + (i % 50) / 10, rh: 40 + (i % 30) / 10, heap: 180000 - (i % 1000), rssi: -60 - (i % 20), uptime: i };
+    } else if (kind < 94) {
+      topic = 'devices/' + id + '/status';
+      body = { online: true, ip: '192.168.1.' + (i % 250), fw: '2.0.0' };
+    } else if (kind < 97) {
+      topic = 'devices/' + id + '/ack';
+      body = { cid: 'c' + i, seq: i, ok: true };
+    } else {
+      topic = 'device/' + id + '/gpio/set';
+      body = { gpio: 1 + (i % 8), state: i & 1 };
+    }
+    packets.push({ cmd: 'publish', topic, payload: Buffer.from(JSON.stringify(body)), qos: 0, retain: false });
+  }
+  return packets;
+}
+
+// ===== HOOKS =====
+function baselineHook() {
+  const latest = new Map();
+  let acks = 0;
+  return (packet) => {
+    const topic = packet.topic;
+    const payload = packet.payload.toString();
+    if (topic.startsWith('devices/') && topic.endsWith('/telemetry')) {
+      const deviceId = topic.split('/')[1];
+      try {
+        latest.set(deviceId, JSON.parse(payload));
+      } catch (error) {}
+    }
+    if (topic.startsWith('devices/') && topic.endsWith('/ack')) {
+      const deviceId = topic.split('/')[1];
+      try {
+        if (JSON.parse(payload).cid && deviceId) acks++;
+      } catch (error) {}
+    }
+    if (topic.startsWith('device/') && topic.endsWith('/gpio/set')) {
+      topic.split('/');
+    }
+  };
+}
+
+function trieHook(parseTelemetry) {
+  const router = new TopicRouter();
+  const latest = new Map();
+  let acks = 0;
+  router.add('devices/+/telemetry', (message, [deviceId]) => {
+    latest.set(deviceId, message);
+    if (parseTelemetry) message.json();
+  });
+  router.add('devices/+/status', (message) => message.json());
+  router.add('devices/+/ack', (message) => {
+    const ack = message.json();
+    if (ack && ack.cid) acks++;
+  });
+  router.add('device/+/gpio/set', () => {});
+  return (packet) => router.dispatch(packet.topic, packet, null);
+}
+
+// ===== RUNS =====
+function maxRate(hook, packets) {
+  for (let i = 0; i < 20000; i++) hook(packets[i % packets.length]);  // Warm up the JIT
+  const start = process.hrtime.bigint();
+  for (let i = 0; i < packets.length; i++) hook(packets[i]);
+  const seconds = Number(process.hrtime.bigint() - start) / 1e9;
+  return packets.length / seconds;
+}
+
+// Delivers `rate` msgs/s in TICK_MS batches and returns the CPU share used
+function paced(hook, packets, rate) {
+  return new Promise((resolve) => {
+    const perTick = rate * TICK_MS / 1000;
+    const ticks = PACED_SECONDS * 1000 / TICK_MS;
+    let next = 0;
+    let tick = 0;
+    const cpuStart = process.cpuUsage();
+    const start = process.hrtime.bigint();
+    const timer = setInterval(() => {
+      for (let i = 0; i < perTick; i++) {
+        hook(packets[next]);
+        next = (next + 1) % packets.length;
+      }
+      if (++tick < ticks) return;
+      clearInterval(timer);
+      const cpu = process.cpuUsage(cpuStart);
+      const wallUs = Number(process.hrtime.bigint() - start) / 1000;
+      resolve((cpu.user + cpu.system) / wallUs * 100);
+    }, TICK_MS);
+  });
+}
+
+async function main() {
+  const packets = buildPackets(MAX_PACKETS);
+  console.log(`[BENCH] ${packets.length} packets from ${DEVICES} devices, node ${process.version}`);
+  console.log('[BENCH] hook       max msgs/s   CPU % at ' + RATES.map((r) => r / 1000 + 'k').join(' / ') + ' msgs/s');
+
+  const hooks = [
+    ['baseline', baselineHook()],
+    ['trie', trieHook(true)],
+    ['trie-lazy', trieHook(false)]
+  ];
+  for (const [name, hook] of hooks) {
+    const max = maxRate(hook, packets);
+    const cpu = [];
+    for (const rate of RATES) cpu.push((await paced(hook, packets, rate)).toFixed(1));
+    console.log(`[BENCH] ${name.padEnd(10)} ${Math.round(max).toString().padStart(10)}   ${cpu.join(' / ')}`);
+  }
+}
+
+main();
@@ -0,0 +1,359 @@
+/**
+ * Broker Persistence
+ *
+ * Keeps the broker's durable state and the device registry on local disk,
+ * so a restart comes back with retained messages (device status, output
+ * state), subscriptions of persistent sessions, pending Last Wills and
+ * every known device.
+ *
+ * aedes keeps using the in-memory aedes-persistence for lookups; wrap()
+ * patches its mutating methods so every change is also appended to a
+ * write-ahead log. Periodically the whole state is written as a snapshot
+ * and a new log is started:
+ *
+ *   data/state/snapshot-<gen>.json   state when generation <gen> began
+ *   data/state/wal-<gen>.log         one JSON record per line, after that
+ *
+ * Loading takes the newest snapshot and replays its log and any later
+ * ones. Log records are appended in one batch per event-loop turn,
+ * asynchronously and in order, so a crash loses at most the batches not
+ * yet written; a torn last line is ignored.
+ * In-flight QoS 1/2 packets are not persisted.
+ */
+
+const fs = require('fs');
+const path = require('path');
+
+const SNAPSHOT_INTERVAL_MS = 60000;
+const WAL_MAX_BYTES = 16 * 1024 * 1024;   // Snapshot early past this
+const SNAPSHOT_VERSION = 1;
+
+function encodePacket(packet) {
+  return { topic: packet.topic, payload: Buffer.from(packet.payload || '').toString('base64'), qos: packet.qos || 0 };
+}
+
+function decodePacket(stored) {
+  return { cmd: 'publish', topic: stored.topic, payload: Buffer.from(stored.payload, 'base64'), qos: stored.qos, retain: true };
+}
+
+class BrokerPersistence {
+  // registry: { dump() -> [device records], restore([device records]) }
+  constructor(dir, { registry, snapshotIntervalMs = SNAPSHOT_INTERVAL_MS }) {
+    this.dir = dir;
+    this.registry = registry;
+    this.snapshotIntervalMs = snapshotIntervalMs;
+
+    // Durable state mirrored from the broker, written out by snapshots
+    this.retained = new Map();       // topic -> { topic, payload (base64), qos }
+    this.subscriptions = new Map();  // clientId -> Map(topic -> qos)
+    this.wills = new Map();          // clientId -> will packet (payload base64)
+    this.devices = new Map();        // deviceId -> record logged since the snapshot
+
+    this.generation = 0;
+    this.walHandle = null;           // Open log file, only touched by the chain
+    this.walChain = Promise.resolve();
+    this.walBytes = 0;
+    this.walQueue = [];
+    this.snapshotting = null;
+    this.stats = { loadMs: 0, replayed: 0, walRecords: 0, snapshots: 0, lastSnapshotMs: 0 };
+  }
+
+  // ===== LOADING =====
+
+  // Reads snapshot and logs synchronously; call before the broker starts
+  load() {
+    const started = process.hrtime.bigint();
+    fs.mkdirSync(this.dir, { recursive: true });
+
+    const files = fs.readdirSync(this.dir);
+    const generations = (prefix, suffix) => files
+      .filter(name => name.startsWith(prefix) && name.endsWith(suffix))
+      .map(name => parseInt(name.slice(prefix.length, -suffix.length), 10))
+      .filter(Number.isInteger)
+      .sort((a, b) => a - b);
+
+    const snapshots = generations('snapshot-', '.json');
+    let base = 0;
+    let devices = [];
+    // The newest snapshot that parses wins; a half-written one is skipped
+    for (let i = snapshots.length - 1; i >= 0; i--) {
+      try {
+        const snapshot = JSON.parse(fs.readFileSync(this._file('snapshot', snapshots[i]), 'utf8'));
+        this._restoreSnapshot(snapshot);
+        devices = snapshot.devices || [];
+        base = snapshots[i];
+        break;
+      } catch (error) {
+        console.error('[STATE] Skipping snapshot', snapshots[i] + ':', error.message);
+      }
+    }
+
+    for (const gen of generations('wal-', '.log')) {
+      if (gen >= base) this._replay(this._file('wal', gen));
+    }
+    // Later records for the same device replace earlier ones
+    const registry = new Map();
+    for (const device of devices) registry.set(device.id, device);
+    for (const device of this.devices.values()) registry.set(device.id, device);
+    this.registry.restore(Array.from(registry.values()));
+
+    // Start a fresh generation from the loaded state
+    this.generation = Math.max(base, ...generations('wal-', '.log'), 0);
+    this._startGeneration();
+    this._writeSnapshot();
+
+    this.timer = setInterval(() => this.snapshot(), this.snapshotIntervalMs);
+    this.timer.unref();
+    this.stats.loadMs = Number(process.hrtime.bigint() - started) / 1e6;
+    console.log('[STATE] Loaded', registry.size, 'devices,', this.retained.size, 'retained,',
+                this.subscriptions.size, 'sessions in', this.stats.loadMs.toFixed(1), 'ms');
+  }
+
+  _file(kind, gen) {
+    return path.join(this.dir, kind === 'wal' ? `wal-${gen}.log` : `snapshot-${gen}.json`);
+  }
+
+  _restoreSnapshot(snapshot) {
+    if (snapshot.version !== SNAPSHOT_VERSION) throw new Error('Unknown snapshot version ' + snapshot.version);
+    for (const stored of snapshot.retained) this.retained.set(stored.topic, stored);
+    for (const [clientId, subs] of snapshot.subscriptions) this.subscriptions.set(clientId, new Map(subs));
+    for (const [clientId, will] of snapshot.wills) this.wills.set(clientId, will);
+  }
+
+  _replay(file) {
+    const lines = fs.readFileSync(file, 'utf8').split('\n');
+    for (let i = 0; i < lines.length; i++) {
+      if (lines[i].length === 0) continue;
+      let record;
+      try {
+        record = JSON.parse(lines[i]);
+      } catch (error) {
+        // Only the tail can be torn by a crash
+        console.error('[STATE] Ignoring', lines.length - i, 'unreadable log lines in', path.basename(file));
+        break;
+      }
+      this._apply(record);
+      this.stats.replayed++;
+    }
+  }
+
+  // Applies one log record to the mirrored state
+  _apply(record) {
+    switch (record.op) {
+      case 'retain':
+        if (record.packet.payload.length === 0) this.retained.delete(record.packet.topic);
+        else this.retained.set(record.packet.topic, record.packet);
+        break;
+      case 'subscribe': {
+        let subs = this.subscriptions.get(record.clientId);
+        if (!subs) {
+          subs = new Map();
+          this.subscriptions.set(record.clientId, subs);
+        }
+        for (const [topic, qos] of record.subs) subs.set(topic, qos);
+        break;
+      }
+      case 'unsubscribe': {
+        const subs = this.subscriptions.get(record.clientId);
+        if (!subs) break;
+        for (const topic of record.topics) subs.delete(topic);
+        if (subs.size === 0) this.subscriptions.delete(record.clientId);
+        break;
+      }
+      case 'clean':
+        this.subscriptions.delete(record.clientId);
+        break;
+      case 'will':
+        this.wills.set(record.clientId, record.will);
+        break;
+      case 'delwill':
+        this.wills.delete(record.clientId);
+        break;
+      case 'device':
+        this.devices.set(record.device.id, record.device);
+        break;
+    }
+  }
+
+  // ===== BROKER HOOKS =====
+
+  // Loads the mirrored state into an aedes-persistence instance and patches
+  // its mutating methods to log; returns the same instance for aedes
+  wrap(inner) {
+    const self = this;
+    const done = () => {};
+
+    for (const stored of this.retained.values()) inner.storeRetained(decodePacket(stored), done);
+    for (const [clientId, subs] of this.subscriptions) {
+      const list = Array.from(subs, ([topic, qos]) => ({ topic, qos }));
+      inner.addSubscriptions({ id: clientId }, list, done);
+    }
+    // A will belongs to the broker instance that stored it; once that
+    // instance is gone, aedes publishes it
+    const broker = inner.broker;
+    for (const [clientId, will] of this.wills) {
+      inner.broker = { id: will.brokerId };
+      inner.putWill({ id: clientId }, { ...will, payload: Buffer.from(will.payload, 'base64') }, done);
+    }
+    inner.broker = broker;
+
+    const patch = (name, log) => {
+      const original = inner[name].bind(inner);
+      inner[name] = function (...args) {
+        log(...args);
+        return original(...args);
+      };
+    };
+
+    patch('storeRetained', (packet) => {
+      if (packet.topic.startsWith('$SYS')) return;
+      self._log({ op: 'retain', packet: encodePacket(packet) });
+    });
+    patch('addSubscriptions', (client, subs) => {
+      self._log({ op: 'subscribe', clientId: client.id, subs: subs.map(sub => [sub.topic, sub.qos]) });
+    });
+    patch('removeSubscriptions', (client, topics) => {
+      self._log({ op: 'unsubscribe', clientId: client.id, topics });
+    });
+    patch('cleanSubscriptions', (client) => {
+      self._log({ op: 'clean', clientId: client.id });
+    });
+    patch('putWill', (client, packet) => {
+      const will = { ...packet, payload: Buffer.from(packet.payload || '').toString('base64') };
+      will.brokerId = inner.broker ? inner.broker.id : packet.brokerId;
+      will.clientId = client.id;
+      self._log({ op: 'will', clientId: client.id, will });
+    });
+    patch('delWill', (client) => {
+      self._log({ op: 'delwill', clientId: client.id });
+    });
+    return inner;
+  }
+
+  retainedPackets() {
+    return Array.from(this.retained.values(), decodePacket);
+  }
+
+  // New devices are logged right away; their later changes reach disk
+  // with the next snapshot
+  saveDevice(device) {
+    this._log({ op: 'device', device });
+  }
+
+  // ===== WRITE-AHEAD LOG =====
+
+  _log(record) {
+    this._apply(record);
+    this.walQueue.push(JSON.stringify(record));
+    if (this.walQueue.length === 1) setImmediate(() => this._flushLog());
+  }
+
+  // One append per event-loop turn, however many records it produced
+  _flushLog() {
+    if (this.walQueue.length === 0 || this.generation === 0) return;
+    const chunk = this.walQueue.join('\n') + '\n';
+    this.stats.walRecords += this.walQueue.length;
+    this.walQueue = [];
+    this.walBytes += Buffer.byteLength(chunk);
+    this._chainLog(() => this.walHandle && this.walHandle.appendFile(chunk));
+    if (this.walBytes > WAL_MAX_BYTES) this.snapshot();
+  }
+
+  // Log writes, opens and closes run one after another, off the event loop
+  _chainLog(step) {
+    this.walChain = this.walChain
+      .then(step)
+      .catch((error) => console.error('[STATE] Log write failed:', error.message));
+  }
+
+  // Queued records still go to the old log; later ones to the new one
+  _startGeneration() {
+    this._flushLog();
+    this.generation++;
+    this.walBytes = 0;
+    const file = this._file('wal', this.generation);
+    this._chainLog(async () => {
+      if (this.walHandle) await this.walHandle.close();
+      this.walHandle = null;
+      this.walHandle = await fs.promises.open(file, 'a');
+    });
+  }
+
+  // ===== SNAPSHOTS =====
+
+  // Switches to a new log, then writes the state as of the switch
+  snapshot() {
+    if (this.snapshotting) return this.snapshotting;
+    this._startGeneration();
+    this.snapshotting = this._writeSnapshot().then(() => { this.snapshotting = null; });
+    return this.snapshotting;
+  }
+
+  _writeSnapshot() {
+    const started = process.hrtime.bigint();
+    const gen = this.generation;
+    const json = JSON.stringify({
+      version: SNAPSHOT_VERSION,
+      generation: gen,
+      savedAt: Date.now(),
+      retained: Array.from(this.retained.values()),
+      subscriptions: Array.from(this.subscriptions, ([clientId, subs]) => [clientId, Array.from(subs)]),
+      wills: Array.from(this.wills),
+      devices: this.registry.dump()
+    });
+    this.devices.clear();
+
+    const file = this._file('snapshot', gen);
+    const temp = file + '.tmp';
+    return fs.promises.writeFile(temp, json)
+      .then(() => fs.promises.rename(temp, file))
+      // Older logs may still have appends queued; removing them first
+      // would let those appends recreate the files
+      .then(() => this.walChain)
+      .then(() => this._removeOlder(gen))
+      .then(() => {
+        this.stats.snapshots++;
+        this.stats.lastSnapshotMs = Number(process.hrtime.bigint() - started) / 1e6;
+      })
+      .catch((error) => console.error('[STATE] Snapshot failed:', error.message));
+  }
+
+  // Snapshot <gen> covers everything in earlier snapshots and logs
+  async _removeOlder(gen) {
+    const files = await fs.promises.readdir(this.dir);
+    for (const name of files) {
+      const match = /^(?:snapshot|wal)-(\d+)\.(?:json|log)$/.exec(name);
+      if (!match || parseInt(match[1], 10) >= gen) continue;
+      // A snapshot that finished alongside this one may have removed it
+      await fs.promises.unlink(path.join(this.dir, name)).catch((error) => {
+        if (error.code !== 'ENOENT') throw error;
+      });
+    }
+  }
+
+  // Final snapshot so the next start has no log to replay
+  close() {
+    clearInterval(this.timer);
+    return Promise.resolve(this.snapshotting).then(() => this.snapshot()).then(() => {
+      this._flushLog();
+      this._chainLog(async () => {
+        if (this.walHandle) await this.walHandle.close();
+        this.walHandle = null;
+      });
+      return this.walChain;
+    });
+  }
+
+  summary() {
+    return {
+      generation: this.generation,
+      retained: this.retained.size,
+      sessions: this.subscriptions.size,
+      wills: this.wills.size,
+      walBytes: this.walBytes,
+      ...this.stats
+    };
+  }
+}
+
+module.exports = { BrokerPersistence };
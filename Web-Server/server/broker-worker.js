@@ -0,0 +1,96 @@
+/**
+ * Broker Worker
+ *
+ * One MQTT ingest process in cluster mode (see cluster.js). It runs an
+ * aedes instance on the shared MQTT TCP port, so device connections are
+ * spread across broker workers, and joins the others through the message
+ * bus.
+ *
+ * Telemetry history is sharded by connection: each worker stores what its
+ * own clients publish in data/history-broker-<slot>, so the parsing,
+ * block building and disk writes run here rather than on the app worker.
+ * The app worker queries every shard over the bus and merges the results.
+ * Everything else (registry, presence, automation, the HTTP API and
+ * dashboards) lives in the app worker, which also receives this worker's
+ * client connect, disconnect and ping events.
+ */
+
+const net = require('net');
+const path = require('path');
+const createBroker = require('aedes');
+const createMemoryPersistence = require('aedes-persistence');
+const createMqemitter = require('mqemitter');
+const { BusEmitter } = require('./message-bus');
+const { TopicRouter } = require('./topic-router');
+const { HistoryStore } = require('./history-store');
+
+const MQTT_TCP_PORT = 1883;
+// Stable across restarts of this worker, so it reopens the same shard
+const SLOT = parseInt(process.env.CLUSTER_SLOT, 10) || 0;
+const HISTORY_DIR = path.join(__dirname, 'data', 'history-broker-' + SLOT);
+
+const bus = new BusEmitter(createMqemitter({ matchEmptyLevels: true }));
+const persistence = createMemoryPersistence();
+bus.replicateRetained(persistence);
+
+const aedes = createBroker({ mq: bus, persistence });
+bus.requestRetained();
+
+// The app worker decides presence; brokerId tells it which worker a
+// client is on, so a stale connection replaced elsewhere is ignored
+const forward = (event) => (client) => {
+  if (client) bus.sendEvent(event, { clientId: client.id, brokerId: aedes.id });
+};
+aedes.on('client', forward('client'));
+aedes.on('clientDisconnect', (client) => {
+  // Reconnected to this worker under the same ID: the new client counts
+  const current = aedes.clients[client.id];
+  if (!current || current === client) forward('clientDisconnect')(client);
+});
+aedes.on('ping', (packet, client) => forward('ping')(client));
+
+// Publishes of this worker's own clients; the rest of the cluster's
+// arrive over the bus and belong to other shards
+const history = new HistoryStore(HISTORY_DIR);
+const router = new TopicRouter();
+router.add('devices/+/telemetry', (message, [deviceId]) => history.ingest(deviceId, message));
+aedes.on('publish', (packet, client) => {
+  if (client) router.dispatch(packet.topic, packet, client);
+});
+
+bus.onRequest = (method, args) => {
+  switch (method) {
+    case 'history':
+      return history.query(args.deviceId, args.options);
+    case 'stats':
+      return {
+        slot: SLOT,
+        pid: process.pid,
+        clients: Object.keys(aedes.clients).length,
+        cpu: process.cpuUsage(),
+        router: { dispatched: router.dispatched, unmatched: router.unmatched },
+        history: history.stats()
+      };
+    default:
+      throw new Error('Unknown request ' + method);
+  }
+};
+
+const mqttServer = net.createServer(aedes.handle);
+mqttServer.listen(MQTT_TCP_PORT, () => {
+  console.log('[CLUSTER] Broker worker', process.pid, 'listening on port', MQTT_TCP_PORT);
+});
+
+// From the terminal and from the primary; act on the first
+let shuttingDown = false;
+process.on('SIGINT', () => {
+  if (shuttingDown) return;
+  shuttingDown = true;
+  // The listener's close callback waits for every connection to end, so
+  // aedes disconnects its clients first and the exit does not wait on it
+  aedes.close(() => {
+    mqttServer.close();
+    // Open history blocks and rollup buckets are written before exiting
+    history.close().then(() => process.exit(0));
+  });
+});
@@ -0,0 +1,69 @@
+/**
+ * Cluster Mode
+ *
+ * `npm run cluster` spreads the server over processes instead of running
+ * everything on one event loop (`npm start`):
+ *
+ *   primary          relays messages between workers (message-bus.js)
+ *   broker workers   aedes on the shared MQTT TCP port; the kernel hands
+ *                    each device connection to one of them. Each stores the
+ *                    telemetry history of its own clients (one shard each)
+ *   app worker       server.js: HTTP API, dashboard WebSocket broker and
+ *                    the telemetry handlers (registry, automation, presence,
+ *                    persistence); history queries are merged from the shards
+ *
+ * MQTT parsing, fan-out and history writes for devices therefore never
+ * share a loop with HTTP requests. CLUSTER_BROKERS sets the number of
+ * broker workers (default: one per CPU besides the app worker, at least
+ * one). A worker that dies is restarted in the same role and, for broker
+ * workers, the same slot, which names its history shard.
+ */
+
+const cluster = require('cluster');
+const os = require('os');
+
+if (cluster.isPrimary) {
+  const { BusHub } = require('./message-bus');
+  const brokerCount = parseInt(process.env.CLUSTER_BROKERS, 10) || Math.max(1, os.cpus().length - 1);
+  const hub = new BusHub();
+  const roles = new Map();          // worker.id -> { role, slot }
+  let stopping = false;
+
+  cluster.setupPrimary({ serialization: 'advanced' });
+
+  // The app worker learns the broker count to tell live shards from old ones
+  const start = (role, slot = 0) => {
+    const worker = cluster.fork({ CLUSTER_ROLE: role, CLUSTER_SLOT: slot, CLUSTER_BROKERS: brokerCount });
+    roles.set(worker.id, { role, slot });
+    hub.attach(worker, role);
+    return worker;
+  };
+
+  cluster.on('exit', (worker, code, signal) => {
+    const { role, slot } = roles.get(worker.id);
+    roles.delete(worker.id);
+    if (stopping) return;
+    console.error('[CLUSTER]', role, 'worker', worker.process.pid, 'exited (' + (signal || code) + '), restarting');
+    start(role, slot);
+  });
+
+  start('app');
+  for (let slot = 0; slot < brokerCount; slot++) start('broker', slot);
+  console.log('[CLUSTER] Primary', process.pid, 'started 1 app worker and', brokerCount, 'broker workers');
+
+  setInterval(() => console.log('[CLUSTER] Bus', JSON.stringify(hub.summary())), 60000).unref();
+
+  // Workers shut down gracefully on SIGINT; exit once they all have
+  process.on('SIGINT', () => {
+    if (stopping) return;
+    stopping = true;
+    const exit = () => { if (Object.keys(cluster.workers).length === 0) process.exit(0); };
+    cluster.on('exit', exit);
+    for (const worker of Object.values(cluster.workers)) worker.process.kill('SIGINT');
+    exit();
+  });
+} else if (process.env.CLUSTER_ROLE === 'broker') {
+  require('./broker-worker');
+} else {
+  require('./server');
+}
@@ -0,0 +1,148 @@
+/**
+ * Dashboard Flow Control
+ *
+ * Bounds what the broker buffers for each MQTT-over-WebSocket client
+ * (dashboards, browser tools). aedes asks authorizeForward() before it
+ * writes a publish to a client; for WebSocket clients forward() decides.
+ *
+ * Only topics matching a `coalesce` pattern are touched. Those carry state,
+ * where the latest message replaces every earlier one:
+ *
+ *   - While the socket has more than `queueLimitBytes` unsent, the client
+ *     is behind: publishes are held back, keeping only the latest one per
+ *     topic. A held topic that gets a newer message counts as coalesced;
+ *     a new topic beyond `maxPendingTopics` is dropped.
+ *   - Topics matching a `rateLimits` pattern are sent at most once per
+ *     interval (ms) to each client; messages in between are coalesced
+ *     the same way.
+ *
+ * Everything else (events, dashboard/devices deltas) is written
+ * immediately and in order, since coalescing would lose information,
+ * until the socket has more than `dropLimitBytes` unsent: past that it is
+ * dropped and counted. A dashboard that misses a dashboard/devices batch
+ * sees the seq gap and reloads its device list. Held messages are sent as soon as the socket has drained, checked every
+ * `flushIntervalMs`. Clients on the MQTT TCP port are never held back.
+ */
+
+const { TopicRouter } = require('./topic-router');
+
+class DashboardFlow {
+  constructor({ queueLimitBytes, dropLimitBytes = queueLimitBytes * 4, coalesce = [], maxPendingTopics = 5000,
+                rateLimits = {}, flushIntervalMs = 50 }) {
+    this.queueLimitBytes = queueLimitBytes;
+    this.dropLimitBytes = dropLimitBytes;
+    this.maxPendingTopics = maxPendingTopics;
+    this.flushIntervalMs = flushIntervalMs;
+    this.clients = new Map();        // aedes client -> { ws, pending, lastSent, timer, flushing }
+    this.coalesce = new TopicRouter();
+    for (const pattern of coalesce) this.coalesce.add(pattern, true);
+    this.rateLimits = new TopicRouter();
+    for (const [pattern, intervalMs] of Object.entries(rateLimits)) {
+      if (intervalMs > 0) this.rateLimits.add(pattern, intervalMs);
+    }
+    this.stats = { held: 0, coalesced: 0, dropped: 0, flushed: 0, passed: 0 };
+  }
+
+  attach(client, ws) {
+    this.clients.set(client, { ws, pending: new Map(), lastSent: new Map(), timer: null, flushing: false });
+  }
+
+  // Whatever is still held for a closed client is lost
+  detach(client) {
+    const state = this.clients.get(client);
+    if (!state) return;
+    clearTimeout(state.timer);
+    this.stats.dropped += state.pending.size;
+    this.clients.delete(client);
+  }
+
+  // authorizeForward hook: the packet to write now, or null to hold it
+  forward(client, packet) {
+    const state = this.clients.get(client);
+    if (!state || state.flushing) return packet;
+    if (!this.coalesce.match(packet.topic).length) {
+      if (state.ws.bufferedAmount > this.dropLimitBytes) {
+        this.stats.dropped++;
+        return null;
+      }
+      this.stats.passed++;
+      return packet;
+    }
+
+    const now = Date.now();
+    const intervalMs = this._intervalFor(packet.topic);
+    if (state.pending.has(packet.topic) ||
+        state.ws.bufferedAmount > this.queueLimitBytes ||
+        (intervalMs > 0 && now - (state.lastSent.get(packet.topic) || 0) < intervalMs)) {
+      this._hold(client, state, packet);
+      return null;
+    }
+    if (intervalMs > 0) state.lastSent.set(packet.topic, now);
+    return packet;
+  }
+
+  // Only applies to coalesced topics
+  _intervalFor(topic) {
+    if (this.rateLimits.routeCount === 0) return 0;
+    let intervalMs = 0;
+    for (const { handlers } of this.rateLimits.match(topic)) {
+      for (const ms of handlers) intervalMs = Math.max(intervalMs, ms);
+    }
+    return intervalMs;
+  }
+
+  _hold(client, state, packet) {
+    if (state.pending.has(packet.topic)) {
+      this.stats.coalesced++;
+    } else if (state.pending.size >= this.maxPendingTopics) {
+      this.stats.dropped++;
+      return;
+    } else {
+      this.stats.held++;
+    }
+    state.pending.set(packet.topic, packet);
+    if (!state.timer) state.timer = setTimeout(() => this._flush(client, state), this.flushIntervalMs);
+  }
+
+  // Sends held messages that are due, in the order their topics were held,
+  // until the socket is over its limit again
+  _flush(client, state) {
+    state.timer = null;
+    const now = Date.now();
+    for (const [topic, packet] of state.pending) {
+      if (state.ws.bufferedAmount > this.queueLimitBytes) break;
+      const intervalMs = this._intervalFor(topic);
+      if (intervalMs > 0) {
+        if (now - (state.lastSent.get(topic) || 0) < intervalMs) continue;
+        state.lastSent.set(topic, now);
+      }
+      state.pending.delete(topic);
+      // A copy without brokerId: aedes would discard it as a duplicate
+      // once a newer message from the same broker has been sent
+      state.flushing = true;
+      client.deliver0({ cmd: 'publish', topic, payload: packet.payload, qos: 0, retain: packet.retain }, () => {});
+      state.flushing = false;
+      this.stats.flushed++;
+    }
+    if (state.pending.size > 0) state.timer = setTimeout(() => this._flush(client, state), this.flushIntervalMs);
+  }
+
+  summary() {
+    let behind = 0;
+    let pending = 0;
+    for (const state of this.clients.values()) {
+      if (state.pending.size > 0) behind++;
+      pending += state.pending.size;
+    }
+    return {
+      clients: this.clients.size,
+      behind,
+      pending,
+      queueLimitBytes: this.queueLimitBytes,
+      dropLimitBytes: this.dropLimitBytes,
+      ...this.stats
+    };
+  }
+}
+
+module.exports = { DashboardFlow };
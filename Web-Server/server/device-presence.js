@@ -0,0 +1,139 @@
+/**
+ * Device Presence
+ *
+ * Tracks which devices are online. A device goes offline as soon as the
+ * broker reports its connection closed (or publishes its Last Will), or
+ * when nothing has been heard from it for `timeoutMs` (MQTT keepalive
+ * pings count).
+ *
+ * Expiry uses a hashed timer wheel: each device has one entry, in the slot
+ * of its deadline. Activity only moves the deadline forward; when the
+ * wheel reaches the slot, an entry whose deadline has passed expires and
+ * any other is re-slotted. A tick visits one slot, so the cost per second
+ * is proportional to the devices due around then, not to the fleet size.
+ *
+ * Emits 'online' (deviceId, reason) and 'offline' (deviceId, reason).
+ */
+
+const EventEmitter = require('events');
+
+class TimerWheel {
+  constructor(tickMs, slotCount) {
+    this.tickMs = tickMs;
+    this.slots = Array.from({ length: slotCount }, () => new Set());
+    this.tick = Math.floor(Date.now() / tickMs);   // Last tick processed
+    this.size = 0;
+  }
+
+  _slotFor(deadline) {
+    // Never schedule into a tick that has already been processed
+    const tick = Math.max(Math.ceil(deadline / this.tickMs), this.tick + 1);
+    return this.slots[tick % this.slots.length];
+  }
+
+  add(entry) {
+    entry.slot = this._slotFor(entry.deadline);
+    entry.slot.add(entry);
+    this.size++;
+  }
+
+  remove(entry) {
+    if (!entry.slot) return;
+    entry.slot.delete(entry);
+    entry.slot = null;
+    this.size--;
+  }
+
+  // Calls expire(entry) for each entry whose deadline is at or before now
+  advance(now, expire) {
+    const target = Math.floor(now / this.tickMs);
+    // After a long stall every slot is due; one lap covers them all
+    const first = Math.max(this.tick + 1, target - this.slots.length + 1);
+    for (let tick = first; tick <= target; tick++) {
+      const slot = this.slots[tick % this.slots.length];
+      for (const entry of slot) {
+        if (entry.deadline <= now) {
+          this.remove(entry);
+          expire(entry);
+        } else {
+          const next = this._slotFor(entry.deadline);
+          if (next !== slot) {
+            slot.delete(entry);
+            entry.slot = next;
+            next.add(entry);
+          }
+        }
+      }
+    }
+    this.tick = target;
+  }
+}
+
+class DevicePresence extends EventEmitter {
+  constructor({ timeoutMs, tickMs = 1000 }) {
+    super();
+    this.timeoutMs = timeoutMs;
+    this.entries = new Map();        // deviceId -> { deviceId, deadline, slot }
+    this.wheel = new TimerWheel(tickMs, Math.ceil(timeoutMs / tickMs) + 1);
+    this.transitions = { online: 0, offline: 0 };
+    this.timer = setInterval(() => this._expire(Date.now()), tickMs);
+    this.timer.unref();
+  }
+
+  // Starts tracking the device if needed; marks it online
+  seen(deviceId, reason, now = Date.now()) {
+    const entry = this.entries.get(deviceId);
+    if (entry) {
+      entry.deadline = now + this.timeoutMs;
+      if (!entry.slot) this._goOnline(entry, reason);
+      return;
+    }
+    const created = { deviceId, deadline: now + this.timeoutMs, slot: null };
+    this.entries.set(deviceId, created);
+    this._goOnline(created, reason);
+  }
+
+  // Activity from a client: only devices already tracked are affected
+  touch(deviceId, reason = 'activity', now = Date.now()) {
+    if (this.entries.has(deviceId)) this.seen(deviceId, reason, now);
+  }
+
+  // Disconnect or Last Will: offline now, no waiting for the timeout
+  disconnected(deviceId, reason) {
+    const entry = this.entries.get(deviceId);
+    if (!entry || !entry.slot) return;
+    this.wheel.remove(entry);
+    this._goOffline(entry, reason);
+  }
+
+  isOnline(deviceId) {
+    const entry = this.entries.get(deviceId);
+    return Boolean(entry && entry.slot);
+  }
+
+  _goOnline(entry, reason) {
+    this.wheel.add(entry);
+    this.transitions.online++;
+    this.emit('online', entry.deviceId, reason);
+  }
+
+  _goOffline(entry, reason) {
+    this.transitions.offline++;
+    this.emit('offline', entry.deviceId, reason);
+  }
+
+  _expire(now) {
+    this.wheel.advance(now, (entry) => this._goOffline(entry, 'timeout'));
+  }
+
+  stats() {
+    return {
+      tracked: this.entries.size,
+      online: this.wheel.size,
+      timeoutMs: this.timeoutMs,
+      transitions: { ...this.transitions }
+    };
+  }
+}
+
+module.exports = { DevicePresence };
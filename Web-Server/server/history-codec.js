@@ -0,0 +1,293 @@
+/**
+ * History Block Codec
+ *
+ * One block holds a run of (timestamp, value) points of a single series:
+ *
+ *   u8      format version
+ *   varint  point count
+ *   varint  first timestamp (ms)
+ *   zigzag  first delta, then delta-of-delta for every further timestamp
+ *   bits    values, XOR-compressed against the previous value (Gorilla):
+ *           '0'                       same value
+ *           '10' + meaningful bits    XOR fits the previous leading/trailing window
+ *           '11' + 5b leading + 6b length + meaningful bits
+ *
+ * Regularly spaced timestamps cost one byte per point and slowly changing
+ * readings a few bits, without any dependency beyond Buffer.
+ */
+
+const BLOCK_VERSION = 1;
+
+// Shared scratch for float64 <-> two uint32 halves (little-endian host)
+const f64 = new Float64Array(1);
+const u32 = new Uint32Array(f64.buffer);
+
+function splitDouble(value) {
+  f64[0] = value;
+  return [u32[1], u32[0]];  // [high, low]
+}
+
+function joinDouble(high, low) {
+  u32[1] = high;
+  u32[0] = low;
+  return f64[0];
+}
+
+function ctz32(x) {
+  if (x === 0) return 32;
+  return 31 - Math.clz32(x & -x);
+}
+
+// Leading/trailing zero counts of a 64-bit value given as two halves
+function clz64(high, low) {
+  return high !== 0 ? Math.clz32(high) : 32 + Math.clz32(low);
+}
+
+function ctz64(high, low) {
+  return low !== 0 ? ctz32(low) : 32 + ctz32(high);
+}
+
+// ===== BYTE / BIT WRITERS =====
+
+class BitWriter {
+  constructor(capacity = 256) {
+    this.bytes = new Uint8Array(capacity);
+    this.length = 0;      // Bytes in use, the last one possibly partial
+    this.bitPos = 8;      // Free bits left in the last byte
+  }
+
+  _ensure(extra) {
+    if (this.length + extra <= this.bytes.length) return;
+    const grown = new Uint8Array(Math.max(this.bytes.length * 2, this.length + extra));
+    grown.set(this.bytes.subarray(0, this.length));
+    this.bytes = grown;
+  }
+
+  writeByte(value) {
+    this._ensure(1);
+    this.bytes[this.length++] = value & 0xff;
+    this.bitPos = 8;
+  }
+
+  writeVarint(value) {
+    // Non-negative integers up to 2^53
+    while (value >= 0x80) {
+      this.writeByte((value % 0x80) | 0x80);
+      value = Math.floor(value / 0x80);
+    }
+    this.writeByte(value);
+  }
+
+  writeZigzag(value) {
+    this.writeVarint(value >= 0 ? value * 2 : -value * 2 - 1);
+  }
+
+  // Up to 32 bits, most significant first
+  writeBits(value, count) {
+    while (count > 0) {
+      if (this.bitPos === 8) {
+        this._ensure(1);
+        this.bytes[this.length++] = 0;
+        this.bitPos = 8;
+      }
+      const take = Math.min(count, this.bitPos);
+      const shift = count - take;
+      const chunk = (value >>> shift) & ((1 << take) - 1);
+      this.bitPos -= take;
+      this.bytes[this.length - 1] |= chunk << this.bitPos;
+      count -= take;
+      if (this.bitPos === 0) this.bitPos = 8;
+    }
+  }
+
+  // Up to 64 bits given as halves; only the low `count` bits are written
+  writeBits64(high, low, count) {
+    if (count > 32) {
+      this.writeBits(high, count - 32);
+      this.writeBits(low, 32);
+    } else {
+      this.writeBits(low, count);
+    }
+  }
+
+  toBuffer() {
+    return Buffer.from(this.bytes.buffer, this.bytes.byteOffset, this.length);
+  }
+}
+
+class BitReader {
+  constructor(buffer, offset = 0) {
+    this.bytes = buffer;
+    this.offset = offset;
+    this.bitPos = 8;    // Unread bits left in bytes[offset - 1]
+  }
+
+  readByte() {
+    this.bitPos = 8;
+    return this.bytes[this.offset++];
+  }
+
+  readVarint() {
+    let result = 0;
+    let scale = 1;
+    for (;;) {
+      const byte = this.readByte();
+      result += (byte & 0x7f) * scale;
+      if (byte < 0x80) return result;
+      scale *= 0x80;
+    }
+  }
+
+  readZigzag() {
+    const value = this.readVarint();
+    return value % 2 === 0 ? value / 2 : -(value + 1) / 2;
+  }
+
+  readBits(count) {
+    let result = 0;
+    while (count > 0) {
+      if (this.bitPos === 8) {
+        this.offset++;
+        this.bitPos = 8;
+      }
+      const current = this.bytes[this.offset - 1];
+      const take = Math.min(count, this.bitPos);
+      const shift = this.bitPos - take;
+      const chunk = (current >>> shift) & ((1 << take) - 1);
+      result = ((result << take) | chunk) >>> 0;
+      this.bitPos -= take;
+      count -= take;
+      if (this.bitPos === 0) this.bitPos = 8;
+    }
+    return result;
+  }
+
+  readBits64(count) {
+    if (count > 32) {
+      const high = this.readBits(count - 32);
+      return [high, this.readBits(32)];
+    }
+    return [0, this.readBits(count)];
+  }
+}
+
+// ===== BLOCK ENCODE / DECODE =====
+
+function encodeBlock(timestamps, values) {
+  const count = timestamps.length;
+  const writer = new BitWriter(16 + count * 3);
+  writer.writeByte(BLOCK_VERSION);
+  writer.writeVarint(count);
+  if (count === 0) return writer.toBuffer();
+
+  // Timestamps: delta-of-delta
+  writer.writeVarint(timestamps[0]);
+  let prevDelta = 0;
+  for (let i = 1; i < count; i++) {
+    const delta = timestamps[i] - timestamps[i - 1];
+    writer.writeZigzag(i === 1 ? delta : delta - prevDelta);
+    prevDelta = delta;
+  }
+
+  // Values: XOR against the previous value
+  let [prevHigh, prevLow] = splitDouble(values[0]);
+  writer.writeBits(prevHigh, 32);
+  writer.writeBits(prevLow, 32);
+  let windowLeading = -1;
+  let windowTrailing = 0;
+
+  for (let i = 1; i < count; i++) {
+    const [high, low] = splitDouble(values[i]);
+    const xorHigh = (high ^ prevHigh) >>> 0;
+    const xorLow = (low ^ prevLow) >>> 0;
+    prevHigh = high;
+    prevLow = low;
+
+    if (xorHigh === 0 && xorLow === 0) {
+      writer.writeBits(0, 1);
+      continue;
+    }
+
+    let leading = clz64(xorHigh, xorLow);
+    const trailing = ctz64(xorHigh, xorLow);
+    if (leading > 31) leading = 31;  // 5-bit field
+
+    if (windowLeading >= 0 && leading >= windowLeading && trailing >= windowTrailing) {
+      writer.writeBits(0b10, 2);
+      const bits = 64 - windowLeading - windowTrailing;
+      const [h, l] = shiftRight64(xorHigh, xorLow, windowTrailing);
+      writer.writeBits64(h, l, bits);
+    } else {
+      const bits = 64 - leading - trailing;
+      writer.writeBits(0b11, 2);
+      writer.writeBits(leading, 5);
+      writer.writeBits(bits - 1, 6);   // 1..64 stored as 0..63
+      const [h, l] = shiftRight64(xorHigh, xorLow, trailing);
+      writer.writeBits64(h, l, bits);
+      windowLeading = leading;
+      windowTrailing = trailing;
+    }
+  }
+
+  return writer.toBuffer();
+}
+
+function decodeBlock(buffer) {
+  const reader = new BitReader(buffer);
+  const version = reader.readByte();
+  if (version !== BLOCK_VERSION) throw new Error(`Unknown history block version ${version}`);
+
+  const count = reader.readVarint();
+  const timestamps = new Array(count);
+  const values = new Array(count);
+  if (count === 0) return { timestamps, values };
+
+  timestamps[0] = reader.readVarint();
+  let delta = 0;
+  for (let i = 1; i < count; i++) {
+    delta = i === 1 ? reader.readZigzag() : delta + reader.readZigzag();
+    timestamps[i] = timestamps[i - 1] + delta;
+  }
+
+  let prevHigh = reader.readBits(32);
+  let prevLow = reader.readBits(32);
+  values[0] = joinDouble(prevHigh, prevLow);
+  let windowLeading = 0;
+  let windowTrailing = 0;
+
+  for (let i = 1; i < count; i++) {
+    if (reader.readBits(1) === 0) {
+      values[i] = values[i - 1];
+      continue;
+    }
+
+    if (reader.readBits(1) === 1) {
+      windowLeading = reader.readBits(5);
+      const bits = reader.readBits(6) + 1;
+      windowTrailing = 64 - windowLeading - bits;
+    }
+
+    const bits = 64 - windowLeading - windowTrailing;
+    const [h, l] = reader.readBits64(bits);
+    const [xorHigh, xorLow] = shiftLeft64(h, l, windowTrailing);
+    prevHigh = (prevHigh ^ xorHigh) >>> 0;
+    prevLow = (prevLow ^ xorLow) >>> 0;
+    values[i] = joinDouble(prevHigh, prevLow);
+  }
+
+  return { timestamps, values };
+}
+
+function shiftRight64(high, low, n) {
+  if (n === 0) return [high, low];
+  if (n >= 32) return [0, (high >>> (n - 32)) >>> 0];
+  return [high >>> n, ((low >>> n) | (high << (32 - n))) >>> 0];
+}
+
+function shiftLeft64(high, low, n) {
+  if (n === 0) return [high, low];
+  if (n >= 32) return [(low << (n - 32)) >>> 0, 0];
+  return [((high << n) | (low >>> (32 - n))) >>> 0, (low << n) >>> 0];
+}
+
+module.exports = { encodeBlock, decodeBlock };
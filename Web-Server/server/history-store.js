@@ -0,0 +1,742 @@
+/**
+ * History Store
+ *
+ * Append-only time-series storage for device telemetry on local disk.
+ *
+ * Every numeric (or boolean) telemetry leaf is its own series, keyed by
+ * device and flattened field name ('temperature', 'pulses.0.rate', ...).
+ * A series accumulates points in an open in-memory block; a full block
+ * (or any block at flush time) is sealed, compressed with history-codec
+ * and appended to the series' daily segment:
+ *
+ *   data/history/<deviceId>/<field>/<YYYYMMDD>.seg   compressed blocks
+ *   data/history/<deviceId>/<field>/<YYYYMMDD>.idx   one record per block:
+ *                                                    t0 f64, t1 f64,
+ *                                                    offset u32, length u32,
+ *                                                    count u32
+ *
+ * Ingest only queues the message; parsing and block building run in
+ * setImmediate batches and disk writes are asynchronous, chained per
+ * series, so the broker hook never waits on either. The block index is
+ * kept in memory and a query binary-searches it and reads only the blocks
+ * overlapping the requested range.
+ *
+ * Alongside the raw points each series keeps 1 min / 1 h / 1 day rollups
+ * (min, max, sum, count, last). The current bucket of every resolution is
+ * updated in O(1) per point; a bucket is appended to its partition file
+ * once a later point closes it:
+ *
+ *   <field>/<YYYYMMDD>.1m   <field>/<YYYYMM>.1h   <field>/<YYYY>.1d
+ *
+ * with fixed 44-byte records: start, min, max, sum, last (f64), count (u32).
+ * Open buckets are only written by close(), so a crash loses at most the
+ * current bucket of each rollup; the raw points remain. Raw segments and
+ * rollup partitions older than the retention policy are deleted by prune().
+ */
+
+const fs = require('fs');
+const path = require('path');
+const { encodeBlock, decodeBlock } = require('./history-codec');
+
+const BLOCK_POINTS = 256;              // Points per sealed block
+const FLUSH_INTERVAL_MS = 60000;       // Seal partially filled blocks this often
+const INGEST_BATCH = 2000;             // Messages parsed per event-loop turn
+const INGEST_QUEUE_MAX = 100000;       // Beyond this, new messages are dropped
+const MAX_FIELDS_PER_DEVICE = 64;
+const MAX_FIELD_DEPTH = 3;
+const MAX_QUERY_POINTS = 200000;
+const INDEX_RECORD_BYTES = 28;
+const ROLLUP_RECORD_BYTES = 44;
+const PRUNE_INTERVAL_MS = 3600000;
+const DAY_MS = 86400000;
+
+// Time partitions: numeric file key for a timestamp, and [start, end) of a key
+const PARTITIONS = {
+  day: {
+    key: (t) => { const d = new Date(t); return d.getUTCFullYear() * 10000 + (d.getUTCMonth() + 1) * 100 + d.getUTCDate(); },
+    start: (k) => Date.UTC(Math.floor(k / 10000), Math.floor(k / 100) % 100 - 1, k % 100),
+    end: (k) => Date.UTC(Math.floor(k / 10000), Math.floor(k / 100) % 100 - 1, k % 100 + 1)
+  },
+  month: {
+    key: (t) => { const d = new Date(t); return d.getUTCFullYear() * 100 + d.getUTCMonth() + 1; },
+    start: (k) => Date.UTC(Math.floor(k / 100), k % 100 - 1, 1),
+    end: (k) => Date.UTC(Math.floor(k / 100), k % 100, 1)
+  },
+  year: {
+    key: (t) => new Date(t).getUTCFullYear(),
+    start: (k) => Date.UTC(k, 0, 1),
+    end: (k) => Date.UTC(k + 1, 0, 1)
+  }
+};
+
+// Finest first
+const ROLLUPS = [
+  { name: '1m', ms: 60000, partition: PARTITIONS.day },
+  { name: '1h', ms: 3600000, partition: PARTITIONS.month },
+  { name: '1d', ms: DAY_MS, partition: PARTITIONS.year }
+];
+
+// Days to keep per resolution; 0 keeps forever
+const DEFAULT_RETENTION = { raw: 7, '1m': 30, '1h': 365, '1d': 0 };
+
+const DEVICE_ID_PATTERN = /^[A-Za-z0-9_-]{1,64}$/;
+
+const dayKey = PARTITIONS.day.key;
+
+function sanitizeField(name) {
+  return name.replace(/[^A-Za-z0-9_.-]/g, '_').replace(/^\.+/, '_').slice(0, 96);
+}
+
+// Collects numeric/boolean leaves as [field, value] pairs
+function flattenTelemetry(value, prefix, depth, out) {
+  if (typeof value === 'number') {
+    if (Number.isFinite(value)) out.push([prefix, value]);
+  } else if (typeof value === 'boolean') {
+    out.push([prefix, value ? 1 : 0]);
+  } else if (value && typeof value === 'object' && depth < MAX_FIELD_DEPTH) {
+    for (const key of Object.keys(value)) {
+      flattenTelemetry(value[key], prefix ? prefix + '.' + key : key, depth + 1, out);
+    }
+  }
+  return out;
+}
+
+function mergeBucket(into, bucket) {
+  if (bucket.min < into.min) into.min = bucket.min;
+  if (bucket.max > into.max) into.max = bucket.max;
+  into.sum += bucket.sum;
+  into.count += bucket.count;
+  into.last = bucket.last;
+}
+
+class HistoryStore {
+  // options.retention: days to keep per resolution ({ raw, '1m', '1h', '1d' })
+  constructor(rootDir, options = {}) {
+    this.rootDir = rootDir;
+    this.retention = { ...DEFAULT_RETENTION, ...options.retention };
+    this.devices = new Map();      // deviceId -> Map(field -> series)
+    this.queue = [];
+    this.queueHead = 0;
+    this.drainScheduled = false;
+    this.counters = {
+      messages: 0,
+      points: 0,
+      dropped: 0,
+      invalid: 0,
+      blocksWritten: 0,
+      bucketsWritten: 0,
+      bytesWritten: 0,
+      filesPruned: 0,
+      writeErrors: 0
+    };
+
+    fs.mkdirSync(rootDir, { recursive: true });
+    this._loadIndex();
+    this.flushTimer = setInterval(() => this.flush(), FLUSH_INTERVAL_MS);
+    this.flushTimer.unref();
+    this.pruneTimer = setInterval(() => this.prune(), PRUNE_INTERVAL_MS);
+    this.pruneTimer.unref();
+  }
+
+  // ===== INGEST =====
+
+  // Called from the broker hook: O(1), no parsing
+  ingest(deviceId, message) {
+    if (!DEVICE_ID_PATTERN.test(deviceId)) return;
+    if (this.queue.length - this.queueHead >= INGEST_QUEUE_MAX) {
+      this.counters.dropped++;
+      return;
+    }
+    this.queue.push({ deviceId, message });
+    if (!this.drainScheduled) {
+      this.drainScheduled = true;
+      setImmediate(() => this._drain());
+    }
+  }
+
+  _drain() {
+    const end = Math.min(this.queue.length, this.queueHead + INGEST_BATCH);
+    for (let i = this.queueHead; i < end; i++) {
+      const { deviceId, message } = this.queue[i];
+      this.queue[i] = undefined;
+      this._append(deviceId, message);
+    }
+    this.queueHead = end;
+
+    if (this.queueHead < this.queue.length) {
+      setImmediate(() => this._drain());
+      return;
+    }
+    this.queue = [];
+    this.queueHead = 0;
+    this.drainScheduled = false;
+  }
+
+  _append(deviceId, message) {
+    // Shared with the registry: whoever reads first pays for the parse
+    const telemetry = message.json();
+    if (!telemetry || typeof telemetry !== 'object') {
+      this.counters.invalid++;
+      return;
+    }
+
+    const timestamp = message.receivedAt;
+    const leaves = flattenTelemetry(telemetry, '', 0, []);
+    for (const [name, value] of leaves) {
+      const series = this._series(deviceId, sanitizeField(name), true);
+      if (!series) continue;
+      this._appendPoint(series, timestamp, value);
+    }
+    this.counters.messages++;
+    this.counters.points += leaves.length;
+  }
+
+  _series(deviceId, field, create) {
+    let fields = this.devices.get(deviceId);
+    if (!fields) {
+      if (!create) return null;
+      fields = new Map();
+      this.devices.set(deviceId, fields);
+    }
+
+    let series = fields.get(field);
+    if (!series && create && fields.size < MAX_FIELDS_PER_DEVICE) {
+      series = {
+        field,
+        dir: path.join(this.rootDir, deviceId, field),
+        dirReady: false,
+        index: [],                       // Sealed blocks, ordered by t0
+        segmentSize: new Map(),          // day -> bytes in .seg
+        open: { day: 0, t: [], v: [] },
+        // One per ROLLUPS entry: open bucket, closed buckets not yet on
+        // disk, partition keys in order and records written per partition
+        rollups: ROLLUPS.map(() => ({ current: null, pending: [], partitions: [], records: new Map() })),
+        writeChain: Promise.resolve()
+      };
+      fields.set(field, series);
+    }
+    return series || null;
+  }
+
+  _appendPoint(series, timestamp, value) {
+    const day = dayKey(timestamp);
+    // Blocks never straddle a day so each lands in one segment file
+    if (series.open.t.length > 0 && series.open.day !== day) this._seal(series);
+
+    const open = series.open;
+    open.day = day;
+    open.t.push(timestamp);
+    open.v.push(value);
+    if (open.t.length >= BLOCK_POINTS) this._seal(series);
+
+    for (let r = 0; r < ROLLUPS.length; r++) {
+      const rollup = series.rollups[r];
+      const start = timestamp - (timestamp % ROLLUPS[r].ms);
+      let bucket = rollup.current;
+
+      // A late point (clock step) is folded into the open bucket
+      if (!bucket || start > bucket.start) {
+        if (bucket) this._closeBucket(series, r, bucket);
+        bucket = rollup.current = { start, min: value, max: value, sum: 0, count: 0, last: value };
+      }
+      if (value < bucket.min) bucket.min = value;
+      if (value > bucket.max) bucket.max = value;
+      bucket.sum += value;
+      bucket.count++;
+      bucket.last = value;
+    }
+  }
+
+  // ===== SEAL AND WRITE =====
+
+  _seal(series) {
+    const open = series.open;
+    if (open.t.length === 0) return;
+
+    const buffer = encodeBlock(open.t, open.v);
+    const day = open.day;
+    const offset = series.segmentSize.get(day) || 0;
+    series.segmentSize.set(day, offset + buffer.length);
+
+    let t1 = open.t[0];
+    for (const t of open.t) if (t > t1) t1 = t;
+
+    // The block stays readable from memory until its write completes
+    const entry = { t0: open.t[0], t1, day, offset, length: buffer.length, count: open.t.length, pending: buffer };
+    series.index.push(entry);
+    series.open = { day: 0, t: [], v: [] };
+
+    this._chain(series, () => this._writeBlock(series, entry));
+  }
+
+  _closeBucket(series, r, bucket) {
+    const rollup = series.rollups[r];
+    const key = ROLLUPS[r].partition.key(bucket.start);
+    rollup.pending.push(bucket);
+    if (rollup.partitions.length === 0 || rollup.partitions[rollup.partitions.length - 1] < key) {
+      rollup.partitions.push(key);
+    }
+    this._chain(series, () => this._writeBucket(series, r, key, bucket));
+  }
+
+  _chain(series, write) {
+    series.writeChain = series.writeChain
+      .then(write)
+      .catch((error) => {
+        this.counters.writeErrors++;
+        console.error('[HISTORY] Write failed for', series.dir + ':', error.message);
+      });
+  }
+
+  async _ensureDir(series) {
+    if (series.dirReady) return;
+    await fs.promises.mkdir(series.dir, { recursive: true });
+    series.dirReady = true;
+  }
+
+  async _writeBlock(series, entry) {
+    await this._ensureDir(series);
+
+    const record = Buffer.alloc(INDEX_RECORD_BYTES);
+    record.writeDoubleLE(entry.t0, 0);
+    record.writeDoubleLE(entry.t1, 8);
+    record.writeUInt32LE(entry.offset, 16);
+    record.writeUInt32LE(entry.length, 20);
+    record.writeUInt32LE(entry.count, 24);
+
+    // Segment first: an index record never points past the data
+    await fs.promises.appendFile(path.join(series.dir, entry.day + '.seg'), entry.pending);
+    await fs.promises.appendFile(path.join(series.dir, entry.day + '.idx'), record);
+    this.counters.blocksWritten++;
+    this.counters.bytesWritten += entry.length + INDEX_RECORD_BYTES;
+    entry.pending = null;
+  }
+
+  async _writeBucket(series, r, key, bucket) {
+    await this._ensureDir(series);
+
+    const record = Buffer.alloc(ROLLUP_RECORD_BYTES);
+    record.writeDoubleLE(bucket.start, 0);
+    record.writeDoubleLE(bucket.min, 8);
+    record.writeDoubleLE(bucket.max, 16);
+    record.writeDoubleLE(bucket.sum, 24);
+    record.writeDoubleLE(bucket.last, 32);
+    record.writeUInt32LE(bucket.count, 40);
+
+    await fs.promises.appendFile(path.join(series.dir, key + '.' + ROLLUPS[r].name), record);
+    this.counters.bucketsWritten++;
+    this.counters.bytesWritten += ROLLUP_RECORD_BYTES;
+
+    // Writes complete in order, so the oldest pending bucket is this one
+    const rollup = series.rollups[r];
+    rollup.records.set(key, (rollup.records.get(key) || 0) + 1);
+    if (rollup.pending[0] === bucket) rollup.pending.shift();
+  }
+
+  // Seals every open block; resolves once all queued writes are on disk
+  flush() {
+    this._drainAll();
+    const chains = [];
+    for (const fields of this.devices.values()) {
+      for (const series of fields.values()) {
+        this._seal(series);
+        chains.push(series.writeChain);
+      }
+    }
+    return Promise.all(chains);
+  }
+
+  // Shutdown: also writes the open rollup buckets. Queries merge a bucket
+  // written here with its continuation after the restart.
+  close() {
+    clearInterval(this.flushTimer);
+    clearInterval(this.pruneTimer);
+    this._drainAll();
+    for (const fields of this.devices.values()) {
+      for (const series of fields.values()) {
+        series.rollups.forEach((rollup, r) => {
+          if (!rollup.current) return;
+          this._closeBucket(series, r, rollup.current);
+          rollup.current = null;
+        });
+      }
+    }
+    return this.flush();
+  }
+
+  _drainAll() {
+    while (this.queueHead < this.queue.length) {
+      const { deviceId, message } = this.queue[this.queueHead];
+      this.queue[this.queueHead++] = undefined;
+      this._append(deviceId, message);
+    }
+  }
+
+  // ===== RETENTION =====
+
+  _cutoff(resolution) {
+    const days = this.retention[resolution];
+    return days > 0 ? Date.now() - days * DAY_MS : -Infinity;
+  }
+
+  // Deletes raw segments and rollup partitions that ended before their
+  // resolution's retention cutoff
+  async prune() {
+    const rawCutoff = this._cutoff('raw');
+    const doomed = [];
+
+    for (const fields of this.devices.values()) {
+      for (const series of fields.values()) {
+        // Raw: whole days, never one with a write still in flight
+        const days = new Set();
+        for (const day of series.segmentSize.keys()) {
+          if (PARTITIONS.day.end(day) <= rawCutoff) days.add(day);
+        }
+        for (const entry of series.index) {
+          if (entry.pending) days.delete(entry.day);
+        }
+        if (days.size > 0) {
+          series.index = series.index.filter(entry => !days.has(entry.day));
+          for (const day of days) {
+            series.segmentSize.delete(day);
+            doomed.push(path.join(series.dir, day + '.seg'), path.join(series.dir, day + '.idx'));
+          }
+        }
+
+        ROLLUPS.forEach((def, r) => {
+          const cutoff = this._cutoff(def.name);
+          const rollup = series.rollups[r];
+          while (rollup.partitions.length > 0 && def.partition.end(rollup.partitions[0]) <= cutoff) {
+            const key = rollup.partitions.shift();
+            rollup.records.delete(key);
+            doomed.push(path.join(series.dir, key + '.' + def.name));
+          }
+        });
+      }
+    }
+
+    for (const file of doomed) {
+      try {
+        await fs.promises.unlink(file);
+        this.counters.filesPruned++;
+      } catch (error) {
+        if (error.code !== 'ENOENT') console.error('[HISTORY] Prune failed:', error.message);
+      }
+    }
+    if (doomed.length > 0) console.log('[HISTORY] Pruned', doomed.length, 'files');
+  }
+
+  // ===== STARTUP =====
+
+  // Rebuilds the in-memory block index and rollup partition lists
+  _loadIndex() {
+    let blocks = 0;
+    for (const deviceId of fs.readdirSync(this.rootDir)) {
+      if (!DEVICE_ID_PATTERN.test(deviceId)) continue;
+      const deviceDir = path.join(this.rootDir, deviceId);
+      if (!fs.statSync(deviceDir).isDirectory()) continue;
+
+      for (const field of fs.readdirSync(deviceDir)) {
+        const series = this._series(deviceId, field, true);
+        if (!series) continue;
+        series.dirReady = true;
+        const files = fs.readdirSync(series.dir);
+
+        ROLLUPS.forEach((def, r) => {
+          const rollup = series.rollups[r];
+          rollup.partitions = files
+            .filter(name => name.endsWith('.' + def.name))
+            .map(name => parseInt(name))
+            .sort((a, b) => a - b);
+          for (const key of rollup.partitions) {
+            const file = path.join(series.dir, key + '.' + def.name);
+            const size = fs.statSync(file).size;
+            // Drop a torn last record so later appends stay aligned
+            if (size % ROLLUP_RECORD_BYTES !== 0) fs.truncateSync(file, size - (size % ROLLUP_RECORD_BYTES));
+            rollup.records.set(key, Math.floor(size / ROLLUP_RECORD_BYTES));
+          }
+        });
+
+        const days = files
+          .filter(name => name.endsWith('.idx'))
+          .map(name => parseInt(name))
+          .sort((a, b) => a - b);
+
+        for (const day of days) {
+          const idxPath = path.join(series.dir, day + '.idx');
+          const idx = fs.readFileSync(idxPath);
+          const segPath = path.join(series.dir, day + '.seg');
+          const segSize = fs.existsSync(segPath) ? fs.statSync(segPath).size : 0;
+          // Offsets continue from the real file size, covering a torn tail
+          series.segmentSize.set(day, segSize);
+
+          let pos = 0;
+          for (; pos + INDEX_RECORD_BYTES <= idx.length; pos += INDEX_RECORD_BYTES) {
+            const entry = {
+              t0: idx.readDoubleLE(pos),
+              t1: idx.readDoubleLE(pos + 8),
+              day,
+              offset: idx.readUInt32LE(pos + 16),
+              length: idx.readUInt32LE(pos + 20),
+              count: idx.readUInt32LE(pos + 24),
+              pending: null
+            };
+            if (entry.offset + entry.length > segSize) break;
+            series.index.push(entry);
+            blocks++;
+          }
+          // Drop a torn record, or one whose block never reached the
+          // segment, so later appends start on a record boundary
+          if (pos < idx.length) fs.truncateSync(idxPath, pos);
+        }
+      }
+    }
+    if (blocks > 0) console.log('[HISTORY] Loaded index:', blocks, 'blocks');
+  }
+
+  // ===== QUERY =====
+
+  fieldNames(deviceId) {
+    const fields = this.devices.get(deviceId);
+    return fields ? Array.from(fields.keys()) : [];
+  }
+
+  // Without `points` the raw data is returned. With it, the coarsest
+  // resolution giving at least that many buckets over [from, to] whose
+  // retention still covers `from`; if none does, the finest that covers it.
+  chooseResolution(from, to, points) {
+    if (!points) return 'raw';
+    const span = to - from;
+    for (let r = ROLLUPS.length - 1; r >= 0; r--) {
+      const def = ROLLUPS[r];
+      if (span / def.ms >= points && this._cutoff(def.name) <= from) return def.name;
+    }
+    if (this._cutoff('raw') <= from) return 'raw';
+    for (const def of ROLLUPS) {
+      if (this._cutoff(def.name) <= from) return def.name;
+    }
+    return ROLLUPS[ROLLUPS.length - 1].name;
+  }
+
+  // Returns { resolution, fields: { name: column }, truncated }. Raw columns
+  // are { t, v }; rollup columns are { t, min, max, mean, count, last } with
+  // t the bucket start.
+  async query(deviceId, { from, to, fields, points, resolution }) {
+    resolution = resolution || this.chooseResolution(from, to, points);
+    const r = ROLLUPS.findIndex(def => def.name === resolution);
+    if (resolution !== 'raw' && r === -1) throw new Error(`Unknown resolution ${resolution}`);
+
+    const result = { resolution, fields: {}, truncated: false };
+    const names = fields && fields.length > 0 ? fields : this.fieldNames(deviceId);
+    let budget = MAX_QUERY_POINTS;
+
+    for (const name of names) {
+      const series = this._series(deviceId, name, false);
+      if (!series) continue;
+
+      if (r === -1) {
+        const column = { t: [], v: [] };
+        result.fields[name] = column;
+        budget = await this._readSealed(series, from, to, column, budget);
+        budget = this._readPoints(series.open.t, series.open.v, from, to, column, budget);
+      } else {
+        const column = { t: [], min: [], max: [], mean: [], count: [], last: [] };
+        result.fields[name] = column;
+        budget = await this._readRollup(series, r, from, to, column, budget);
+      }
+
+      if (budget <= 0) {
+        result.truncated = true;
+        break;
+      }
+    }
+    return result;
+  }
+
+  async _readSealed(series, from, to, column, budget) {
+    const index = series.index;
+    // First block that can still contain `from`
+    let lo = 0;
+    let hi = index.length;
+    while (lo < hi) {
+      const mid = (lo + hi) >> 1;
+      if (index[mid].t1 < from) lo = mid + 1;
+      else hi = mid;
+    }
+
+    let handle = null;
+    let handleDay = 0;
+    try {
+      for (let i = lo; i < index.length && index[i].t0 <= to && budget > 0; i++) {
+        const entry = index[i];
+        let buffer = entry.pending;
+        if (!buffer) {
+          if (handleDay !== entry.day) {
+            if (handle) await handle.close();
+            handle = await fs.promises.open(path.join(series.dir, entry.day + '.seg'), 'r');
+            handleDay = entry.day;
+          }
+          buffer = Buffer.alloc(entry.length);
+          await handle.read(buffer, 0, entry.length, entry.offset);
+        }
+        const { timestamps, values } = decodeBlock(buffer);
+        budget = this._readPoints(timestamps, values, from, to, column, budget);
+      }
+    } finally {
+      if (handle) await handle.close();
+    }
+    return budget;
+  }
+
+  _readPoints(timestamps, values, from, to, column, budget) {
+    for (let i = 0; i < timestamps.length && budget > 0; i++) {
+      const t = timestamps[i];
+      if (t < from || t > to) continue;
+      column.t.push(t);
+      column.v.push(values[i]);
+      budget--;
+    }
+    return budget;
+  }
+
+  async _readRollup(series, r, from, to, column, budget) {
+    const def = ROLLUPS[r];
+    const rollup = series.rollups[r];
+    // Buckets overlapping [from, to]
+    const first = from - (from % def.ms);
+    const buckets = [];
+    const keep = (bucket) => {
+      if (bucket.start < first || bucket.start > to) return;
+      const previous = buckets[buckets.length - 1];
+      // Same bucket split across a restart
+      if (previous && previous.start === bucket.start) mergeBucket(previous, bucket);
+      else buckets.push({ ...bucket });
+    };
+
+    // Snapshot what is on disk and what is still pending at the same
+    // instant; records appended while reading are past the counted length
+    const pending = rollup.pending.slice();
+    const current = rollup.current && { ...rollup.current };
+    const reads = [];
+    for (const key of rollup.partitions) {
+      if (def.partition.end(key) <= first || def.partition.start(key) > to) continue;
+      const records = rollup.records.get(key) || 0;
+      if (records > 0) reads.push({ key, bytes: records * ROLLUP_RECORD_BYTES });
+    }
+
+    for (const { key, bytes } of reads) {
+      const data = await fs.promises.readFile(path.join(series.dir, key + '.' + def.name));
+      for (let pos = 0; pos + ROLLUP_RECORD_BYTES <= bytes; pos += ROLLUP_RECORD_BYTES) {
+        keep({
+          start: data.readDoubleLE(pos),
+          min: data.readDoubleLE(pos + 8),
+          max: data.readDoubleLE(pos + 16),
+          sum: data.readDoubleLE(pos + 24),
+          last: data.readDoubleLE(pos + 32),
+          count: data.readUInt32LE(pos + 40)
+        });
+      }
+    }
+    for (const bucket of pending) keep(bucket);
+    if (current) keep(current);
+
+    for (const bucket of buckets) {
+      if (budget <= 0) break;
+      column.t.push(bucket.start);
+      column.min.push(bucket.min);
+      column.max.push(bucket.max);
+      column.mean.push(bucket.sum / bucket.count);
+      column.count.push(bucket.count);
+      column.last.push(bucket.last);
+      budget--;
+    }
+    return budget;
+  }
+
+  stats() {
+    let series = 0;
+    let blocks = 0;
+    for (const fields of this.devices.values()) {
+      series += fields.size;
+      for (const s of fields.values()) blocks += s.index.length;
+    }
+    return {
+      devices: this.devices.size,
+      series,
+      blocks,
+      queued: this.queue.length - this.queueHead,
+      retentionDays: this.retention,
+      ...this.counters
+    };
+  }
+}
+
+// Combines query() results for one device from several stores (in cluster
+// mode each broker worker keeps its own) into a result of the same shape.
+// Raw points are ordered by time; rollup buckets with the same start are
+// combined, `last` coming from the later result in the list.
+function mergeQueryResults(results) {
+  if (results.length === 1) return results[0];
+  const resolution = results[0].resolution;
+  const merged = { resolution, fields: {}, truncated: results.some(result => result.truncated) };
+  const names = new Set();
+  for (const result of results) for (const name of Object.keys(result.fields)) names.add(name);
+
+  let budget = MAX_QUERY_POINTS;
+  for (const name of names) {
+    const columns = results.map(result => result.fields[name]).filter(Boolean);
+    const column = resolution === 'raw' ? mergeRawColumns(columns) : mergeRollupColumns(columns);
+    if (column.t.length > budget) {
+      for (const key of Object.keys(column)) column[key].length = budget;
+    }
+    merged.fields[name] = column;
+    budget -= column.t.length;
+    if (budget <= 0) {
+      merged.truncated = true;
+      break;
+    }
+  }
+  return merged;
+}
+
+function mergeRawColumns(columns) {
+  if (columns.length === 1) return columns[0];
+  const points = [];
+  for (const { t, v } of columns) {
+    for (let i = 0; i < t.length; i++) points.push([t[i], v[i]]);
+  }
+  points.sort((a, b) => a[0] - b[0]);
+  return { t: points.map(point => point[0]), v: points.map(point => point[1]) };
+}
+
+function mergeRollupColumns(columns) {
+  if (columns.length === 1) return columns[0];
+  const buckets = new Map();       // start -> bucket
+  for (const column of columns) {
+    for (let i = 0; i < column.t.length; i++) {
+      const bucket = {
+        start: column.t[i],
+        min: column.min[i],
+        max: column.max[i],
+        sum: column.mean[i] * column.count[i],
+        count: column.count[i],
+        last: column.last[i]
+      };
+      const existing = buckets.get(bucket.start);
+      if (existing) mergeBucket(existing, bucket);
+      else buckets.set(bucket.start, bucket);
+    }
+  }
+  const column = { t: [], min: [], max: [], mean: [], count: [], last: [] };
+  for (const bucket of Array.from(buckets.values()).sort((a, b) => a.start - b.start)) {
+    column.t.push(bucket.start);
+    column.min.push(bucket.min);
+    column.max.push(bucket.max);
+    column.mean.push(bucket.sum / bucket.count);
+    column.count.push(bucket.count);
+    column.last.push(bucket.last);
+  }
+  return column;
+}
+
+module.exports = { HistoryStore, ROLLUPS, mergeQueryResults };
@@ -0,0 +1,333 @@
+/**
+ * Message Bus
+ *
+ * Joins the aedes instances of a cluster (see cluster.js) over Node's IPC
+ * channel. Every worker's broker uses a BusEmitter as its `mq`: local
+ * subscribers are served by an in-process mqemitter, and each publish is
+ * also sent to the primary. The primary's BusHub keeps a topic trie of the
+ * patterns every worker listens to and forwards a publish only to workers
+ * with a matching subscription, once each, never back to its sender.
+ *
+ * Retained messages are replicated to every worker through the hub, so a
+ * client gets them from whichever worker it lands on; a broker worker that
+ * starts late asks the app worker for the current set. Client connect,
+ * disconnect and ping events from broker workers are passed to the app
+ * worker, which tracks device presence.
+ *
+ * The app worker can also ask every broker worker something (a history
+ * query, statistics): the hub sends the request to each of them and
+ * answers with all their replies at once.
+ *
+ * Messages are plain objects sent with `serialization: 'advanced'`, so
+ * payloads cross as bytes.
+ */
+
+const { TopicRouter } = require('./topic-router');
+
+const REQUEST_TIMEOUT_MS = 5000;
+
+function toBuffer(payload) {
+  if (Buffer.isBuffer(payload)) return payload;
+  if (payload instanceof Uint8Array) return Buffer.from(payload.buffer, payload.byteOffset, payload.byteLength);
+  return Buffer.from(payload || '');
+}
+
+// The fields aedes reads from a routed packet
+function wirePacket(packet) {
+  return {
+    cmd: packet.cmd || 'publish',
+    brokerId: packet.brokerId,
+    brokerCounter: packet.brokerCounter,
+    topic: packet.topic,
+    payload: toBuffer(packet.payload),
+    qos: packet.qos || 0,
+    retain: Boolean(packet.retain),
+    dup: Boolean(packet.dup)
+  };
+}
+
+function fromWire(packet) {
+  packet.payload = toBuffer(packet.payload);
+  return packet;
+}
+
+// ===== WORKER SIDE =====
+
+class BusEmitter {
+  // local: an mqemitter; channel: the worker's `process`
+  constructor(local, channel = process) {
+    this.local = local;
+    this.channel = channel;
+    this.topics = new Map();         // pattern -> local listener count
+    this.onRemotePublish = null;     // (packet) for publishes from other workers
+    this.onEvent = null;             // (event, data) client events (app worker)
+    this.onSyncRequest = null;       // () -> retained packets (app worker)
+    this.onRequest = null;           // (method, args) -> result or promise (broker workers)
+    this.requests = new Map();       // id -> { resolve, reject, timer }
+    this.nextRequestId = 1;
+    this.retainedStore = null;
+    this.stats = { sent: 0, received: 0, events: 0 };
+    channel.on('message', (message) => this._receive(message));
+  }
+
+  // ----- mqemitter interface used by aedes -----
+
+  on(topic, notify, done) {
+    const count = this.topics.get(topic) || 0;
+    this.topics.set(topic, count + 1);
+    if (count === 0) this._send({ bus: 'sub', topic });
+    return this.local.on(topic, notify, done);
+  }
+
+  removeListener(topic, notify, done) {
+    const count = this.topics.get(topic) || 0;
+    if (count <= 1) {
+      this.topics.delete(topic);
+      if (count === 1) this._send({ bus: 'unsub', topic });
+    } else {
+      this.topics.set(topic, count - 1);
+    }
+    return this.local.removeListener(topic, notify, done);
+  }
+
+  emit(packet, done) {
+    this._send({ bus: 'pub', packet: wirePacket(packet) });
+    return this.local.emit(packet, done);
+  }
+
+  close(done) {
+    this.local.close(done);
+  }
+
+  // ----- cluster extensions -----
+
+  // Interest in remote publishes without a local listener (app routes)
+  watch(pattern) {
+    if (!this.topics.has(pattern)) this._send({ bus: 'sub', topic: pattern });
+    this.topics.set(pattern, (this.topics.get(pattern) || 0) + 1);
+  }
+
+  // Patches persistence.storeRetained so retained messages stored here
+  // reach every other worker; remote ones are stored without echo
+  replicateRetained(persistence) {
+    const store = persistence.storeRetained.bind(persistence);
+    this.retainedStore = store;
+    persistence.storeRetained = (packet, done) => {
+      this._send({ bus: 'retain', packet: wirePacket(packet) });
+      return store(packet, done);
+    };
+  }
+
+  // Broker workers: ask the app worker for the retained messages so far
+  requestRetained() {
+    this._send({ bus: 'sync' });
+  }
+
+  // App worker: hand the retained messages it loaded to every worker
+  shareRetained(packets) {
+    if (packets.length > 0) this._send({ bus: 'retain', packets: packets.map(wirePacket) });
+  }
+
+  sendEvent(event, data) {
+    this._send({ bus: 'event', event, data });
+  }
+
+  // App worker: resolves with [{ result } or { error }], one per broker worker
+  request(method, args, timeoutMs = REQUEST_TIMEOUT_MS) {
+    const id = this.nextRequestId++;
+    return new Promise((resolve, reject) => {
+      const timer = setTimeout(() => {
+        this.requests.delete(id);
+        reject(new Error(`No answer to ${method} from the broker workers`));
+      }, timeoutMs);
+      this.requests.set(id, { resolve, reject, timer });
+      this._send({ bus: 'request', id, method, args });
+    });
+  }
+
+  _answer(message) {
+    const reply = (answer) => this._send({ bus: 'reply', id: message.id, ...answer });
+    if (!this.onRequest) return reply({ error: 'No request handler' });
+    Promise.resolve()
+      .then(() => this.onRequest(message.method, message.args))
+      .then((result) => reply({ result }), (error) => reply({ error: error.message }));
+  }
+
+  _send(message) {
+    if (!this.channel.send || !this.channel.connected) return;
+    this.channel.send(message);
+    this.stats.sent++;
+  }
+
+  _receive(message) {
+    if (!message || !message.bus) return;
+    this.stats.received++;
+    switch (message.bus) {
+      case 'pub': {
+        const packet = fromWire(message.packet);
+        if (this.onRemotePublish) this.onRemotePublish(packet);
+        this.local.emit(packet, () => {});
+        break;
+      }
+      case 'retain':
+        for (const packet of message.packets || [message.packet]) {
+          if (this.retainedStore) this.retainedStore(fromWire(packet), () => {});
+        }
+        break;
+      case 'event':
+        this.stats.events++;
+        if (this.onEvent) this.onEvent(message.event, message.data);
+        break;
+      case 'sync':
+        if (this.onSyncRequest) {
+          this._send({ bus: 'synced', to: message.from, packets: this.onSyncRequest().map(wirePacket) });
+        }
+        break;
+      case 'request':
+        this._answer(message);
+        break;
+      case 'replies': {
+        const request = this.requests.get(message.id);
+        if (!request) break;
+        clearTimeout(request.timer);
+        this.requests.delete(message.id);
+        request.resolve(message.replies);
+        break;
+      }
+    }
+  }
+}
+
+// ===== PRIMARY SIDE =====
+
+class BusHub {
+  constructor() {
+    this.router = new TopicRouter();
+    this.workers = new Map();        // worker.id -> { worker, role, topics: Map(pattern -> count) }
+    this.requests = new Map();       // hub request id -> { from, id, waiting: Set(worker.id), replies }
+    this.nextRequestId = 1;
+    this.stats = { published: 0, forwarded: 0, retained: 0, events: 0, requests: 0 };
+  }
+
+  attach(worker, role) {
+    const entry = { worker, role, topics: new Map() };
+    this.workers.set(worker.id, entry);
+    worker.on('message', (message) => this._receive(entry, message));
+    worker.on('exit', () => this.detach(worker));
+  }
+
+  detach(worker) {
+    const entry = this.workers.get(worker.id);
+    if (!entry) return;
+    for (const topic of entry.topics.keys()) this.router.remove(topic, entry);
+    this.workers.delete(worker.id);
+    // A worker that died mid-request answers with an error
+    for (const [id, request] of this.requests) {
+      if (request.waiting.has(worker.id)) this._reply(id, worker.id, { error: 'Worker exited' });
+    }
+  }
+
+  _receive(entry, message) {
+    if (!message || !message.bus) return;
+    switch (message.bus) {
+      case 'sub': {
+        const count = entry.topics.get(message.topic) || 0;
+        entry.topics.set(message.topic, count + 1);
+        if (count === 0) this.router.add(message.topic, entry);
+        break;
+      }
+      case 'unsub': {
+        const count = entry.topics.get(message.topic) || 0;
+        if (count > 1) {
+          entry.topics.set(message.topic, count - 1);
+        } else if (count === 1) {
+          entry.topics.delete(message.topic);
+          this.router.remove(message.topic, entry);
+        }
+        break;
+      }
+      case 'pub':
+        this._forward(entry, message);
+        break;
+      case 'retain':
+        this.stats.retained++;
+        this._broadcast(entry, message, () => true);
+        break;
+      case 'event':
+        this.stats.events++;
+        this._broadcast(entry, message, (target) => target.role === 'app');
+        break;
+      case 'sync':
+        this._broadcast(entry, { bus: 'sync', from: entry.worker.id }, (target) => target.role === 'app');
+        break;
+      case 'synced': {
+        const target = this.workers.get(message.to);
+        if (target) this._send(target, { bus: 'retain', packets: message.packets });
+        break;
+      }
+      case 'request':
+        this._request(entry, message);
+        break;
+      case 'reply':
+        this._reply(message.id, entry.worker.id, message.error !== undefined ? { error: message.error } : { result: message.result });
+        break;
+    }
+  }
+
+  // Fans a request out to every broker worker under a hub-wide id
+  _request(from, message) {
+    this.stats.requests++;
+    const id = this.nextRequestId++;
+    const targets = Array.from(this.workers.values()).filter(target => target.role === 'broker' && target.worker.isConnected());
+    const request = { from, id: message.id, waiting: new Set(targets.map(target => target.worker.id)), replies: [] };
+    if (request.waiting.size === 0) {
+      this._send(from, { bus: 'replies', id: message.id, replies: [] });
+      return;
+    }
+    this.requests.set(id, request);
+    for (const target of targets) this._send(target, { ...message, id });
+  }
+
+  _reply(id, workerId, reply) {
+    const request = this.requests.get(id);
+    if (!request || !request.waiting.delete(workerId)) return;
+    request.replies.push(reply);
+    if (request.waiting.size > 0) return;
+    this.requests.delete(id);
+    this._send(request.from, { bus: 'replies', id: request.id, replies: request.replies });
+  }
+
+  // Each worker gets a publish once, however many of its patterns match
+  _forward(from, message) {
+    this.stats.published++;
+    const matches = this.router.match(message.packet.topic);
+    if (matches.length === 0) return;
+    const targets = new Set();
+    for (const { handlers } of matches) {
+      for (const target of handlers) {
+        if (target !== from) targets.add(target);
+      }
+    }
+    for (const target of targets) this._send(target, message);
+  }
+
+  _broadcast(from, message, accept) {
+    for (const target of this.workers.values()) {
+      if (target !== from && accept(target)) this._send(target, message);
+    }
+  }
+
+  _send(target, message) {
+    if (!target.worker.isConnected()) return;
+    target.worker.send(message);
+    this.stats.forwarded++;
+  }
+
+  summary() {
+    const roles = {};
+    for (const { role } of this.workers.values()) roles[role] = (roles[role] || 0) + 1;
+    return { workers: roles, patterns: this.router.routeCount, ...this.stats };
+  }
+}
+
+module.exports = { BusEmitter, BusHub };
@@ -1,108 +1,96 @@
 /**
- * Automation Rules Engine
+ * Automation Rules
+ * Rules live on the server, which evaluates them as telemetry arrives and
+ * sends the GPIO commands itself. This module only edits and displays them.
  */
 
-const automationRules = [];
+let automationRules = [];
 let automationInterval = null;
 
+// Rules reference devices by their full MQTT IDs; the dashboard keys devices
+// by normalized ID
+function automationDevice(deviceId) {
+  return getDevice(normalizeDeviceId(deviceId));
+}
+
+async function automationRequest(method, path, body) {
+  const response = await fetch('/api/automation/rules' + path, {
+    method,
+    headers: body ? { 'Content-Type': 'application/json' } : undefined,
+    body: body ? JSON.stringify(body) : undefined
+  });
+  const data = await response.json();
+  if (!response.ok) throw new Error(data.error || `HTTP ${response.status}`);
+  return data;
+}
+
+async function loadAutomationRules() {
+  try {
+    const data = await automationRequest('GET', '');
+    automationRules = data.rules;
+    renderAutomationRules();
+    
+    const automationCountEl = document.getElementById('automationCount');
+    if (automationCountEl) automationCountEl.textContent = automationRules.length;
+  } catch (error) {
+    addEvent('error', 'Failed to load automation rules', { error: error.message });
+  }
+}
+
+// Refreshes rule state (active badges) while the dashboard is open
 function startAutomationEngine() {
   if (automationInterval) clearInterval(automationInterval);
   
-  automationInterval = setInterval(checkAutomationRules, 2000);
-  addEvent('info', 'Automation engine started');
+  loadAutomationRules();
+  automationInterval = setInterval(loadAutomationRules, 5000);
 }
 
 function stopAutomationEngine() {
   if (automationInterval) {
     clearInterval(automationInterval);
     automationInterval = null;
-    addEvent('info', 'Automation engine stopped');
   }
 }
 
-function checkAutomationRules() {
-  const enabledRules = automationRules.filter(rule => rule.enabled);
-  
-  enabledRules.forEach(rule => {
-    const device = getDevice(rule.condition.deviceId);
-    
-    if (!device || !device.online) return;
-    
-    const conditionMet = evaluateCondition(rule.condition, device);
-    const previousState = rule.lastState || false;
-    rule.lastState = conditionMet;
-    
-    if (conditionMet && !previousState) {
-      executeAutomationAction(rule);
-    }
-    
-    if (!conditionMet && previousState && rule.autoToggle) {
-      const offAction = { ...rule.action, state: 0 };
-      executeAction(offAction);
-      addEvent('info', `Auto-toggle OFF: ${rule.name}`);
-    }
+// Published by the server on automation/events when a rule fires
+function handleAutomationEvent(event) {
+  const offAction = event.action.state === 0;
+  addEvent('success', `Automation${offAction ? ' (auto-toggle OFF)' : ''}: ${event.name}`, {
+    action: event.action,
+    latencyMs: event.latencyMs
   });
 }
 
-function evaluateCondition(condition, device) {
-  const telemetry = device.telemetry || {};
-  const value = telemetry[condition.parameter];
-  
-  if (value === undefined) return false;
-  
-  const threshold = parseFloat(condition.threshold);
-  
-  switch (condition.operator) {
-    case '>': return value > threshold;
-    case '<': return value < threshold;
-    case '>=': return value >= threshold;
-    case '<=': return value <= threshold;
-    case '==': return Math.abs(value - threshold) < 0.01;
-    default: return false;
+async function addAutomationRule(rule) {
+  try {
+    await automationRequest('POST', '', rule);
+    addEvent('success', 'Automation rule added', rule);
+    loadAutomationRules();
+  } catch (error) {
+    addEvent('error', 'Failed to add automation rule', { error: error.message });
   }
 }
 
-function executeAutomationAction(rule) {
-  executeAction(rule.action);
-  addEvent('success', `Automation: ${rule.name}`, {
-    condition: rule.condition,
-    action: rule.action
-  });
-}
-
-function executeAction(action) {
-  const targetDevice = getDevice(action.deviceId);
-  
-  if (!targetDevice || !targetDevice.online) return;
-  
-  controlGPIO(action.deviceId, action.gpio, action.state);
-}
-
-function addAutomationRule(rule) {
-  rule.id = Date.now() + Math.random();
-  rule.enabled = true;
-  rule.lastState = false;
-  automationRules.push(rule);
-  
-  renderAutomationRules();
-  addEvent('success', 'Automation rule added', rule);
-}
-
-function removeAutomationRule(ruleId) {
-  const index = automationRules.findIndex(r => r.id === ruleId);
-  if (index !== -1) {
-    automationRules.splice(index, 1);
-    renderAutomationRules();
+async function removeAutomationRule(ruleId) {
+  try {
+    await automationRequest('DELETE', '/' + encodeURIComponent(ruleId));
     addEvent('info', 'Automation rule removed');
+    loadAutomationRules();
+  } catch (error) {
+    addEvent('error', 'Failed to remove automation rule', { error: error.message });
   }
 }
 
-function toggleAutomationRule(ruleId) {
+async function toggleAutomationRule(ruleId) {
   const rule = automationRules.find(r => r.id === ruleId);
-  if (rule) {
-    rule.enabled = !rule.enabled;
-    renderAutomationRules();
-    addEvent('info', `Automation ${rule.enabled ? 'enabled' : 'disabled'}: ${rule.name}`);
+  if (!rule) return;
+  
+  try {
+    const updated = await automationRequest('PUT', '/' + encodeURIComponent(ruleId), { enabled: !rule.enabled });
+    addEvent('info', `Automation ${updated.enabled ? 'enabled' : 'disabled'}: ${updated.name}`);
+    loadAutomationRules();
+  } catch (error) {
+    addEvent('error', 'Failed to update automation rule', { error: error.message });
   }
 }
 
@@ -116,14 +104,9 @@ function renderAutomationRules() {
   }
   
   container.innerHTML = automationRules.map(rule => {
-    const condDevice = getDevice(rule.condition.deviceId);
-    const actionDevice = getDevice(rule.action.deviceId);
-    
-    const condDeviceName = condDevice ? condDevice.name : rule.condition.deviceId;
+    const actionDevice = automationDevice(rule.action.deviceId);
     const actionDeviceName = actionDevice ? actionDevice.name : rule.action.deviceId;
     
-    const paramName = getParameterName(rule.condition.parameter);
-    
     return `
       <div class="card" style="margin-bottom: 1rem;">
         <div class="flex-between mb-sm">
@@ -131,19 +114,19 @@ function renderAutomationRules() {
           <div class="flex gap-sm">
             <label class="toggle-switch">
               <input type="checkbox" ${rule.enabled ? 'checked' : ''} 
-                     onchange="toggleAutomationRule(${rule.id})">
+                     onchange="toggleAutomationRule('${rule.id}')">
               <span class="toggle-slider"></span>
             </label>
-            <button class="btn btn-secondary btn-sm" onclick="editAutomationRule(${rule.id})">
+            <button class="btn btn-secondary btn-sm" onclick="editAutomationRule('${rule.id}')">
               ✏️ Edit
             </button>
-            <button class="btn btn-danger btn-sm" onclick="removeAutomationRule(${rule.id})">
+            <button class="btn btn-danger btn-sm" onclick="removeAutomationRule('${rule.id}')">
               🗑️ Delete
             </button>
           </div>
         </div>
         <div style="color: var(--text-secondary); font-size: 0.875rem;">
-          <strong>IF</strong> ${condDeviceName} ${paramName} ${rule.condition.operator} ${rule.condition.threshold}<br>
+          <strong>IF</strong> ${describeCondition(rule.condition)}<br>
           <strong>THEN</strong> ${actionDeviceName} GPIO${rule.action.gpio} = ${rule.action.state ? 'ON' : 'OFF'}
           ${rule.autoToggle ? ' <span class="badge badge-info" style="margin-left: 0.5rem;">Auto-toggle</span>' : ''}
         </div>
@@ -153,6 +136,33 @@ function renderAutomationRules() {
   }).join('');
 }
 
+function automationDeviceName(deviceId) {
+  const device = automationDevice(deviceId);
+  return device ? device.name : deviceId;
+}
+
+// Human-readable form of a (possibly compound) condition tree
+function describeCondition(condition) {
+  let text;
+  if (condition.all || condition.any) {
+    const parts = (condition.all || condition.any).map(describeCondition);
+    text = '(' + parts.join(condition.all ? ' AND ' : ' OR ') + ')';
+  } else {
+    let subject = `${automationDeviceName(condition.deviceId)} ${getParameterName(condition.parameter)}`;
+    if (condition.aggregate) {
+      subject = `${condition.aggregate}(${subject}, ${formatWindow(condition.windowSeconds)})`;
+    }
+    text = `${subject} ${condition.operator} ${condition.threshold}`;
+    if (condition.hysteresis) text += ` ±${condition.hysteresis}`;
+  }
+  if (condition.forSeconds) text += ` for ${condition.forSeconds}s`;
+  return text;
+}
+
+function formatWindow(seconds) {
+  return seconds >= 60 ? `${seconds / 60} min` : `${seconds} s`;
+}
+
 function getParameterName(param) {
   const names = {
     tC: 'Temperature',
@@ -180,21 +190,53 @@ function saveAutomationRule() {
     return;
   }
   
+  // The server matches rules against the IDs devices publish under
+  const condDevice = getDevice(condDeviceId);
+  const actionDevice = getDevice(actionDeviceId);
+  
+  const condition = {
+    deviceId: condDevice ? condDevice.originalId : condDeviceId,
+    parameter,
+    operator,
+    threshold: parseFloat(threshold)
+  };
+  
+  // Optional smoothing; empty fields are left out
+  const aggregate = document.getElementById('conditionAggregate')?.value;
+  const windowMinutes = parseFloat(document.getElementById('conditionWindow')?.value);
+  const hysteresis = parseFloat(document.getElementById('conditionHysteresis')?.value);
+  const forSeconds = parseFloat(document.getElementById('conditionForSeconds')?.value);
+  if (aggregate) {
+    if (!(windowMinutes > 0)) {
+      addEvent('error', 'Set a window length for the average/maximum/minimum');
+      return;
+    }
+    condition.aggregate = aggregate;
+    condition.windowSeconds = windowMinutes * 60;
+  }
+  if (hysteresis > 0) condition.hysteresis = hysteresis;
+  if (forSeconds > 0) condition.forSeconds = forSeconds;
+  
   const rule = {
     name,
-    condition: { deviceId: condDeviceId, parameter, operator, threshold: parseFloat(threshold) },
-    action: { deviceId: actionDeviceId, gpio: parseInt(gpio), state: parseInt(state) },
+    condition,
+    action: {
+      deviceId: actionDevice ? actionDevice.originalId : actionDeviceId,
+      gpio: parseInt(gpio),
+      state: parseInt(state)
+    },
     autoToggle
   };
   
   // Check if editing existing rule
   const editingRuleId = document.getElementById('automationForm').dataset.editingId;
   if (editingRuleId) {
-    const existingRule = automationRules.find(r => r.id == editingRuleId);
-    if (existingRule) {
-      Object.assign(existingRule, rule);
-      addEvent('success', 'Automation rule updated', rule);
-    }
+    automationRequest('PUT', '/' + encodeURIComponent(editingRuleId), rule)
+      .then(() => {
+        addEvent('success', 'Automation rule updated', rule);
+        loadAutomationRules();
+      })
+      .catch(error => addEvent('error', 'Failed to update automation rule', { error: error.message }));
     delete document.getElementById('automationForm').dataset.editingId;
   } else {
     addAutomationRule(rule);
@@ -202,20 +244,29 @@ function saveAutomationRule() {
   
   closeModal('automationModal');
   document.getElementById('automationForm').reset();
-  renderAutomationRules();
 }
 
 function editAutomationRule(ruleId) {
   const rule = automationRules.find(r => r.id === ruleId);
   if (!rule) return;
   
+  // The form holds a single comparison; compound rules are edited via the API
+  if (rule.condition.all || rule.condition.any) {
+    addEvent('warning', `"${rule.name}" has a compound condition; edit it through /api/automation/rules`);
+    return;
+  }
+  
   // Populate form
   document.getElementById('ruleName').value = rule.name;
-  document.getElementById('conditionDevice').value = rule.condition.deviceId;
+  document.getElementById('conditionDevice').value = normalizeDeviceId(rule.condition.deviceId);
   document.getElementById('conditionParameter').value = rule.condition.parameter;
   document.getElementById('conditionOperator').value = rule.condition.operator;
   document.getElementById('conditionThreshold').value = rule.condition.threshold;
-  document.getElementById('actionDevice').value = rule.action.deviceId;
+  document.getElementById('conditionAggregate').value = rule.condition.aggregate || '';
+  document.getElementById('conditionWindow').value = rule.condition.windowSeconds ? rule.condition.windowSeconds / 60 : '';
+  document.getElementById('conditionHysteresis').value = rule.condition.hysteresis || '';
+  document.getElementById('conditionForSeconds').value = rule.condition.forSeconds || '';
+  document.getElementById('actionDevice').value = normalizeDeviceId(rule.action.deviceId);
   document.getElementById('actionGpio').value = rule.action.gpio;
   document.getElementById('actionState').value = rule.action.state;
   document.getElementById('autoToggle').checked = rule.autoToggle;
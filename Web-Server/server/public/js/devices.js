@@ -1,10 +1,13 @@
 /**
  * Device Management Module
  * Updated to support 8 GPIO pins per actuator device
+ *
+ * Device state comes from the server: a /api/devices snapshot, then
+ * per-device deltas pushed on dashboard/devices. Nothing polls; the page
+ * redraws at most once per animation frame, and only what changed.
  */
 
 const devices = new Map();
-const DEVICE_TIMEOUT = 60000;
 
 // Normalize device ID to prevent duplicates from different formats
 function normalizeDeviceId(deviceId) {
@@ -20,36 +23,139 @@ function normalizeDeviceId(deviceId) {
   return `${type}-${suffix}`;
 }
 
-function handleDeviceMessage(deviceId, telemetry) {
-  // Normalize device ID to prevent duplicates
-  const normalizedId = normalizeDeviceId(deviceId);
+// Large fleets switch the Devices page from cards to a virtualized list
+const VIRTUAL_LIST_THRESHOLD = 200;
+const VIRTUAL_ROW_HEIGHT = 56;
+const VIRTUAL_OVERSCAN = 8;
+
+// Server pushes arrive as numbered batches on dashboard/devices; a gap means
+// a batch was lost and the /api/devices snapshot is reloaded
+let dashboardSeq = null;
+let snapshotLoading = false;
+let pendingBatches = [];
+
+// Changes are collected and drawn once per animation frame
+const dirtyDevices = new Set();
+let renderScheduled = false;
+let gridStructureChanged = true;
+
+// Rendered state of the Devices page
+let gridMode = null;                 // 'cards' | 'virtual'
+const cardElements = new Map();      // id -> { element, html }
+let virtualOrder = [];
+let virtualScrollScheduled = false;
+
+function loadDeviceSnapshot() {
+  if (snapshotLoading) return;
+  snapshotLoading = true;
+  dashboardSeq = null;
+  
+  fetch('/api/devices')
+    .then(res => res.json())
+    .then(data => {
+      const known = devices.size;
+      data.devices.forEach(record => applyDeviceRecord(record, true));
+      if (devices.size > known) {
+        addEvent('info', `Loaded ${devices.size - known} devices from server`, { total: devices.size });
+      }
+      
+      dashboardSeq = data.seq;
+      snapshotLoading = false;
+      const batches = pendingBatches;
+      pendingBatches = [];
+      batches.forEach(handleDashboardUpdate);
+      scheduleDeviceRender();
+    })
+    .catch(error => {
+      snapshotLoading = false;
+      addEvent('error', 'Failed to load devices', { error: error.message });
+    });
+}
+
+function handleDashboardUpdate(batch) {
+  if (dashboardSeq === null) {
+    pendingBatches.push(batch);
+    return;
+  }
+  if (batch.seq <= dashboardSeq) return;  // Already in the snapshot
+  if (batch.seq !== dashboardSeq + 1) {
+    addEvent('warning', 'Missed device updates, reloading', { expected: dashboardSeq + 1, received: batch.seq });
+    pendingBatches.push(batch);
+    loadDeviceSnapshot();
+    return;
+  }
+  
+  dashboardSeq = batch.seq;
+  batch.devices.forEach(record => applyDeviceRecord(record, false));
+}
+
+// Server records carry the full device; they are idempotent
+function applyDeviceRecord(record, quiet) {
+  const normalizedId = normalizeDeviceId(record.id);
   
   if (!devices.has(normalizedId)) {
-    registerNewDevice(deviceId, normalizedId, telemetry);
-  } else {
-    // Update existing device - make sure originalId is preserved
-    const device = devices.get(normalizedId);
-    if (!device.originalId) {
-      device.originalId = deviceId;
-    }
+    registerNewDevice(record.id, normalizedId, record.telemetry, quiet);
   }
   
   const device = devices.get(normalizedId);
-  device.telemetry = telemetry || {};
-  device.lastSeen = Date.now();
-  device.online = true;
+  device.originalId = record.id;
+  device.telemetry = record.telemetry || {};
+  device.firstSeen = record.firstSeen;
+  device.lastSeen = record.lastSeen;
+  device.online = record.online;
+  device.presence = record.presence;
+  markDeviceDirty(normalizedId);
+}
+
+// Retained status ({"online": true, ip, rssi, ...}), or the device's Last
+// Will ({"online": false}). It may be old, so online comes from the server.
+function handleDeviceStatus(deviceId, status) {
+  const normalizedId = normalizeDeviceId(deviceId);
   
-  updateDashboard();
+  if (!devices.has(normalizedId)) {
+    registerNewDevice(deviceId, normalizedId, {});
+    devices.get(normalizedId).online = false;
+  }
   
-  if (telemetry && telemetry.tC !== undefined) {
-    addEvent('info', `Telemetry: ${device.name}`, {
-      temp: `${telemetry.tC}°C`,
-      humidity: `${telemetry.rh}%`
-    });
+  devices.get(normalizedId).status = status;
+  markDeviceDirty(normalizedId);
+}
+
+// Online/offline transitions decided by the server
+function handleDevicePresence(event) {
+  const device = devices.get(normalizeDeviceId(event.deviceId));
+  const name = device ? device.name : event.deviceId;
+  const reasons = {
+    timeout: 'keepalive expired',
+    disconnect: 'connection closed',
+    will: 'last will',
+    connect: 'reconnected'
+  };
+  addEvent(event.online ? 'success' : 'warning',
+           `Device ${event.online ? 'online' : 'offline'}: ${name}`,
+           { reason: reasons[event.reason] || event.reason });
+}
+
+// Actuator output state (retained, published after every applied command)
+function handleDeviceState(deviceId, state) {
+  const normalizedId = normalizeDeviceId(deviceId);
+  
+  if (!devices.has(normalizedId)) {
+    registerNewDevice(deviceId, normalizedId, {});
+  }
+  
+  const device = devices.get(normalizedId);
+  device.gpioStates = {};
+  for (let gpio = 1; gpio <= 8; gpio++) {
+    device.gpioStates[gpio] = (state.mask & (1 << (gpio - 1))) !== 0;
   }
+  device.stateSeq = state.seq;
+  
+  // Retained state may be old, so it does not count as the device being seen
+  markDeviceDirty(normalizedId);
 }
 
-function registerNewDevice(originalId, normalizedId, telemetry) {
+function registerNewDevice(originalId, normalizedId, telemetry, quiet = false) {
   // Improved device type detection
   const idLower = originalId.toLowerCase();
   const deviceType = idLower.includes('actuator') ? 'actuator' : 'sensor';
@@ -66,34 +172,60 @@ function registerNewDevice(originalId, normalizedId, telemetry) {
   };
   
   devices.set(normalizedId, device);
-  addEvent('success', `New ${deviceType} connected: ${originalId}`, { type: deviceType });
+  gridStructureChanged = true;
+  if (!quiet) addEvent('success', `New ${deviceType} connected: ${originalId}`, { type: deviceType });
 }
 
-function updateDashboard() {
-  const now = Date.now();
+function markDeviceDirty(normalizedId) {
+  dirtyDevices.add(normalizedId);
+  scheduleDeviceRender();
+}
+
+function scheduleDeviceRender() {
+  if (renderScheduled) return;
+  renderScheduled = true;
+  requestAnimationFrame(flushDeviceUpdates);
+}
+
+function flushDeviceUpdates() {
+  renderScheduled = false;
+  updateStats();
   
-  devices.forEach(device => {
-    if (now - device.lastSeen > DEVICE_TIMEOUT) {
-      device.online = false;
-    }
-  });
+  // A hidden Devices page is rebuilt when its tab is opened
+  const page = document.getElementById('devicesPage');
+  if (page && page.classList.contains('active')) {
+    patchDeviceGrid();
+  } else {
+    gridStructureChanged = true;
+  }
+  dirtyDevices.clear();
   
+  if (typeof updateDashboardGrid === 'function') updateDashboardGrid();
+}
+
+// Full redraw (tab switch, manual refresh)
+function updateDashboard() {
   updateStats();
   renderDeviceGrid();
+  dirtyDevices.clear();
 }
 
 function updateStats() {
-  const totalDevices = devices.size;
-  const onlineDevices = Array.from(devices.values()).filter(d => d.online).length;
-  const sensors = Array.from(devices.values()).filter(d => d.type === 'sensor').length;
-  const actuators = Array.from(devices.values()).filter(d => d.type === 'actuator').length;
+  let onlineDevices = 0;
+  let sensors = 0;
+  let actuators = 0;
+  devices.forEach(device => {
+    if (device.online) onlineDevices++;
+    if (device.type === 'sensor') sensors++;
+    else if (device.type === 'actuator') actuators++;
+  });
   
   const totalEl = document.getElementById('totalDevices');
   const onlineEl = document.getElementById('onlineDevices');
   const sensorsEl = document.getElementById('sensorCount');
   const actuatorsEl = document.getElementById('actuatorCount');
   
-  if (totalEl) totalEl.textContent = totalDevices;
+  if (totalEl) totalEl.textContent = devices.size;
   if (onlineEl) onlineEl.textContent = onlineDevices;
   if (sensorsEl) sensorsEl.textContent = sensors;
   if (actuatorsEl) actuatorsEl.textContent = actuators;
@@ -103,20 +235,64 @@ function renderDeviceGrid() {
   const grid = document.getElementById('deviceGrid');
   if (!grid) return;
   
-  const deviceArray = Array.from(devices.values());
+  gridStructureChanged = false;
+  cardElements.clear();
   
-  if (deviceArray.length === 0) {
+  if (devices.size === 0) {
+    gridMode = null;
     grid.innerHTML = '<div class="text-center text-muted" style="grid-column: 1/-1; padding: 3rem;">No devices connected</div>';
     return;
   }
   
-  grid.innerHTML = deviceArray.map(device => {
-    const isOnline = device.online;
-    const telemetry = device.telemetry || {};
+  if (devices.size > VIRTUAL_LIST_THRESHOLD) {
+    gridMode = 'virtual';
+    renderVirtualList(grid);
+    return;
+  }
+  
+  gridMode = 'cards';
+  const deviceArray = Array.from(devices.values());
+  const bodies = deviceArray.map(deviceCardBody);
+  grid.innerHTML = deviceArray.map((device, i) => {
     const cardClass = device.type === 'actuator' ? 'device-card device-card-wide' : 'device-card';
-    
-    return `
-      <div class="${cardClass}">
+    return `<div class="${cardClass}">${bodies[i]}</div>`;
+  }).join('');
+  
+  Array.from(grid.children).forEach((element, i) => {
+    cardElements.set(deviceArray[i].id, { element, html: bodies[i] });
+  });
+}
+
+// Redraws only what changed since the last frame
+function patchDeviceGrid() {
+  const wantVirtual = devices.size > VIRTUAL_LIST_THRESHOLD;
+  if (gridStructureChanged || gridMode !== (wantVirtual ? 'virtual' : 'cards')) {
+    renderDeviceGrid();
+    return;
+  }
+  
+  if (gridMode === 'virtual') {
+    renderVirtualRows();
+    return;
+  }
+  
+  dirtyDevices.forEach(id => {
+    const card = cardElements.get(id);
+    const device = devices.get(id);
+    if (!card || !device) return;
+    const html = deviceCardBody(device);
+    if (html !== card.html) {
+      card.element.innerHTML = html;
+      card.html = html;
+    }
+  });
+}
+
+function deviceCardBody(device) {
+  const isOnline = device.online;
+  const telemetry = device.telemetry || {};
+  
+  return `
         <div class="device-header">
           <div class="device-info">
             <h3>${device.name}</h3>
@@ -145,7 +321,6 @@ function renderDeviceGrid() {
         ${device.type === 'actuator' ? `
           <div class="gpio-grid">
             ${[1, 2, 3, 4, 5, 6, 7, 8].map(gpio => {
-              const pinMap = {1:5, 2:6, 3:7, 4:8, 5:9, 6:10, 7:21, 8:38};
               const boardLabel = `D${gpio + 1}`;
               const isOn = device.gpioStates && device.gpioStates[gpio];
               
@@ -167,9 +342,70 @@ function renderDeviceGrid() {
           <span>Heap: ${telemetry.heap !== undefined ? formatBytes(telemetry.heap) : 'N/A'}</span>
           <span>Updated: ${isOnline ? 'just now' : new Date(device.lastSeen).toLocaleTimeString()}</span>
         </div>
+  `;
+}
+
+// ===== VIRTUALIZED LIST =====
+
+// Fixed-height rows inside a scrolling viewport; only the rows in view
+// (plus overscan) exist in the DOM
+function renderVirtualList(grid) {
+  virtualOrder = Array.from(devices.keys());
+  grid.innerHTML = `
+    <div class="virtual-list" id="deviceVirtualList">
+      <div class="virtual-list-spacer" style="height: ${virtualOrder.length * VIRTUAL_ROW_HEIGHT}px;">
+        <div class="virtual-list-rows" id="deviceVirtualRows"></div>
       </div>
-    `;
-  }).join('');
+    </div>
+  `;
+  document.getElementById('deviceVirtualList').addEventListener('scroll', onVirtualListScroll, { passive: true });
+  renderVirtualRows();
+}
+
+function onVirtualListScroll() {
+  if (virtualScrollScheduled) return;
+  virtualScrollScheduled = true;
+  requestAnimationFrame(() => {
+    virtualScrollScheduled = false;
+    renderVirtualRows();
+  });
+}
+
+function renderVirtualRows() {
+  const viewport = document.getElementById('deviceVirtualList');
+  const rows = document.getElementById('deviceVirtualRows');
+  if (!viewport || !rows) return;
+  
+  const first = Math.max(0, Math.floor(viewport.scrollTop / VIRTUAL_ROW_HEIGHT) - VIRTUAL_OVERSCAN);
+  const last = Math.min(virtualOrder.length,
+                        Math.ceil((viewport.scrollTop + viewport.clientHeight) / VIRTUAL_ROW_HEIGHT) + VIRTUAL_OVERSCAN);
+  
+  rows.style.transform = `translateY(${first * VIRTUAL_ROW_HEIGHT}px)`;
+  rows.innerHTML = virtualOrder.slice(first, last).map(id => deviceRowHtml(devices.get(id))).join('');
+}
+
+function deviceRowHtml(device) {
+  const telemetry = device.telemetry || {};
+  let summary = '';
+  if (device.type === 'sensor' && telemetry.tC !== undefined) {
+    summary = `🌡️ ${parseFloat(telemetry.tC).toFixed(1)}°C &nbsp; 💧 ${parseFloat(telemetry.rh).toFixed(1)}%`;
+  } else if (device.type === 'actuator') {
+    const on = [1, 2, 3, 4, 5, 6, 7, 8].filter(gpio => device.gpioStates && device.gpioStates[gpio]);
+    summary = `<button class="btn btn-secondary btn-sm" onclick="openGPIOModal('${device.id}')">🎛️ GPIO</button>
+               <span class="text-muted">${on.length ? 'On: ' + on.map(gpio => `D${gpio + 1}`).join(' ') : 'All off'}</span>`;
+  }
+  
+  return `
+    <div class="virtual-row" style="height: ${VIRTUAL_ROW_HEIGHT}px;">
+      <span class="virtual-row-name">${device.name}</span>
+      <span class="device-type-badge">${device.type}</span>
+      <span class="virtual-row-summary">${summary}</span>
+      <span class="virtual-row-heap text-muted">${telemetry.heap !== undefined ? formatBytes(telemetry.heap) : ''}</span>
+      <span class="badge ${device.online ? 'badge-success' : 'badge-danger'}">
+        ${device.online ? '● Online' : '● Offline'}
+      </span>
+    </div>
+  `;
 }
 
 function controlGPIO(normalizedId, gpio, state) {
@@ -199,7 +435,7 @@ function controlGPIO(normalizedId, gpio, state) {
   
   if (publishMQTT(topic, payload)) {
     addEvent('success', `GPIO ${gpio} → ${state ? 'ON' : 'OFF'} on ${device.name}`);
-    updateDashboard();
+    markDeviceDirty(normalizedId);
   }
 }
 
@@ -226,5 +462,3 @@ function getDevice(deviceId) {
 function getDevicesByType(type) {
   return Array.from(devices.values()).filter(d => d.type === type);
 }
-
-setInterval(updateDashboard, 1000);
@@ -4,6 +4,7 @@
 
 const MAX_EVENTS = 100;
 const events = [];
+let eventLogScheduled = false;
 
 function addEvent(type, message, data = null) {
   const event = {
@@ -20,10 +21,20 @@ function addEvent(type, message, data = null) {
     events.pop();
   }
   
-  updateEventLog();
+  scheduleEventLogUpdate();
   console.log(`[${type.toUpperCase()}]`, message, data || '');
 }
 
+// Bursts of events redraw the log once per frame
+function scheduleEventLogUpdate() {
+  if (eventLogScheduled) return;
+  eventLogScheduled = true;
+  requestAnimationFrame(() => {
+    eventLogScheduled = false;
+    updateEventLog();
+  });
+}
+
 function updateEventLog() {
   const eventLog = document.getElementById('eventLog');
   if (!eventLog) return;
@@ -39,11 +39,16 @@ function onMQTTConnect() {
   
   updateMQTTStatus('connected');
   
+  // Telemetry arrives as batched device updates pushed by the server;
+  // the snapshot is loaded once the subscription is in place
+  mqttClient.subscribe('dashboard/devices', () => loadDeviceSnapshot());
   mqttClient.subscribe('devices/+/status');
-  mqttClient.subscribe('devices/+/telemetry');
+  mqttClient.subscribe('devices/+/state');
   mqttClient.subscribe('devices/+/diagnostics');
   mqttClient.subscribe('device/+/status');
   mqttClient.subscribe('gestures/detected');
+  mqttClient.subscribe('automation/events');
+  mqttClient.subscribe('presence/events');
   
   addEvent('info', 'Subscribed to device topics');
 }
@@ -52,17 +57,19 @@ function onMQTTMessage(topic, message) {
   try {
     const payload = message.toString();
     
-    if (topic.includes('/telemetry')) {
+    if (topic === 'dashboard/devices') {
+      handleDashboardUpdate(JSON.parse(payload));
+    }
+    else if (topic.endsWith('/state')) {
       const deviceId = topic.split('/')[1];
-      const data = JSON.parse(payload);
-      handleDeviceMessage(deviceId, data);
+      handleDeviceState(deviceId, JSON.parse(payload));
     }
     else if (topic.includes('/status')) {
       const deviceId = topic.split('/')[1];
       // Try to parse as JSON, fallback to text
       try {
         const data = JSON.parse(payload);
-        handleDeviceMessage(deviceId, data);
+        handleDeviceStatus(deviceId, data);
       } catch {
         // If not JSON, just register the device with normalizeDeviceId
         const normalizedId = normalizeDeviceId(deviceId);
@@ -76,6 +83,12 @@ function onMQTTMessage(topic, message) {
       const data = JSON.parse(payload);
       addEvent('success', `Gesture detected: ${data.gesture}`, data);
     }
+    else if (topic === 'automation/events') {
+      handleAutomationEvent(JSON.parse(payload));
+    }
+    else if (topic === 'presence/events') {
+      handleDevicePresence(JSON.parse(payload));
+    }
     
   } catch (error) {
     addEvent('error', 'Failed to parse MQTT message', { topic, error: error.message });
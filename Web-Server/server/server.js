@@ -5,18 +5,297 @@
 
 const express = require('express');
 const http = require('http');
-const aedes = require('aedes')();
+const createBroker = require('aedes');
+const createMemoryPersistence = require('aedes-persistence');
+const createMqemitter = require('mqemitter');
 const { Server: WebSocketServer } = require('ws');
+const fs = require('fs');
 const path = require('path');
+const crypto = require('crypto');
+const { TopicRouter } = require('./topic-router');
+const { HistoryStore, ROLLUPS, mergeQueryResults } = require('./history-store');
+const { AutomationEngine } = require('./automation-engine');
+const { DevicePresence } = require('./device-presence');
+const { BrokerPersistence } = require('./broker-persistence');
+const { BusEmitter } = require('./message-bus');
+const { DashboardFlow } = require('./dashboard-flow');
 
 // Configuration
 const HTTP_PORT = 3000;
 const MQTT_TCP_PORT = 1883;
-const DEVICE_TIMEOUT = 60000;
+// Firmware MQTT keepalive (seconds); a silent device is offline after 1.5x,
+// the same grace the broker gives before dropping the connection
+const DEVICE_KEEPALIVE = 10;
+const PRESENCE_TIMEOUT = DEVICE_KEEPALIVE * 1500;
+const ACK_TIMEOUT_DEFAULT = 2000;
+const ACK_TIMEOUT_MIN = 100;
+const ACK_TIMEOUT_MAX = 10000;
+const DATA_DIR = path.join(__dirname, 'data');
+const HISTORY_DIR = path.join(DATA_DIR, 'history');
+const HISTORY_SHARD_PATTERN = /^history-broker-(\d+)$/;   // Written by broker workers
+const STATE_DIR = path.join(__dirname, 'data', 'state');
+const AUTOMATION_RULES_FILE = path.join(__dirname, 'data', 'automation-rules.json');
+const HISTORY_DEFAULT_RANGE = 3600000;   // 1 hour when `from` is omitted
+const HISTORY_ROLLUPS = ROLLUPS.map(r => r.name);
+const DASHBOARD_TOPIC = 'dashboard/devices';
+const DASHBOARD_PUSH_INTERVAL = 250;     // Changed devices are batched this long
+// Per WebSocket client: unsent bytes before state publishes are held back
+// and coalesced, unsent bytes before other publishes are dropped, the state
+// topics that may be coalesced, and the minimum interval (ms) between
+// messages on one topic
+const WS_QUEUE_LIMIT = 256 * 1024;
+const WS_DROP_LIMIT = 1024 * 1024;
+const WS_COALESCE_TOPICS = ['devices/+/telemetry', 'devices/+/state', 'devices/+/status'];
+const WS_RATE_LIMITS = { 'devices/+/telemetry': 200 };
+// Set by cluster.js; 'app' means devices connect to broker workers and this
+// process serves HTTP, dashboards and the telemetry handlers
+const CLUSTER_ROLE = process.env.CLUSTER_ROLE || null;
+const CLUSTER_BROKERS = parseInt(process.env.CLUSTER_BROKERS, 10) || 0;
 
 // Device registry
 const devices = new Map();
 
+// Latest telemetry message per device, decoded only when someone reads it;
+// at high publish rates most messages are superseded before that
+const pendingTelemetry = new Map();
+
+function getOrCreateDevice(deviceId) {
+  let device = devices.get(deviceId);
+  if (!device) {
+    device = {
+      id: deviceId,
+      type: deviceId.includes('ACTUATOR') ? 'actuator' : 'sensor',
+      firstSeen: Date.now(),
+      online: false,
+      telemetry: {}
+    };
+    devices.set(deviceId, device);
+    state.saveDevice(device);
+    console.log('[DEVICE] New device registered:', deviceId);
+  }
+  return device;
+}
+
+function deviceTelemetry(device) {
+  const message = pendingTelemetry.get(device.id);
+  if (message) {
+    pendingTelemetry.delete(device.id);
+    const telemetry = message.json();
+    if (telemetry) {
+      device.telemetry = telemetry;
+    } else {
+      console.error('[ERROR] Invalid telemetry JSON:', message.jsonError.message);
+    }
+  }
+  return device.telemetry;
+}
+
+// Retained messages, persistent sessions, wills and the registry survive
+// restarts; restored devices stay offline until they are heard from
+const state = new BrokerPersistence(STATE_DIR, {
+  registry: {
+    dump: () => Array.from(devices.values()).map(deviceView),
+    restore: (records) => {
+      for (const { presence, ...record } of records) {
+        devices.set(record.id, { lastSeen: record.firstSeen, ...record, online: false });
+      }
+    }
+  }
+});
+state.load();
+const persistence = state.wrap(createMemoryPersistence());
+
+// Cluster mode: the broker joins the broker workers over the message bus.
+// Retained messages are shared both ways and logged here, so they persist;
+// sessions and wills of devices live on their broker worker and do not
+const bus = CLUSTER_ROLE === 'app' ? new BusEmitter(createMqemitter({ matchEmptyLevels: true })) : null;
+if (bus) {
+  bus.replicateRetained(persistence);
+  bus.onSyncRequest = () => state.retainedPackets();
+  bus.shareRetained(state.retainedPackets());
+}
+
+// Slow dashboards get the latest message per topic instead of a backlog
+const flow = new DashboardFlow({
+  queueLimitBytes: WS_QUEUE_LIMIT,
+  dropLimitBytes: WS_DROP_LIMIT,
+  coalesce: WS_COALESCE_TOPICS,
+  rateLimits: WS_RATE_LIMITS
+});
+
+const brokerOptions = {
+  persistence,
+  authorizeForward: (client, packet) => flow.forward(client, packet)
+};
+if (bus) brokerOptions.mq = bus;
+const aedes = createBroker(brokerOptions);
+
+// Dashboard push: devices that changed are collected and published together
+// on DASHBOARD_TOPIC as full records, at most once per DASHBOARD_PUSH_INTERVAL.
+// `seq` lets a dashboard notice a lost batch and reload /api/devices, whose
+// body is cached until the registry changes
+const dirtyDevices = new Set();
+let dashboardSeq = 0;
+let dashboardTimer = null;
+let devicesVersion = 0;
+let devicesCache = null;
+
+function deviceView(device) {
+  return { ...device, telemetry: deviceTelemetry(device) };
+}
+
+function markDeviceChanged(device) {
+  devicesVersion++;
+  dirtyDevices.add(device.id);
+  if (!dashboardTimer) dashboardTimer = setTimeout(pushDashboardUpdates, DASHBOARD_PUSH_INTERVAL);
+}
+
+function pushDashboardUpdates() {
+  dashboardTimer = null;
+  const changed = [];
+  for (const deviceId of dirtyDevices) changed.push(deviceView(devices.get(deviceId)));
+  dirtyDevices.clear();
+  
+  aedes.publish({
+    topic: DASHBOARD_TOPIC,
+    payload: JSON.stringify({ seq: ++dashboardSeq, devices: changed }),
+    qos: 0,
+    retain: false
+  }, () => {});
+}
+
+// Online/offline comes from the broker (connect, disconnect, Last Will) and
+// from a keepalive-based expiry; each transition is pushed to dashboards
+// and announced on presence/events
+const presence = new DevicePresence({ timeoutMs: PRESENCE_TIMEOUT });
+
+function onPresenceChange(deviceId, online, reason) {
+  const device = devices.get(deviceId);
+  if (!device) return;
+  device.online = online;
+  device.presence = { reason, at: Date.now() };
+  markDeviceChanged(device);
+  console.log('[PRESENCE]', deviceId, online ? 'online' : 'offline', '(' + reason + ')');
+  
+  aedes.publish({
+    topic: 'presence/events',
+    payload: JSON.stringify({ deviceId, online, reason, at: device.presence.at }),
+    qos: 0,
+    retain: false
+  }, () => {});
+}
+
+presence.on('online', (deviceId, reason) => onPresenceChange(deviceId, true, reason));
+presence.on('offline', (deviceId, reason) => onPresenceChange(deviceId, false, reason));
+
+// Telemetry history on local disk, for this process's own MQTT clients.
+// In cluster mode broker workers keep a shard each for theirs; shards no
+// running broker owns (all of them under `npm start`) are opened here, so
+// their data stays queryable and is still pruned.
+const history = new HistoryStore(HISTORY_DIR);
+const historyShards = fs.readdirSync(DATA_DIR)
+  .map(name => HISTORY_SHARD_PATTERN.exec(name))
+  .filter(match => match && !(bus && parseInt(match[1], 10) < CLUSTER_BROKERS))
+  .map(match => new HistoryStore(path.join(DATA_DIR, match[0])));
+
+async function queryHistory(deviceId, options) {
+  const stores = [history, ...historyShards];
+  const results = await Promise.all(stores.map(store => store.query(deviceId, options)));
+  if (bus) {
+    for (const reply of await bus.request('history', { deviceId, options })) {
+      if (reply.error) throw new Error(reply.error);
+      results.push(reply.result);
+    }
+  }
+  return mergeQueryResults(results);
+}
+
+// Command sequencing: per-device sequence numbers, and REST calls waiting
+// for a device ack keyed by correlation ID (several retries may share one)
+const commandSeq = new Map();
+const pendingAcks = new Map();
+
+function nextCommandSeq(deviceId) {
+  const seq = (commandSeq.get(deviceId) || 0) + 1;
+  commandSeq.set(deviceId, seq);
+  return seq;
+}
+
+// Every command carries the device's next seq and a correlation ID
+function buildGpioCommand(deviceId, gpio, state, cid) {
+  const command = {
+    type: 'gpio',
+    pin: parseInt(gpio),
+    state: state === true || parseInt(state) === 1,
+    seq: nextCommandSeq(deviceId),
+    cid: cid || crypto.randomBytes(8).toString('hex')
+  };
+  return { topic: `device/${deviceId}/gpio/set`, command };
+}
+
+function waitForAck(cid, timeoutMs) {
+  return new Promise((resolve) => {
+    const waiter = { resolve, sentAt: process.hrtime.bigint() };
+    waiter.timer = setTimeout(() => {
+      removeAckWaiter(cid, waiter);
+      resolve(null);
+    }, timeoutMs);
+    
+    if (!pendingAcks.has(cid)) pendingAcks.set(cid, []);
+    pendingAcks.get(cid).push(waiter);
+  });
+}
+
+function removeAckWaiter(cid, waiter) {
+  const waiters = pendingAcks.get(cid);
+  if (!waiters) return;
+  const index = waiters.indexOf(waiter);
+  if (index !== -1) waiters.splice(index, 1);
+  if (waiters.length === 0) pendingAcks.delete(cid);
+}
+
+function resolveAck(deviceId, ack) {
+  const waiters = pendingAcks.get(ack.cid);
+  if (!waiters) return;
+  pendingAcks.delete(ack.cid);
+  
+  const now = process.hrtime.bigint();
+  for (const waiter of waiters) {
+    clearTimeout(waiter.timer);
+    const rttMs = Number(now - waiter.sentAt) / 1e6;
+    console.log('[ACK]', deviceId, 'seq', ack.seq, ack.ok ? 'ok' : 'failed', 'in', rttMs.toFixed(1), 'ms');
+    waiter.resolve({ ack, rttMs });
+  }
+}
+
+// Server-side automation: rules are evaluated as telemetry arrives and
+// commands are published once, however many dashboards are open
+const automation = new AutomationEngine({
+  file: AUTOMATION_RULES_FILE,
+  execute: (action, rule, trigger) => {
+    const target = devices.get(action.deviceId);
+    if (!target || !target.online) return false;
+    
+    const { topic, command } = buildGpioCommand(action.deviceId, action.gpio, action.state);
+    aedes.publish({ topic, payload: JSON.stringify(command), qos: 0, retain: false }, (error) => {
+      if (error) {
+        console.error('[AUTOMATION] Publish failed for rule', rule.name + ':', error.message);
+        return;
+      }
+      trigger.done();
+      console.log('[AUTOMATION]', rule.name, '->', action.deviceId, 'GPIO', action.gpio, action.state ? 'ON' : 'OFF',
+                  'in', rule.lastLatencyMs.toFixed(2), 'ms');
+      // Dashboards log firings from this topic
+      aedes.publish({
+        topic: 'automation/events',
+        payload: JSON.stringify({ ruleId: rule.id, name: rule.name, action, seq: command.seq, latencyMs: rule.lastLatencyMs }),
+        qos: 0,
+        retain: false
+      }, () => {});
+    });
+  }
+});
+
 // Initialize Express
 const app = express();
 const server = http.createServer(app);
@@ -30,73 +309,156 @@ const wss = new WebSocketServer({ server, path: '/mqtt' });
 
 wss.on('connection', (ws) => {
   const stream = require('websocket-stream')(ws);
-  aedes.handle(stream);
+  const client = aedes.handle(stream);
+  flow.attach(client, ws);
+  ws.on('close', () => flow.detach(client));
 });
 
-// MQTT TCP server
-const mqttServer = require('net').createServer(aedes.handle);
-mqttServer.listen(MQTT_TCP_PORT, () => {
-  console.log('[MQTT] TCP broker listening on port', MQTT_TCP_PORT);
-});
+// MQTT TCP server (broker workers own the port in cluster mode)
+const mqttServer = bus ? null : require('net').createServer(aedes.handle);
+if (mqttServer) {
+  mqttServer.listen(MQTT_TCP_PORT, () => {
+    console.log('[MQTT] TCP broker listening on port', MQTT_TCP_PORT);
+  });
+}
 
 // MQTT Events
 aedes.on('client', (client) => {
   console.log('[MQTT] Client connected:', client.id);
+  if (devices.has(client.id)) presence.seen(client.id, 'connect');
 });
 
 aedes.on('clientDisconnect', (client) => {
   console.log('[MQTT] Client disconnected:', client.id);
+  // A device that reconnected under the same ID has already replaced this client
+  if (isSupersededClient(client.id, client)) return;
+  presence.disconnected(client.id, 'disconnect');
 });
 
-aedes.on('publish', (packet, client) => {
-  if (!client) return;
-  
-  const topic = packet.topic;
-  const payload = packet.payload.toString();
-  
-  if (topic.startsWith('devices/') && topic.endsWith('/telemetry')) {
-    const deviceId = topic.split('/')[1];
-    
-    try {
-      const telemetry = JSON.parse(payload);
-      
-      if (!devices.has(deviceId)) {
-        devices.set(deviceId, {
-          id: deviceId,
-          type: deviceId.includes('ACTUATOR') ? 'actuator' : 'sensor',
-          firstSeen: Date.now(),
-          telemetry: {}
-        });
-        console.log('[DEVICE] New device registered:', deviceId);
-      }
-      
-      const device = devices.get(deviceId);
-      device.lastSeen = Date.now();
-      device.telemetry = telemetry;
-      
-    } catch (error) {
-      console.error('[ERROR] Invalid telemetry JSON:', error.message);
+// Keepalive pings prove a quiet device is still there
+aedes.on('ping', (packet, client) => {
+  if (client) presence.touch(client.id);
+});
+
+// Cluster mode: broker workers report their clients over the bus, with
+// the broker id of the worker that holds each connection
+const clientBrokers = new Map();
+
+if (bus) {
+  bus.onEvent = (event, { clientId, brokerId }) => {
+    switch (event) {
+      case 'client':
+        clientBrokers.set(clientId, brokerId);
+        if (devices.has(clientId)) presence.seen(clientId, 'connect');
+        break;
+      case 'clientDisconnect':
+        if (isSupersededClient(clientId, null, brokerId)) return;
+        clientBrokers.delete(clientId);
+        presence.disconnected(clientId, 'disconnect');
+        break;
+      case 'ping':
+        presence.touch(clientId);
+        break;
     }
+  };
+}
+
+// A client without `client` is on a broker worker, identified by brokerId
+function isSupersededClient(clientId, client, brokerId) {
+  const current = client ? aedes.clients[clientId] : clientBrokers.get(clientId);
+  return Boolean(current && current !== (client || brokerId));
+}
+
+// Topic routes, compiled once; '+' levels arrive as params
+const router = new TopicRouter();
+
+router.add('devices/+/telemetry', (message, [deviceId]) => {
+  const device = getOrCreateDevice(deviceId);
+  device.lastSeen = message.receivedAt;
+  presence.seen(deviceId, 'telemetry', message.receivedAt);
+  pendingTelemetry.set(deviceId, message);
+  markDeviceChanged(device);
+  // Publishes relayed from broker workers are stored in their shards
+  if (!bus || message.client) history.ingest(deviceId, message);
+  automation.onTelemetry(deviceId, message);
+});
+
+// Retained by the device on connect ({"online": true, ...}) and set as its
+// Last Will ({"online": false}), which the broker publishes if it vanishes
+router.add('devices/+/status', (message, [deviceId]) => {
+  const status = message.json();
+  if (!status || status.online !== false) return;
+  if (isSupersededClient(deviceId, message.client, message.packet.brokerId)) return;
+  presence.disconnected(deviceId, 'will');
+});
+
+router.add('devices/+/ack', (message, [deviceId]) => {
+  const ack = message.json();
+  if (!ack) {
+    console.error('[ERROR] Invalid ack JSON:', message.jsonError.message);
+    return;
   }
-  
-  if (topic.startsWith('device/') && topic.endsWith('/gpio/set')) {
-    const deviceId = topic.split('/')[1];
-    console.log('[GPIO] Command sent to', deviceId + ':', payload);
-  }
+  if (ack.cid) resolveAck(deviceId, ack);
 });
 
+router.add('device/+/gpio/set', (message, [deviceId]) => {
+  console.log('[GPIO] Command sent to', deviceId + ':', message.text());
+});
+
+aedes.on('publish', (packet, client) => {
+  if (!client) return;
+  router.dispatch(packet.topic, packet, client);
+});
+
+// Cluster mode: device publishes arrive from broker workers without a client
+if (bus) {
+  bus.watch('devices/#');
+  bus.onRemotePublish = (packet) => router.dispatch(packet.topic, packet, null);
+}
+
 // REST API
+// `seq` is the last dashboard batch already reflected in the list
 app.get('/api/devices', (req, res) => {
-  const now = Date.now();
-  const deviceList = Array.from(devices.values()).map(device => ({
-    ...device,
-    online: (now - device.lastSeen) < DEVICE_TIMEOUT
-  }));
+  if (!devicesCache || devicesCache.version !== devicesVersion) {
+    const deviceList = Array.from(devices.values()).map(deviceView);
+    devicesCache = {
+      version: devicesVersion,
+      body: JSON.stringify({ count: deviceList.length, seq: dashboardSeq, devices: deviceList })
+    };
+  }
+  res.type('json').send(devicesCache.body);
+});
+
+// Query: from, to (epoch ms, default last hour), fields (comma separated, default all),
+// points (target count: picks the coarsest rollup giving at least that many),
+// resolution (raw | 1m | 1h | 1d, overrides points).
+// Columns are parallel arrays: raw { t, v }, rollups { t, min, max, mean, count, last }
+app.get('/api/devices/:id/history', async (req, res) => {
+  const deviceId = req.params.id;
+  const to = req.query.to !== undefined ? Number(req.query.to) : Date.now();
+  const from = req.query.from !== undefined ? Number(req.query.from) : to - HISTORY_DEFAULT_RANGE;
+  if (!Number.isFinite(from) || !Number.isFinite(to) || from > to) {
+    return res.status(400).json({ error: 'Invalid time range' });
+  }
   
-  res.json({
-    count: deviceList.length,
-    devices: deviceList
-  });
+  const fields = req.query.fields
+    ? String(req.query.fields).split(',').map(f => f.trim()).filter(Boolean)
+    : null;
+  const points = parseInt(req.query.points) || 0;
+  const resolution = req.query.resolution ? String(req.query.resolution) : null;
+  if (resolution && resolution !== 'raw' && !HISTORY_ROLLUPS.includes(resolution)) {
+    return res.status(400).json({ error: 'Unknown resolution', resolutions: ['raw', ...HISTORY_ROLLUPS] });
+  }
+  
+  try {
+    // Every shard answers at the same resolution
+    const options = { from, to, fields, points, resolution: resolution || history.chooseResolution(from, to, points) };
+    const result = await queryHistory(deviceId, options);
+    res.json({ deviceId, from, to, ...result });
+  } catch (error) {
+    console.error('[HISTORY] Query failed:', error.message);
+    res.status(500).json({ error: 'History query failed' });
+  }
 });
 
 app.get('/api/server-ip', (req, res) => {
@@ -119,6 +481,10 @@ app.get('/api/server-ip', (req, res) => {
   res.json({ ip: serverIP });
 });
 
+// Body: { deviceId, gpio, state, pulseMs?, cid?, waitAck?, timeoutMs? }
+// Every command carries a seq and cid. Retrying with the same cid is safe;
+// the device answers replays from its dedupe window instead of re-applying.
+// With waitAck (or ?wait=1) the response is held until the device acks.
 app.post('/api/gpio/control', (req, res) => {
   const { deviceId, gpio, state } = req.body;
   
@@ -126,34 +492,123 @@ app.post('/api/gpio/control', (req, res) => {
     return res.status(400).json({ error: 'Missing required fields' });
   }
   
-  const topic = `device/${deviceId}/gpio/set`;
-  const payload = JSON.stringify({ gpio: parseInt(gpio), state: parseInt(state) });
+  const requestedCid = (typeof req.body.cid === 'string' && req.body.cid.length > 0 && req.body.cid.length < 24)
+    ? req.body.cid
+    : null;
+  const waitAck = req.body.waitAck === true || req.query.wait === '1';
+  const timeoutMs = Math.min(Math.max(parseInt(req.body.timeoutMs) || ACK_TIMEOUT_DEFAULT, ACK_TIMEOUT_MIN), ACK_TIMEOUT_MAX);
+  
+  const { topic, command } = buildGpioCommand(deviceId, gpio, state, requestedCid);
+  const { seq, cid } = command;
+  if (req.body.pulseMs) command.pulse_ms = parseInt(req.body.pulseMs);
+  const payload = JSON.stringify(command);
+  
+  // Register before publishing; a local device can ack before the callback runs
+  const ackPromise = waitAck ? waitForAck(cid, timeoutMs) : null;
   
   aedes.publish({
     topic,
     payload,
     qos: 0,
     retain: false
-  }, (error) => {
+  }, async (error) => {
     if (error) {
-      return res.status(500).json({ error: 'MQTT publish failed' });
+      return res.status(500).json({ error: 'MQTT publish failed', seq, cid });
     }
     
-    res.json({ 
-      success: true,
-      message: `GPIO ${gpio} set to ${state} on ${deviceId}`
+    if (!ackPromise) {
+      return res.json({ 
+        success: true,
+        message: `GPIO ${gpio} set to ${state} on ${deviceId}`,
+        seq,
+        cid
+      });
+    }
+    
+    const result = await ackPromise;
+    if (!result) {
+      return res.status(504).json({ success: false, error: 'Ack timeout', seq, cid, timeoutMs });
+    }
+    
+    const { ack, rttMs } = result;
+    res.status(ack.ok ? 200 : 422).json({
+      success: ack.ok,
+      message: ack.ok ? `GPIO ${gpio} set to ${state} on ${deviceId}` : `Device rejected command: ${ack.err}`,
+      seq,
+      cid,
+      duplicate: ack.dup === true,
+      rttMs: Math.round(rttMs * 100) / 100,
+      deviceApplyUs: ack.appliedUs && ack.rxUs ? ack.appliedUs - ack.rxUs : null
     });
   });
 });
 
-app.get('/api/health', (req, res) => {
+// Automation rules
+// Body: { name, condition: { deviceId, parameter, operator, threshold, ... },
+//         action: { deviceId, gpio, state }, autoToggle?, enabled? }
+// Conditions may nest all/any and add hysteresis, forSeconds and windowed
+// aggregates (see automation-conditions.js)
+app.get('/api/automation/rules', (req, res) => {
+  res.json({ rules: automation.list(), stats: automation.summary() });
+});
+
+app.post('/api/automation/rules', (req, res) => {
+  try {
+    res.status(201).json(automation.add(req.body));
+  } catch (error) {
+    res.status(400).json({ error: error.message });
+  }
+});
+
+// Partial updates are merged into the existing rule (e.g. { enabled: false })
+app.put('/api/automation/rules/:id', (req, res) => {
+  try {
+    const rule = automation.update(req.params.id, req.body);
+    if (!rule) return res.status(404).json({ error: 'Rule not found' });
+    res.json(rule);
+  } catch (error) {
+    res.status(400).json({ error: error.message });
+  }
+});
+
+app.delete('/api/automation/rules/:id', (req, res) => {
+  if (!automation.remove(req.params.id)) return res.status(404).json({ error: 'Rule not found' });
+  res.json({ success: true });
+});
+
+app.get('/api/health', async (req, res) => {
+  // Broker workers report their own load; a slow or missing one shows as null
+  const brokers = bus ? await bus.request('stats', {}).catch(() => null) : null;
   res.json({
     status: 'healthy',
     uptime: process.uptime(),
+    cpu: process.cpuUsage(),
     mqtt: {
       clients: Object.keys(aedes.clients).length
     },
-    devices: devices.size
+    cluster: bus ? {
+      role: CLUSTER_ROLE,
+      clients: clientBrokers.size,
+      bus: bus.stats,
+      brokers: brokers && brokers.map(reply => reply.result || null)
+    } : undefined,
+    devices: devices.size,
+    presence: presence.stats(),
+    state: state.summary(),
+    dashboard: {
+      seq: dashboardSeq,
+      pending: dirtyDevices.size
+    },
+    websocket: flow.summary(),
+    pendingAcks: pendingAcks.size,
+    router: {
+      routes: router.routeCount,
+      dispatched: router.dispatched,
+      unmatched: router.unmatched
+    },
+    history: history.stats(),
+    historyShards: historyShards.length ? historyShards.map(store => store.stats()) : undefined,
+    automation: automation.summary()
   });
 });
 
@@ -169,18 +624,29 @@ server.listen(HTTP_PORT, () => {
   console.log('============================================================');
   console.log('[HTTP] Dashboard:       http://localhost:' + HTTP_PORT);
   console.log('[HTTP] API server:      http://localhost:' + HTTP_PORT + '/api');
-  console.log('[MQTT] TCP broker:      mqtt://localhost:' + MQTT_TCP_PORT);
+  console.log('[MQTT] TCP broker:      mqtt://localhost:' + MQTT_TCP_PORT + (bus ? ' (broker workers)' : ''));
   console.log('[MQTT] WebSocket:       ws://localhost:' + HTTP_PORT + '/mqtt');
   console.log('============================================================');
   console.log('[INFO] Open http://localhost:' + HTTP_PORT + ' in your browser');
   console.log('============================================================\n');
 });
 
-// Graceful shutdown
+// Graceful shutdown; in cluster mode the signal can arrive twice (from the
+// terminal and from the primary)
+let shuttingDown = false;
 process.on('SIGINT', () => {
+  if (shuttingDown) return;
+  shuttingDown = true;
   console.log('\n[INFO] Shutting down server...');
-  server.close(() => {
-    mqttServer.close(() => {
+  // Stop accepting and drop what is open: close callbacks would wait for
+  // every device and dashboard (and idle keep-alive sockets) to leave
+  server.close();
+  if (mqttServer) mqttServer.close();
+  for (const ws of wss.clients) ws.terminate();
+  aedes.close(() => {
+    // Open history blocks, rollup buckets and a final state snapshot
+    // are written before exiting
+    Promise.all([history.close(), ...historyShards.map(store => store.close()), automation.flush(), state.close()]).then(() => {
       console.log('[INFO] Server stopped');
       process.exit(0);
     });
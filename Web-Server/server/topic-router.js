@@ -0,0 +1,158 @@
+/**
+ * Topic Router
+ *
+ * Routes are compiled into a trie keyed on topic levels, with MQTT `+`
+ * (exactly one level) and `#` (all remaining levels) wildcards. A publish
+ * is dispatched by walking its levels once; the levels matched by `+` are
+ * handed to the handler as a params array, so handlers never split the
+ * topic.
+ *
+ * Payloads are parsed lazily: handlers get a TopicMessage whose text() and
+ * json() decode on first use and cache the result, so a message nobody
+ * reads is never decoded and several handlers share one parse.
+ */
+
+class TopicMessage {
+  constructor(topic, packet, client) {
+    this.topic = topic;
+    this.packet = packet;
+    this.client = client;
+    this.receivedAt = Date.now();
+    this.jsonError = null;
+    this._text = undefined;
+    this._json = undefined;
+  }
+
+  get payload() {
+    return this.packet.payload;
+  }
+
+  text() {
+    if (this._text === undefined) {
+      const payload = this.packet.payload;
+      this._text = typeof payload === 'string' ? payload : payload.toString();
+    }
+    return this._text;
+  }
+
+  // Returns null for an invalid payload; the error is kept in jsonError
+  json() {
+    if (this._json === undefined) {
+      try {
+        this._json = JSON.parse(this.text());
+      } catch (error) {
+        this._json = null;
+        this.jsonError = error;
+      }
+    }
+    return this._json;
+  }
+}
+
+function createNode() {
+  return { children: new Map(), plus: null, hash: null, handlers: [] };
+}
+
+class TopicRouter {
+  constructor() {
+    this.root = createNode();
+    this.routeCount = 0;
+    this.dispatched = 0;
+    this.unmatched = 0;
+  }
+
+  // pattern: 'devices/+/telemetry', 'devices/#', ...
+  add(pattern, handler) {
+    const levels = pattern.split('/');
+    let node = this.root;
+
+    for (let i = 0; i < levels.length; i++) {
+      const level = levels[i];
+      if (level === '#') {
+        if (i !== levels.length - 1) throw new Error(`'#' must be the last level: ${pattern}`);
+        node.hash = node.hash || createNode();
+        node = node.hash;
+      } else if (level === '+') {
+        node.plus = node.plus || createNode();
+        node = node.plus;
+      } else {
+        if (!node.children.has(level)) node.children.set(level, createNode());
+        node = node.children.get(level);
+      }
+    }
+
+    node.handlers.push(handler);
+    this.routeCount++;
+    return this;
+  }
+
+  // Removes one handler added with the same pattern; returns false if absent
+  remove(pattern, handler) {
+    let node = this.root;
+    for (const level of pattern.split('/')) {
+      node = level === '#' ? node.hash : level === '+' ? node.plus : node.children.get(level);
+      if (!node) return false;
+    }
+    const index = node.handlers.indexOf(handler);
+    if (index === -1) return false;
+    node.handlers.splice(index, 1);
+    this.routeCount--;
+    return true;
+  }
+
+  // Matching routes as [{ handlers, params }], without calling anything
+  match(topic) {
+    const matches = [];
+    this._match(this.root, topic, 0, [], matches);
+    return matches;
+  }
+
+  // Calls every matching handler with one shared TopicMessage and the
+  // levels its route captured with '+'; returns the number of handlers called
+  dispatch(topic, packet, client) {
+    const matches = this.match(topic);
+    if (matches.length === 0) {
+      this.unmatched++;
+      return 0;
+    }
+
+    const message = new TopicMessage(topic, packet, client);
+    let called = 0;
+    for (const { handlers, params } of matches) {
+      for (const handler of handlers) {
+        handler(message, params);
+        called++;
+      }
+    }
+    this.dispatched++;
+    return called;
+  }
+
+  _match(node, topic, start, params, matches) {
+    // '#' also matches the parent level itself ('a/#' matches 'a')
+    if (node.hash && node.hash.handlers.length > 0) {
+      matches.push({ handlers: node.hash.handlers, params: params.slice() });
+    }
+
+    if (start > topic.length) {
+      if (node.handlers.length > 0) matches.push({ handlers: node.handlers, params: params.slice() });
+      return;
+    }
+
+    let end = topic.indexOf('/', start);
+    if (end === -1) end = topic.length;
+    const level = topic.slice(start, end);
+    const next = end + 1;
+
+    const child = node.children.get(level);
+    if (child) this._match(child, topic, next, params, matches);
+
+    if (node.plus) {
+      params.push(level);
+      this._match(node.plus, topic, next, params, matches);
+      params.pop();
+    }
+  }
+}
+
+module.exports = { TopicRouter, TopicMessage };